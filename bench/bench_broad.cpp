@@ -0,0 +1,113 @@
+/* Broadphase scaling: movers against 1k, 10k and 100k obstacles.
+ *
+ *   make bench && ./bench/bench_broad [rounds-scale]
+ *
+ * Obstacles of 0.5 to 2 units are scattered at a fixed density, and 1000
+ * movers of one unit, the player and NPCs, each test the box swept over
+ * one tick of mostly sideways movement. Every implementation must find
+ * the same pairs as testing every mover against every obstacle.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "../broad.h"
+#include "../rng.h"
+
+#define MOVERS 1000
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static float unit(struct Pcg32 *rng)
+{
+	return pcgNext(rng) / 4294967296.0f;
+}
+
+static bool contactLess(const struct Contact &a, const struct Contact &b)
+{
+	return a.mover != b.mover ? a.mover < b.mover : a.obstacle < b.obstacle;
+}
+
+static bool contactEqual(const struct Contact &a, const struct Contact &b)
+{
+	return a.mover == b.mover && a.obstacle == b.obstacle;
+}
+
+static void bench(int n, int rounds)
+{
+	std::vector<struct Box> obs(n), movers(MOVERS);
+	std::vector<struct Contact> all, pairs;
+	struct Broadphase bp;
+	struct Pcg32 rng;
+	float side = sqrtf(n) * 3;
+	double t0, t1;
+	int i, j, impl, r;
+
+	pcgSeed(&rng, n, 0);
+	for(i=0; i < n; i++)
+	{
+		float x = unit(&rng) * side, z = unit(&rng) * side;
+		obs[i].x0 = x;
+		obs[i].z0 = z;
+		obs[i].x1 = x + 0.5f + 1.5f * unit(&rng);
+		obs[i].z1 = z + 0.5f + 1.5f * unit(&rng);
+	}
+	for(i=0; i < MOVERS; i++)
+	{
+		float x = unit(&rng) * side, z = unit(&rng) * side;
+		float dx = (unit(&rng) - 0.5f) * 0.5f, dz = (unit(&rng) - 0.5f) * 0.1f;
+		movers[i].x0 = std::min(x, x + dx);
+		movers[i].z0 = std::min(z, z + dz);
+		movers[i].x1 = std::max(x, x + dx) + 1;
+		movers[i].z1 = std::max(z, z + dz) + 1;
+	}
+
+	t0 = now();
+	broadBuild(&bp, obs.data(), n);
+	t1 = now();
+	printf("%6d obstacles  build %8.3f ms\n", n, (t1 - t0) * 1e3);
+
+	t0 = now();
+	for(i=0; i < MOVERS; i++)
+		for(j=0; j < n; j++)
+			if(movers[i].x0 < obs[j].x1 && movers[i].x1 > obs[j].x0 && movers[i].z0 < obs[j].z1 && movers[i].z1 > obs[j].z0)
+			{
+				struct Contact c = { (uint32_t)i, (uint32_t)j };
+				all.push_back(c);
+			}
+	t1 = now();
+	printf("%6d %-8s %12.0f movers/s  %zu contacts\n", n, "all", MOVERS / (t1 - t0), all.size());
+
+	for(impl=0; impl < BROAD_IMPLS; impl++)
+	{
+		t0 = now();
+		for(r=0; r < rounds; r++)
+		{
+			pairs.clear();
+			broadQuery(&bp, movers.data(), MOVERS, BROAD_X, impl, &pairs);
+		}
+		t1 = now();
+		std::sort(pairs.begin(), pairs.end(), contactLess);
+		printf("%6d %-8s %12.0f movers/s  %zu contacts%s\n", n, broadImplName(impl), (double)MOVERS * rounds / (t1 - t0),
+				pairs.size(), pairs.size() == all.size() && std::equal(pairs.begin(), pairs.end(), all.begin(), contactEqual) ? "" : "  MISMATCH");
+	}
+}
+
+int main(int argc, char **argv)
+{
+	double scale = argc > 1 ? atof(argv[1]) : 1;
+
+	bench(1000, 2000 * scale);
+	bench(10000, 1000 * scale);
+	bench(100000, 200 * scale);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+/* Collision queries: the cell index against scanning the obstacle list.
+ *
+ *   make bench && ./bench/bench_collide [queries-scale]
+ *
+ * Asks "does the player's box touch an obstacle" at random positions on
+ * the 17x20 course, a 201x201 and a 2001x2001 maze course, by scanning
+ * every obstacle as simStep used to and through the collision index, and
+ * times the index's single cell lookup too. Both ways must agree.
+ *
+ * Then sweeps the player's box by moves of 1/40 to 1000 cells across a
+ * generated 2001x2001 course, to show the cost goes with the lines crossed
+ * before the first obstacle, not with how many obstacles there are.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vector>
+
+#include "../maze.h"
+#include "../rng.h"
+#include "../sim.h"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+volatile unsigned sink;  // keeps the timed loops from being optimised away
+
+static bool scanHit(const struct Course *course, float x, float z)
+{
+	size_t n;
+
+	for(n=0; n < course->obs.size(); n++)
+	{
+		float ox = course->obs[n].x, oz = course->obs[n].z;
+		if(x + HIT_INSET < ox + 1 && x + 1 - HIT_INSET > ox && z + HIT_INSET < oz + 1 && z + 1 - HIT_INSET > oz)
+			return true;
+	}
+	return false;
+}
+
+static void bench(const char *name, const struct Course *course, int queries, int scans)
+{
+	std::vector<float> x(queries), z(queries);
+	struct Pcg32 rng;
+	double t0, t1, t2, t3;
+	unsigned sum = 0;
+	int q, hits = 0, mismatch = 0;
+
+	pcgSeed(&rng, 42, 0);
+	for(q=0; q < queries; q++)
+	{
+		x[q] = pcgNext(&rng) / 4294967296.0f * course->w - 0.5f;
+		z[q] = pcgNext(&rng) / 4294967296.0f * course->d - 0.5f;
+	}
+
+	t0 = now();
+	for(q=0; q < scans; q++)
+		hits += scanHit(course, x[q], z[q]);
+	t1 = now();
+	for(q=0; q < queries; q++)
+		sum += colBox(&course->index, x[q] + HIT_INSET, z[q] + HIT_INSET, x[q] + 1 - HIT_INSET, z[q] + 1 - HIT_INSET) & COL_OBSTACLE;
+	t2 = now();
+	for(q=0; q < queries; q++)
+		sum += colCell(&course->index, (int)floorf(x[q] + 0.5f), (int)floorf(z[q] + 0.5f));
+	t3 = now();
+
+	for(q=0; q < scans; q++)
+		mismatch += scanHit(course, x[q], z[q]) != !!(colBox(&course->index, x[q] + HIT_INSET, z[q] + HIT_INSET,
+				x[q] + 1 - HIT_INSET, z[q] + 1 - HIT_INSET) & COL_OBSTACLE);
+	sink = sum;
+	printf("%-10s %7zu obstacles  scan %12.0f q/s  box %12.0f q/s  cell %12.0f q/s  %d/%d hit  %d mismatches\n",
+			name, course->obs.size(), scans / (t1 - t0), queries / (t2 - t1), queries / (t3 - t2),
+			hits, scans, mismatch);
+}
+
+static void benchSweep(const struct Course *course, float length, int queries)
+{
+	std::vector<float> x(queries), z(queries), dx(queries), dz(queries);
+	struct ColHit hit;
+	struct Pcg32 rng;
+	double t0, t1, cells = 0;
+	unsigned sum = 0;
+	int q, hits = 0;
+
+	pcgSeed(&rng, 42, 0);
+	for(q=0; q < queries; q++)
+	{
+		float a = pcgNext(&rng) / 4294967296.0f * 6.2831853f;
+		x[q] = pcgNext(&rng) / 4294967296.0f * course->w - 0.5f;
+		z[q] = pcgNext(&rng) / 4294967296.0f * course->d - 0.5f;
+		dx[q] = cosf(a) * length;
+		dz[q] = sinf(a) * length;
+	}
+
+	t0 = now();
+	for(q=0; q < queries; q++)
+		if(colSweepBox(&course->index, x[q] + HIT_INSET, z[q] + HIT_INSET, x[q] + 1 - HIT_INSET, z[q] + 1 - HIT_INSET,
+				dx[q], dz[q], COL_OBSTACLE, COL_OBSTACLE, &hit))
+		{
+			hits++;
+			sum += hit.i;
+			/* Columns and rows the box's leading corner crossed to get there */
+			cells += fabsf(dx[q] * hit.t) + fabsf(dz[q] * hit.t) + 1;
+		}
+		else
+			cells += fabsf(dx[q]) + fabsf(dz[q]) + 1;
+	t1 = now();
+	sink = sum;
+	printf("sweep %7.3f cells  %12.0f q/s  %6.1f lines crossed/q  %5.1f%% hit\n",
+			length, queries / (t1 - t0), cells / queries, 100.0 * hits / queries);
+}
+
+int main(int argc, char **argv)
+{
+	double scale = argc > 1 ? atof(argv[1]) : 1;
+	struct Course course;
+
+	generateCourse(&course, 1);
+	bench("17x20", &course, 20000000 * scale, 2000000 * scale);
+	generateMazeCourse(&course, 1, 201, 201);
+	bench("maze 201", &course, 20000000 * scale, 20000 * scale);
+	generateMazeCourse(&course, 1, 2001, 2001);
+	bench("maze 2001", &course, 20000000 * scale, 200 * scale);
+	generateCourse(&course, 1, 2001, 2001);
+	benchSweep(&course, MOVE_SPEED / SIM_HZ, 20000000 * scale);
+	benchSweep(&course, 1, 20000000 * scale);
+	benchSweep(&course, 10, 5000000 * scale);
+	benchSweep(&course, 1000, 5000000 * scale);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,45 @@
+/* Course generation throughput.
+ *
+ *   make bench && ./bench/bench_gen [candidates] [w d]
+ *
+ * Runs pickCourse with 1, 2, 4 ... up to all hardware threads and reports
+ * candidates generated, validated and scored per second, in total and per
+ * core, plus how many candidates needed repairing.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <thread>
+
+#include "../course.h"
+#include "../solve.h"
+
+int main(int argc, char **argv)
+{
+	int candidates = argc > 1 ? atoi(argv[1]) : 20000;
+	int w = argc > 3 ? atoi(argv[2]) : COURSE_W;
+	int d = argc > 3 ? atoi(argv[3]) : COURSE_D;
+	int hw = std::thread::hardware_concurrency();
+	struct Course course;
+	struct CourseStats stats;
+	struct GenStats gs;
+	int threads;
+
+	if(hw < 1)
+		hw = 1;
+	printf("%d candidates of %dx%d, %d hardware threads\n", candidates, w, d, hw);
+	for(threads = 1; ; threads *= 2)
+	{
+		if(threads > hw)
+			threads = hw;
+		pickCourse(&course, 1, w, d, candidates, 40, threads, &gs);
+		analyseCourse(&course, &stats);
+		printf("%2d threads: %8.0f courses/s, %8.0f per core, %d repaired (%.1f%%), picked seed %u time %d crossings %d\n",
+				threads, gs.candidates / gs.seconds, gs.candidates / gs.seconds / threads,
+				gs.repaired, 100.0 * gs.repaired / gs.candidates,
+				course.seed, stats.time, stats.crossings);
+		if(threads == hw)
+			break;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+/* Hierarchical path finding against flat A*.
+ *
+ *   make bench && ./bench/bench_hpa [queries-scale]
+ *
+ * Runs on a 2001 x 2001 maze course and on a 4k x 4k grid with 20% of the
+ * cells blocked at random. Reports the time to build the abstraction, the
+ * cost of updating it after a cell flips, and query latency for flat A*,
+ * for the abstract search alone and for the abstract search plus refining
+ * every segment into cells. "ratio" is the mean HPA* cost over the optimal
+ * one; a query HPA* can't answer but A* can is a mismatch.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vector>
+
+#include "../hpa.h"
+#include "../maze.h"
+#include "../rng.h"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct PathPoint freeCell(const struct Grid *g, struct Pcg32 *rng)
+{
+	struct PathPoint p;
+
+	do {
+		p.x = pcgRange(rng, g->w);
+		p.z = pcgRange(rng, g->d);
+	} while(!gridFree(g, p.x, p.z));
+	return p;
+}
+
+static void bench(const char *name, struct Grid *g, int queries, int updates)
+{
+	std::vector<struct PathPoint> from(queries), to(queries), path, way, cells;
+	std::vector<long> flat(queries);
+	struct PathFinder pf;
+	struct Hpa h;
+	struct Pcg32 rng;
+	size_t i, nodes = 0, edges = 0, expanded = 0;
+	double t0, t1, ratio = 0;
+	int q, n, found = 0, mismatch = 0;
+
+	pcgSeed(&rng, 42, 0);
+	for(q=0; q < queries; q++)
+	{
+		from[q] = freeCell(g, &rng);
+		to[q] = freeCell(g, &rng);
+	}
+
+	t0 = now();
+	hpaBuild(&h, g);
+	t1 = now();
+	for(i=0; i < h.nodes.size(); i++)
+		if(h.nodes[i].cluster != HPA_FREE)
+		{
+			nodes++;
+			edges += h.nodes[i].edges.size();
+		}
+	printf("%-9s build %8.1f ms  %zu nodes  %zu edges\n", name, (t1 - t0) * 1e3, nodes, edges);
+
+	/* Flip cells and flip them back, so the grid ends up as it started */
+	t0 = now();
+	for(n=0; n < updates; n++)
+	{
+		int x = pcgRange(&rng, g->w), z = pcgRange(&rng, g->d), k;
+		for(k=0; k < 2; k++)
+		{
+			if(gridFree(g, x, z))
+				gridBlock(g, x, z);
+			else
+				gridClear(g, x, z);
+			hpaUpdate(&h, g, x, z);
+		}
+	}
+	t1 = now();
+	printf("%-9s update %7.1f us/cell\n", name, (t1 - t0) * 1e6 / (2 * updates));
+
+	pathInit(&pf, 1024);
+	for(q=0; q < queries; q++)
+		findPath(&pf, g, from[q], to[q], PATH_ASTAR, &path);
+	t0 = now();
+	for(q=0; q < queries; q++)
+		flat[q] = findPath(&pf, g, from[q], to[q], PATH_ASTAR, &path);
+	t1 = now();
+	printf("%-9s %-12s %10.3f ms/query\n", name, "A*", (t1 - t0) * 1e3 / queries);
+
+	t0 = now();
+	for(q=0; q < queries; q++)
+	{
+		hpaFindPath(&h, g, from[q], to[q], &way);
+		expanded += h.expanded;
+	}
+	t1 = now();
+	printf("%-9s %-12s %10.3f ms/query  %8.1f expanded/query\n", name, "HPA*", (t1 - t0) * 1e3 / queries,
+			(double)expanded / queries);
+
+	t0 = now();
+	for(q=0; q < queries; q++)
+	{
+		long cost = hpaFindPath(&h, g, from[q], to[q], &way);
+		cells.clear();
+		for(i=0; i + 1 < way.size(); i++)
+			hpaRefine(&h, g, way, i, &cells);
+		if(flat[q] >= 0)
+			found++;
+		if((cost >= 0) != (flat[q] >= 0))
+			mismatch++;
+		else if(flat[q] > 0)
+			ratio += (double)cost / flat[q];
+	}
+	t1 = now();
+	printf("%-9s %-12s %10.3f ms/query\n", name, "HPA*+refine", (t1 - t0) * 1e3 / queries);
+	printf("%-9s %d/%d reachable, %d mismatches, ratio %.3f\n", name, found, queries, mismatch,
+			found ? ratio / found : 0);
+}
+
+static void randomGrid(struct Grid *g, int side, uint32_t seed)
+{
+	struct Pcg32 rng;
+	int x, z;
+
+	pcgSeed(&rng, seed, 1);
+	gridInit(g, side, side);
+	for(z=0; z < side; z++)
+		for(x=0; x < side; x++)
+			if(pcgRange(&rng, 5) == 0)
+				gridBlock(g, x, z);
+}
+
+int main(int argc, char **argv)
+{
+	double scale = argc > 1 ? atof(argv[1]) : 1;
+	struct Course course;
+	struct Grid g;
+
+	generateMazeCourse(&course, 1, 2001, 2001);
+	gridFromCourse(&g, &course);
+	bench("maze 2k", &g, 20 * scale, 10000 * scale);
+
+	randomGrid(&g, 4000, 1);
+	bench("4kx4k", &g, 20 * scale, 10000 * scale);
+	return EXIT_SUCCESS;
+}
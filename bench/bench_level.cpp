@@ -0,0 +1,155 @@
+/* Loading a mapped level against building the course at startup.
+ *
+ *   make bench && ./bench/bench_level [file] [maze-side]
+ *
+ * Generates a 1101 x 1101 maze course, about 100 MB once baked, and times
+ * what startup costs today: generating it, indexing it and meshing it. Then
+ * writes it as a level file and loads it, cold (its pages dropped from the
+ * page cache first) and warm:
+ *   - open: levelOpen, mmap and the header
+ *   - play: levelCourse and a second of simulation on the mapped index
+ *   - touch: reading every vertex, as the upload to the GPU does
+ * with the page faults each took, then reading the whole file into memory
+ * instead, and the validator's full check. Opening must take microseconds
+ * and the rest go with the pages touched.
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "../level.h"
+#include "../maze.h"
+#include "../mesh.h"
+#include "../sim.h"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+volatile float sink;  // keeps the timed loops from being optimised away
+
+static long faults()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_minflt + ru.ru_majflt;
+}
+
+/* Drop the file's pages from the page cache, so the next load is cold */
+static void dropCache(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+
+	if(fd < 0)
+		return;
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+static void step(const char *name, double t, long f)
+{
+	printf("  %-6s %9.3f ms  %7ld page faults\n", name, t * 1e3, f);
+}
+
+static bool load(const char *path, bool cold)
+{
+	struct Level lv;
+	struct Course course;
+	struct SimState s;
+	double t0;
+	long f0;
+	float sum = 0;
+	size_t v;
+	int tick;
+
+	if(cold)
+		dropCache(path);
+	printf("%s:\n", cold ? "cold" : "warm");
+	f0 = faults();
+	t0 = now();
+	if(!levelOpen(&lv, path))
+		return false;
+	step("open", now() - t0, faults() - f0);
+
+	f0 = faults();
+	t0 = now();
+	levelCourse(&lv, &course);
+	simReset(&s, &course);
+	for(tick=0; tick < SIM_HZ; tick++)
+		simStep(&s, &course, tick & 1 ? IN_UP : IN_RIGHT);
+	step("play", now() - t0, faults() - f0);
+
+	f0 = faults();
+	t0 = now();
+	for(v=0; v < 3 * lv.vertices; v++)
+		sum += lv.pos[v] + lv.color[v];
+	sink = sum;
+	step("touch", now() - t0, faults() - f0);
+	levelClose(&lv);
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = argc > 1 ? argv[1] : "/tmp/bench_level.lvl";
+	int side = argc > 2 ? atoi(argv[2]) | 1 : 1101;
+	struct Course course;
+	struct LevelBake bake;
+	struct Mesh mesh;
+	struct Level lv;
+	std::vector<char> copy;
+	double t0, t_gen, t_mesh;
+	bool ok;
+	long f0;
+	FILE *f;
+
+	t0 = now();
+	generateMazeCourse(&course, 1, side, side);
+	t_gen = now() - t0;
+	t0 = now();
+	meshCourse(&mesh, &course, 0, course.d);
+	t_mesh = now() - t0;
+	printf("%d x %d maze course: generate and index %.1f ms, mesh %.1f ms (%.1f MB)\n", side, side,
+			t_gen * 1e3, t_mesh * 1e3, meshBytes(&mesh) / 1e6);
+
+	t0 = now();
+	levelBake(&bake, &course);
+	if(!levelWrite(path, &course, &bake))
+		return EXIT_FAILURE;
+	printf("baked and written in %.1f ms\n", (now() - t0) * 1e3);
+
+	if(!load(path, true) || !load(path, false))
+		return EXIT_FAILURE;
+
+	dropCache(path);
+	f0 = faults();
+	t0 = now();
+	f = fopen(path, "rb");
+	if(!f)
+		return EXIT_FAILURE;
+	fseek(f, 0, SEEK_END);
+	copy.resize(ftell(f));
+	fseek(f, 0, SEEK_SET);
+	if(fread(copy.data(), 1, copy.size(), f) != copy.size())
+		return EXIT_FAILURE;
+	fclose(f);
+	printf("read the %.1f MB file into memory instead, cold: %.1f ms, %ld page faults\n", copy.size() / 1e6,
+			(now() - t0) * 1e3, faults() - f0);
+
+	t0 = now();
+	if(!levelOpen(&lv, path))
+		return EXIT_FAILURE;
+	ok = levelCheck(&lv);
+	printf("full check: %s in %.1f ms\n", ok ? "OK" : "FAIL", (now() - t0) * 1e3);
+	levelClose(&lv);
+	return EXIT_SUCCESS;
+}
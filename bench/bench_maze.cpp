@@ -0,0 +1,91 @@
+/* Maze generator throughput and memory.
+ *
+ *   make bench && ./bench/bench_maze [side ...]
+ *
+ * Generates a side x side maze with every algorithm (default sides 100,
+ * 1000 and 10000) and reports cells per second, the scratch memory the
+ * generator asked for, and the peak resident size of the process. Each
+ * run happens in its own child process so the peaks don't mix. Wilson's
+ * first walks grow too long beyond WILSON_MAX cells and are skipped there.
+ * Every maze is checked to have exactly cells-1 passages.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "../maze.h"
+
+#define WILSON_MAX (4000 * 4000)
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t passages(const struct Maze *m)
+{
+	size_t n = 0, i;
+
+	for(i=0; i < m->bits.size(); i++)
+		n += __builtin_popcountll(m->bits[i]);
+	return n;
+}
+
+static void run(int side, int algo)
+{
+	struct Maze m;
+	double t0, t1;
+	size_t scratch, cells = (size_t)side * side;
+
+	t0 = now();
+	scratch = generateMaze(&m, side, side, 1, algo);
+	t1 = now();
+	printf("%6d %-10s %8.3f s %8.2f Mcells/s  maze %7.1f MB  scratch %7.1f MB  %s",
+			side, mazeAlgoName(algo), t1 - t0, cells / (t1 - t0) / 1e6,
+			m.bits.size() * 8 / 1e6, scratch / 1e6,
+			passages(&m) == cells - 1 ? "ok" : "BROKEN");
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	int defaults[] = { 100, 1000, 10000 };
+	int nsides = argc > 1 ? argc - 1 : 3;
+	int i, algo;
+
+	for(i=0; i < nsides; i++)
+	{
+		int side = argc > 1 ? atoi(argv[i+1]) : defaults[i];
+		for(algo=0; algo < MAZE_ALGOS; algo++)
+		{
+			struct rusage ru;
+			int status;
+			pid_t pid;
+
+			if(algo == MAZE_WILSON && (long long)side * side > WILSON_MAX)
+			{
+				printf("%6d %-10s skipped\n", side, mazeAlgoName(algo));
+				continue;
+			}
+			fflush(stdout);
+			pid = fork();
+			if(pid == 0)
+			{
+				run(side, algo);
+				_exit(0);
+			}
+			if(pid < 0 || wait4(pid, &status, 0, &ru) < 0)
+			{
+				perror("fork");
+				return EXIT_FAILURE;
+			}
+			printf("  peak %7.1f MB\n", ru.ru_maxrss / 1e3);
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,312 @@
+/* Morton order inside sparse chunks against row-major.
+ *
+ *   make bench && ./bench/bench_morton [queries-scale]
+ *
+ * Fills a 16384 x 16384 level (256 MB of chunks, well past the caches)
+ * with random flags, and keeps a second copy of it with each chunk laid
+ * out row by row. Both are asked:
+ *   - box: the flags of the 9 x 9 cells around random points, as the
+ *     collision code asks around the player
+ *   - column: every cell down random columns, as a camera looking along
+ *     the rows or a path search going north does
+ *   - row: every cell along random rows, row-major's best case
+ * Each is timed, and counted with the L1 data cache and last level cache
+ * miss counters where perf_event_open is allowed. Where it isn't, as in
+ * most VMs, the distinct cache lines each query reads still show how much
+ * each layout has to bring in. Both layouts must give the same flags.
+ * Then times encoding and decoding Morton codes with the shifts and masks
+ * sparse.h uses without BMI2, against pdep and pext.
+ */
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "../rng.h"
+#include "../sparse.h"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+volatile unsigned sink;  // keeps the timed loops from being optimised away
+
+#define SIZE 16384
+#define BOX 4  // cells each side of the centre
+
+/* A hardware cache counter, or -1 if the kernel won't give us one */
+static int counterOpen(uint32_t type, uint64_t config)
+{
+	struct perf_event_attr a;
+
+	memset(&a, 0, sizeof(a));
+	a.size = sizeof(a);
+	a.type = type;
+	a.config = config;
+	a.disabled = 1;
+	a.exclude_kernel = 1;
+	a.exclude_hv = 1;
+	return syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+struct Counters {
+	int fd[2];  // L1D read misses, last level misses
+	long long v[2];
+};
+
+static void countStart(struct Counters *pc)
+{
+	int n;
+
+	for(n=0; n < 2; n++)
+		if(pc->fd[n] >= 0)
+		{
+			ioctl(pc->fd[n], PERF_EVENT_IOC_RESET, 0);
+			ioctl(pc->fd[n], PERF_EVENT_IOC_ENABLE, 0);
+		}
+}
+
+static void countStop(struct Counters *pc)
+{
+	int n;
+
+	for(n=0; n < 2; n++)
+	{
+		pc->v[n] = -1;
+		if(pc->fd[n] >= 0)
+		{
+			ioctl(pc->fd[n], PERF_EVENT_IOC_DISABLE, 0);
+			if(read(pc->fd[n], &pc->v[n], sizeof(pc->v[n])) != sizeof(pc->v[n]))
+				pc->v[n] = -1;
+		}
+	}
+}
+
+/* The row-major copy: same hash and chunks, cell (i, k) of a chunk at k*32 + i */
+static inline uint32_t rowIndex(int x, int z)
+{
+	return (z & (SPARSE_CHUNK - 1)) * SPARSE_CHUNK + (x & (SPARSE_CHUNK - 1));
+}
+
+static unsigned rowBox(const struct SparseWorld *sw, int x0, int z0, int x1, int z1)
+{
+	unsigned flags = 0;
+	int cx, cz, i, k;
+
+	for(cz=z0 >> SPARSE_BITS; cz <= z1 >> SPARSE_BITS; cz++)
+		for(cx=x0 >> SPARSE_BITS; cx <= x1 >> SPARSE_BITS; cx++)
+		{
+			const uint8_t *c = sparseChunk(sw, sparseKey(cx * SPARSE_CHUNK, cz * SPARSE_CHUNK));
+			int i0 = std::max(x0, cx * SPARSE_CHUNK), i1 = std::min(x1, cx * SPARSE_CHUNK + SPARSE_CHUNK - 1);
+			int k0 = std::max(z0, cz * SPARSE_CHUNK), k1 = std::min(z1, cz * SPARSE_CHUNK + SPARSE_CHUNK - 1);
+			if(!c)
+				continue;
+			for(k=k0; k <= k1; k++)
+				for(i=i0; i <= i1; i++)
+					flags |= c[rowIndex(i, k)];
+		}
+	return flags;
+}
+
+static inline unsigned rowCellAt(const struct SparseWorld *sw, struct SparseCursor *cur, int x, int z)
+{
+	uint64_t key = sparseKey(x, z);
+
+	if(key != cur->key)
+	{
+		cur->key = key;
+		cur->chunk = sparseChunk(sw, key);
+	}
+	return cur->chunk ? cur->chunk[rowIndex(x, z)] : 0;
+}
+
+static unsigned query(const struct SparseWorld *sw, bool morton, int kind, const std::vector<int> &at)
+{
+	struct SparseCursor cur;
+	unsigned sum = 0;
+	size_t n;
+	int j;
+
+	for(n=0; n < at.size(); n += 2)
+	{
+		int x = at[n], z = at[n + 1];
+		if(kind == 0)
+			sum += morton ? sparseBox(sw, x - BOX, z - BOX, x + BOX, z + BOX) : rowBox(sw, x - BOX, z - BOX, x + BOX, z + BOX);
+		else
+		{
+			sparseCursor(&cur, sw);
+			for(j=0; j < SIZE; j++)
+			{
+				int cx = kind == 1 ? x : j, cz = kind == 1 ? j : z;
+				sum += morton ? sparseCellAt(sw, &cur, cx, cz) : rowCellAt(sw, &cur, cx, cz);
+			}
+		}
+	}
+	return sum;
+}
+
+/* Distinct cache lines one query reads from the chunks */
+static size_t footprint(const struct SparseWorld *sw, bool morton, int kind, int x, int z)
+{
+	std::vector<uintptr_t> lines;
+	int j, i0 = x - BOX, i1 = x + BOX, k0 = z - BOX, k1 = z + BOX, i, k;
+
+	if(kind == 1)
+		k0 = 0, k1 = SIZE - 1, i0 = i1 = x;
+	else if(kind == 2)
+		i0 = 0, i1 = SIZE - 1, k0 = k1 = z;
+	for(k=k0; k <= k1; k++)
+		for(i=i0; i <= i1; i++)
+		{
+			const uint8_t *c = sparseChunk(sw, sparseKey(i, k));
+			j = morton ? sparseIndex(i, k) : rowIndex(i, k);
+			lines.push_back((uintptr_t)(c + j) / 64);
+		}
+	std::sort(lines.begin(), lines.end());
+	return std::unique(lines.begin(), lines.end()) - lines.begin();
+}
+
+static void compare(const struct SparseWorld *morton, const struct SparseWorld *rows, struct Counters *pc,
+		const char *name, int kind, size_t n)
+{
+	struct Pcg32 rng;
+	std::vector<int> at(2 * n);
+	unsigned sum[2];
+	size_t i;
+	int l;
+
+	pcgSeed(&rng, kind, 0x6d6f7274);
+	for(i=0; i < at.size(); i++)
+		at[i] = BOX + pcgRange(&rng, SIZE - 2 * BOX);
+	for(l=0; l < 2; l++)
+	{
+		double t0, t;
+		size_t lines, cells = kind == 0 ? n * (2 * BOX + 1) * (2 * BOX + 1) : n * SIZE;
+		countStart(pc);
+		t0 = now();
+		sum[l] = query(l ? morton : rows, l, kind, at);
+		t = now() - t0;
+		countStop(pc);
+		for(i=0, lines=0; i < std::min(n, (size_t)1000); i++)
+			lines += footprint(l ? morton : rows, l, kind, at[2 * i], at[2 * i + 1]);
+		printf("  %-6s %-9s %7.1f M cells/s  %6.3f lines/cell", name, l ? "morton" : "row-major", cells / t / 1e6,
+				(double)lines / (std::min(n, (size_t)1000) * (cells / n)));
+		if(pc->v[0] >= 0)
+			printf("  L1D misses %6.3f/cell", (double)pc->v[0] / cells);
+		if(pc->v[1] >= 0)
+			printf("  LLC misses %6.3f/cell", (double)pc->v[1] / cells);
+		printf("\n");
+	}
+	sink = sum[0] + sum[1];
+	if(sum[0] != sum[1])
+		printf("  MISMATCH %u %u\n", sum[0], sum[1]);
+}
+
+__attribute__((target("bmi2")))
+static uint32_t encodeBmi2(uint32_t x, uint32_t z)
+{
+	return _pdep_u32(x, MORTON_X) | _pdep_u32(z, MORTON_Z);
+}
+
+__attribute__((target("bmi2")))
+static void codecBmi2(const std::vector<uint32_t> &v, uint32_t *sum)
+{
+	size_t n;
+
+	for(n=0; n < v.size(); n++)
+	{
+		uint32_t m = encodeBmi2(v[n] & 0xffff, v[n] >> 16);
+		*sum += m + _pext_u32(m, MORTON_X) + _pext_u32(m, MORTON_Z);
+	}
+}
+
+static void codecShifts(const std::vector<uint32_t> &v, uint32_t *sum)
+{
+	size_t n;
+
+	for(n=0; n < v.size(); n++)
+	{
+		uint32_t m = mortonEncode(v[n] & 0xffff, v[n] >> 16), x, z;
+		mortonDecode(m, &x, &z);
+		*sum += m + x + z;
+	}
+}
+
+static void codec(size_t n)
+{
+	std::vector<uint32_t> v(n);
+	struct Pcg32 rng;
+	uint32_t sum[2] = { 0, 0 };
+	double t0, t[2];
+	size_t i;
+
+	pcgSeed(&rng, 1, 0x636f6465);
+	for(i=0; i < n; i++)
+		v[i] = pcgNext(&rng);
+	t0 = now();
+	codecShifts(v, &sum[0]);
+	t[0] = now() - t0;
+	if(__builtin_cpu_supports("bmi2"))
+	{
+		t0 = now();
+		codecBmi2(v, &sum[1]);
+		t[1] = now() - t0;
+		printf("encode+decode: shifts %.0f M/s, pdep/pext %.0f M/s%s\n", n / t[0] / 1e6, n / t[1] / 1e6,
+				sum[0] != sum[1] ? "  MISMATCH" : "");
+	}
+	else
+		printf("encode+decode: shifts %.0f M/s, no BMI2 here\n", n / t[0] / 1e6);
+	sink = sum[0] + sum[1];
+}
+
+int main(int argc, char **argv)
+{
+	double scale = argc > 1 ? atof(argv[1]) : 1;
+	struct SparseWorld *morton = new struct SparseWorld, *rows = new struct SparseWorld;
+	struct Counters pc;
+	struct Pcg32 rng;
+	size_t c;
+	int x, z, m;
+
+	pc.fd[0] = counterOpen(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+			PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	pc.fd[1] = counterOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	if(pc.fd[0] < 0 && pc.fd[1] < 0)
+		printf("no perf counters here (perf_event_paranoid?), timing only\n");
+
+	pcgSeed(&rng, 2, 0x6c766c);
+	sparseInit(morton);
+	for(z=0; z < SIZE; z++)
+		for(x=0; x < SIZE; x++)
+			sparseSet(morton, x, z, 1 + pcgRange(&rng, 7));
+	/* Same table, each chunk's cells moved to row-major places */
+	*rows = *morton;
+	for(c=0; c < morton->chunks; c++)
+		for(m=0; m < SPARSE_CELLS; m++)
+		{
+			uint32_t i, k;
+			mortonDecode(m, &i, &k);
+			rows->data[c * SPARSE_CELLS + k * SPARSE_CHUNK + i] = morton->data[c * SPARSE_CELLS + m];
+		}
+	printf("%d x %d, %zu chunks, %.0f MB\n", SIZE, SIZE, morton->chunks, sparseBytes(morton) / 1e6);
+
+	compare(morton, rows, &pc, "box", 0, 2000000 * scale);
+	compare(morton, rows, &pc, "column", 1, 2000 * scale);
+	compare(morton, rows, &pc, "row", 2, 2000 * scale);
+	codec(50000000 * scale);
+	delete morton;
+	delete rows;
+	return EXIT_SUCCESS;
+}
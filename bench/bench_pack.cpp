@@ -0,0 +1,130 @@
+/* Packed courses: how small, and how fast to pack and unpack.
+ *
+ *   make bench && ./bench/bench_pack
+ *
+ * Packs maze courses from 51 x 51 to 4001 x 4001 and a few random courses
+ * to memory and back, checking every one comes back cell for cell. Sizes
+ * are against the course as the game holds it, a byte a tile and 8 bytes
+ * an obstacle, which is also what a level file's tile and obstacle
+ * sections take. Speeds are in MB of that a second.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "../course.h"
+#include "../maze.h"
+#include "../pack.h"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool toMemory(void *ctx, const uint8_t *p, size_t n)
+{
+	std::vector<uint8_t> *out = (std::vector<uint8_t> *)ctx;
+	out->insert(out->end(), p, p + n);
+	return true;
+}
+
+static bool toNowhere(void *ctx, const uint8_t *p, size_t n)
+{
+	(void)ctx;
+	(void)p;
+	(void)n;
+	return true;
+}
+
+struct Memory {
+	const uint8_t *p;
+	size_t left;
+};
+
+static size_t fromMemory(void *ctx, uint8_t *p, size_t n)
+{
+	struct Memory *m = (struct Memory *)ctx;
+	if(n > m->left)
+		n = m->left;
+	memcpy(p, m->p, n);
+	m->p += n;
+	m->left -= n;
+	return n;
+}
+
+/* Same tiles and same obstacle cells */
+static bool same(const struct Course *a, const struct Course *b)
+{
+	return a->w == b->w && a->d == b->d && a->spawn_x == b->spawn_x && a->spawn_z == b->spawn_z &&
+			a->seed == b->seed && a->maze == b->maze && a->tiles == b->tiles &&
+			a->index.own == b->index.own;
+}
+
+static bool run(const char *what, const struct Course *course)
+{
+	std::vector<uint8_t> packed;
+	struct Course back;
+	struct Memory m;
+	double raw = course->tiles.size() + course->obs.size() * sizeof(struct Obstacle);
+	double t0, t_enc, t_dec;
+	int reps, n;
+
+	packWrite(course, toMemory, &packed);
+	m.p = packed.data();
+	m.left = packed.size();
+	if(!packRead(&back, fromMemory, &m) || !same(course, &back))
+	{
+		printf("%s: FAIL, does not come back the same\n", what);
+		return false;
+	}
+
+	/* Enough repeats for about a tenth of a second each way */
+	reps = 1 + (int)(2e7 / raw);
+	t0 = now();
+	for(n=0; n < reps; n++)
+		packWrite(course, toNowhere, NULL);
+	t_enc = (now() - t0) / reps;
+	t0 = now();
+	for(n=0; n < reps; n++)
+	{
+		m.p = packed.data();
+		m.left = packed.size();
+		packRead(&back, fromMemory, &m);
+	}
+	t_dec = (now() - t0) / reps;
+
+	printf("%-22s %11.0f %10zu %8.1f:1 %6.2f bits/cell %8.0f %8.0f\n", what, raw, packed.size(),
+			raw / packed.size(), packed.size() * 8.0 / course->tiles.size(), raw / t_enc / 1e6, raw / t_dec / 1e6);
+	return true;
+}
+
+int main()
+{
+	static const int maze_sides[] = { 51, 201, 1001, 4001 };
+	static const int random_sides[] = { 20, 200, 1000 };
+	struct Course *course = new struct Course;
+	char what[64];
+	bool ok = true;
+	size_t n;
+
+	printf("%-22s %11s %10s %10s %15s %8s %8s\n", "course", "raw bytes", "packed", "ratio", "", "enc MB/s", "dec MB/s");
+	for(n=0; n < sizeof(maze_sides) / sizeof(maze_sides[0]); n++)
+	{
+		generateMazeCourse(course, 1, maze_sides[n], maze_sides[n]);
+		snprintf(what, sizeof(what), "maze %d x %d", maze_sides[n], maze_sides[n]);
+		ok = run(what, course) && ok;
+	}
+	for(n=0; n < sizeof(random_sides) / sizeof(random_sides[0]); n++)
+	{
+		generateCourse(course, 1, random_sides[n] < COURSE_W ? COURSE_W : random_sides[n], random_sides[n]);
+		snprintf(what, sizeof(what), "random %d x %d", course->w, course->d);
+		ok = run(what, course) && ok;
+	}
+	delete course;
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,119 @@
+/* Path query throughput, A* against Jump Point Search.
+ *
+ *   make bench && ./bench/bench_path [queries-scale]
+ *
+ * Runs random start/goal queries on the classic 17x20 course and on
+ * 1k x 1k and 8k x 8k grids with 20% of the cells blocked at random.
+ * Each set of queries is run once to warm up the finder's pools and then
+ * timed; the "grows" column counts pool growth during the timed pass and
+ * should be 0. Both searches must agree on every path cost.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vector>
+
+#include "../path.h"
+#include "../rng.h"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct PathPoint freeCell(const struct Grid *g, struct Pcg32 *rng)
+{
+	struct PathPoint p;
+
+	do {
+		p.x = pcgRange(rng, g->w);
+		p.z = pcgRange(rng, g->d);
+	} while(!gridFree(g, p.x, p.z));
+	return p;
+}
+
+static void bench(const char *name, const struct Grid *g, int queries)
+{
+	std::vector<struct PathPoint> from(queries), to(queries), path;
+	std::vector<long> cost[2];
+	struct PathFinder pf;
+	struct Pcg32 rng;
+	int algo, pass, q, found = 0, mismatch = 0;
+
+	pcgSeed(&rng, 42, 0);
+	for(q=0; q < queries; q++)
+	{
+		from[q] = freeCell(g, &rng);
+		to[q] = freeCell(g, &rng);
+	}
+	pathInit(&pf, 1024);
+
+	for(algo=0; algo < 2; algo++)
+	{
+		double t0 = 0, t1 = 0;
+		size_t expanded = 0, cells = 0;
+
+		cost[algo].resize(queries);
+		for(pass=0; pass < 2; pass++)
+		{
+			if(pass == 1)
+			{
+				pf.grows = 0;
+				t0 = now();
+			}
+			for(q=0; q < queries; q++)
+			{
+				cost[algo][q] = findPath(&pf, g, from[q], to[q], algo, &path);
+				if(pass == 1)
+				{
+					expanded += pf.expanded;
+					cells += path.size();
+				}
+			}
+			t1 = now();
+		}
+		printf("%-9s %-5s %10.1f queries/s  %9.1f expanded/query  %8.1f cells/path  grows %zu\n",
+				name, algo == PATH_JPS ? "JPS" : "A*", queries / (t1 - t0),
+				(double)expanded / queries, (double)cells / queries, pf.grows);
+	}
+	for(q=0; q < queries; q++)
+	{
+		found += cost[0][q] >= 0;
+		mismatch += cost[0][q] != cost[1][q];
+	}
+	printf("%-9s %d/%d reachable, %d cost mismatches\n", name, found, queries, mismatch);
+}
+
+static void randomGrid(struct Grid *g, int side, uint32_t seed)
+{
+	struct Pcg32 rng;
+	int x, z;
+
+	pcgSeed(&rng, seed, 1);
+	gridInit(g, side, side);
+	for(z=0; z < side; z++)
+		for(x=0; x < side; x++)
+			if(pcgRange(&rng, 5) == 0)
+				gridBlock(g, x, z);
+}
+
+int main(int argc, char **argv)
+{
+	double scale = argc > 1 ? atof(argv[1]) : 1;
+	struct Course course;
+	struct Grid g;
+
+	generateCourse(&course, 1);
+	gridFromCourse(&g, &course);
+	bench("17x20", &g, 100000 * scale);
+
+	randomGrid(&g, 1000, 1);
+	bench("1kx1k", &g, 200 * scale);
+
+	randomGrid(&g, 8000, 2);
+	bench("8kx8k", &g, 10 * scale);
+	return EXIT_SUCCESS;
+}
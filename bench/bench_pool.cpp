@@ -0,0 +1,175 @@
+/* Pooled vertex buffers under churn.
+ *
+ *   make bench && ./bench/bench_pool [frames]
+ *
+ * Keeps about 2000 meshes alive, chunk meshes of a few hundred to a few
+ * thousand vertices with the odd big one, and every frame frees some at
+ * random and allocates as many again, as streaming and re-meshing do.
+ * Three cases:
+ *
+ *   churn   just that
+ *   thrash  now and then half the meshes are swapped for small ones,
+ *           which the churn grows back over the next hundred frames: the
+ *           free space comes and goes, and emptying buffers into it only
+ *           to make them again is what defragmenting mustn't do
+ *   shrink  a quarter of the way in, half the meshes go for good, as on
+ *           a smaller course: what defragmenting should give back
+ *
+ * Each runs once without poolDefrag and once calling it every frame with
+ * a budget, and prints, a quarter of the way through at a time, the
+ * buffers held, vertices reserved and in use, free space and its
+ * fragmentation, and what defragmenting moved; then the buffers made
+ * over the run. Buffers are malloc'd and copies memcpy'd, 24 bytes a
+ * vertex as the game's position and colour take. Also times allocating
+ * and freeing.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "../pool.h"
+
+#define VERTEX_BYTES 24
+#define LIVE 2000
+#define CHURN 40          // meshes replaced a frame
+#define DEFRAG_BUDGET (1 << 15)
+#define PAIRS 1000000     // frees and allocations timed
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *create(size_t size, void *ctx)
+{
+	(void)ctx;
+	return calloc(size, VERTEX_BYTES);
+}
+
+static void destroy(void *gpu, void *ctx)
+{
+	(void)ctx;
+	free(gpu);
+}
+
+static void copy(void *from, size_t from_offset, void *to, size_t to_offset, size_t count, void *ctx)
+{
+	(void)ctx;
+	memcpy((char *)to + to_offset * VERTEX_BYTES, (char *)from + from_offset * VERTEX_BYTES, count * VERTEX_BYTES);
+}
+
+static uint32_t rng = 1;
+
+static uint32_t rand32()
+{
+	rng = rng * 1664525 + 1013904223;
+	return rng >> 8;
+}
+
+/* Mostly chunk sized, now and then a big band */
+static size_t meshSize()
+{
+	if(rand32() % 50 == 0)
+		return 20000 + rand32() % 60000;
+	return 200 + rand32() % 5000;
+}
+
+static void report(const struct Pool *p, int frame)
+{
+	struct PoolStats s;
+
+	poolStats(p, &s);
+	printf("  frame %5d: %3zu buffers, %6.1f MB reserved, %6.1f MB used, %6.1f MB free, largest %5.1f MB, fragmentation %4.1f%%, moved %7.1f MB\n",
+			frame, s.buffers, s.reserved * (double)VERTEX_BYTES / 1e6, s.used * (double)VERTEX_BYTES / 1e6,
+			s.free * (double)VERTEX_BYTES / 1e6, s.largest * (double)VERTEX_BYTES / 1e6, s.fragmentation * 100,
+			s.moved * (double)VERTEX_BYTES / 1e6);
+}
+
+enum { CHURN_ONLY, THRASH, SHRINK };
+
+static void run(int frames, int what, bool defrag)
+{
+	static const char *names[] = { "churn", "thrash", "shrink" };
+	struct Pool pool;
+	std::vector<struct PoolAlloc *> live;
+	struct PoolStats s;
+	size_t n;
+	int f, c;
+
+	rng = 1;
+	poolInit(&pool, create, destroy, copy, NULL);
+	printf("%s, %s:\n", names[what], defrag ? "defragmenting every frame" : "no defragmenting");
+	for(n=0; n < LIVE; n++)
+	{
+		live.push_back(poolAlloc(&pool, meshSize()));
+		live.back()->count = live.back()->size;
+	}
+	for(f=1; f <= frames; f++)
+	{
+		for(c=0; c < CHURN; c++)
+		{
+			n = rand32() % live.size();
+			poolFree(&pool, live[n]);
+			live[n] = poolAlloc(&pool, meshSize());
+			live[n]->count = live[n]->size;
+		}
+		if(what == THRASH && f % 500 == 250)
+			for(n=0; n < live.size(); n += 2)
+			{
+				poolFree(&pool, live[n]);
+				live[n] = poolAlloc(&pool, 100 + rand32() % 500);
+				live[n]->count = live[n]->size;
+			}
+		if(what == SHRINK && f == frames / 4)
+		{
+			for(n=live.size() / 2; n < live.size(); n++)
+				poolFree(&pool, live[n]);
+			live.resize(live.size() / 2);
+		}
+		if(defrag)
+			poolDefrag(&pool, DEFRAG_BUDGET);
+		if(f % (frames / 4) == 0)
+			report(&pool, f);
+	}
+	poolStats(&pool, &s);
+	printf("  %zu allocations and %zu frees, %zu buffers made, where a buffer pair per mesh would have made %zu\n",
+			s.allocs, s.frees, s.created, 2 * s.allocs);
+	poolClear(&pool);
+}
+
+int main(int argc, char **argv)
+{
+	int frames = argc > 1 ? atoi(argv[1]) : 2000, n;
+	std::vector<struct PoolAlloc *> held;
+	struct Pool pool;
+	double t0;
+
+	if(frames < 4)
+		frames = 4;
+	for(n=CHURN_ONLY; n <= SHRINK; n++)
+	{
+		run(frames, n, false);
+		run(frames, n, true);
+	}
+
+	/* Allocation speed alone, no GPU behind it */
+	poolInit(&pool, NULL, NULL, NULL, NULL);
+	for(n=0; n < LIVE; n++)
+		held.push_back(poolAlloc(&pool, meshSize()));
+	t0 = now();
+	for(n=0; n < PAIRS; n++)
+	{
+		int i = rand32() % LIVE;
+		poolFree(&pool, held[i]);
+		held[i] = poolAlloc(&pool, meshSize());
+	}
+	printf("free and allocate: %.0f ns a pair with %d live\n", (now() - t0) / PAIRS * 1e9, LIVE);
+	poolClear(&pool);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+/* Batched line of sight raycasts.
+ *
+ *   make bench && ./bench/bench_ray [ticks-scale]
+ *
+ * Casts batches of 10k rays, one batch per simulated tick, on the 17x20
+ * course, a generated 2001x2001 course and a 2001x2001 maze course. Rays
+ * are NPC-style sight lines of up to 16 cells from random points, and on
+ * the big courses also long lines of up to 500 cells. Both
+ * implementations must give the same hits.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "../maze.h"
+#include "../ray.h"
+#include "../rng.h"
+
+#define RAYS_PER_TICK 10000
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static float unit(struct Pcg32 *rng)
+{
+	return pcgNext(rng) / 4294967296.0f;
+}
+
+static void bench(const char *name, const struct Course *course, float range, int ticks)
+{
+	std::vector<struct Ray> rays(RAYS_PER_TICK);
+	std::vector<struct RayHit> out[RAY_IMPLS];
+	struct Pcg32 rng;
+	struct Grid g;
+	double cells = 0;
+	size_t hits[RAY_IMPLS];
+	int impl, tick, i, mismatch = 0;
+
+	rayGrid(&g, course);
+	pcgSeed(&rng, 42, 0);
+	for(i=0; i < RAYS_PER_TICK; i++)
+	{
+		struct Ray *r = &rays[i];
+		r->x0 = unit(&rng) * course->w;
+		r->z0 = unit(&rng) * course->d;
+		r->x1 = r->x0 + (unit(&rng) * 2 - 1) * range;
+		r->z1 = r->z0 + (unit(&rng) * 2 - 1) * range;
+	}
+
+	printf("%-10s %5.0f cells ", name, range);
+	for(impl=0; impl < RAY_IMPLS; impl++)
+	{
+		double t0, t1;
+
+		out[impl].resize(RAYS_PER_TICK);
+		rayCast(&g, rays.data(), RAYS_PER_TICK, impl, out[impl].data());
+		hits[impl] = 0;
+		t0 = now();
+		for(tick=0; tick < ticks; tick++)
+			hits[impl] += rayCast(&g, rays.data(), RAYS_PER_TICK, impl, out[impl].data());
+		t1 = now();
+		printf(" %s %7.1f Mrays/s %7.1f us/tick ", rayImplName(impl),
+				(double)RAYS_PER_TICK * ticks / (t1 - t0) / 1e6, (t1 - t0) / ticks * 1e6);
+	}
+	for(i=0; i < RAYS_PER_TICK; i++)
+	{
+		const struct RayHit *a = &out[RAY_SCALAR][i], *b = &out[RAY_AVX2][i];
+		mismatch += memcmp(a, b, sizeof(*a)) != 0;
+		/* Cells walked: one per column and row crossed, plus the start */
+		cells += (fabsf(rays[i].x1 - rays[i].x0) + fabsf(rays[i].z1 - rays[i].z0)) * a->t + 1;
+	}
+	printf(" %6.1f cells/ray  %4.1f%% blocked%s\n", cells / RAYS_PER_TICK,
+			100.0 * hits[RAY_SCALAR] / ((double)RAYS_PER_TICK * ticks),
+			mismatch || hits[RAY_SCALAR] != hits[RAY_AVX2] ? "  MISMATCH" : "");
+}
+
+int main(int argc, char **argv)
+{
+	double scale = argc > 1 ? atof(argv[1]) : 1;
+	struct Course course;
+
+	generateCourse(&course, 1);
+	bench("17x20", &course, 16, 2000 * scale);
+	generateCourse(&course, 1, 2001, 2001);
+	bench("2001", &course, 16, 1000 * scale);
+	bench("2001", &course, 500, 100 * scale);
+	generateMazeCourse(&course, 1, 2001, 2001);
+	bench("maze 2001", &course, 16, 1000 * scale);
+	bench("maze 2001", &course, 500, 1000 * scale);
+	return EXIT_SUCCESS;
+}
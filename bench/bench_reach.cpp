@@ -0,0 +1,116 @@
+/* Reachability flood fill: bitboard sweeps against a plain BFS.
+ *
+ *   make bench && ./bench/bench_reach [fills-scale]
+ *
+ * Fills from the spawn of generated 17x20 courses, from random cells of
+ * 1k x 1k grids with 20% and 35% of the cells blocked, and from the spawn
+ * of a 2001 x 2001 maze course, the worst case for sweeps since every
+ * turn of a corridor back up or down costs one. All implementations must
+ * agree on the number of cells reached.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vector>
+
+#include "../reach.h"
+#include "../maze.h"
+#include "../path.h"
+#include "../rng.h"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Fill from every (board, cell) pair in turn, 'fills' times in all */
+static void bench(const char *name, const std::vector<struct Bitboard> &boards,
+		const std::vector<struct PathPoint> &from, int fills)
+{
+	struct Reach r;
+	size_t total[REACH_IMPLS];
+	int impl, f;
+
+	for(impl=0; impl < REACH_IMPLS; impl++)
+	{
+		size_t sweeps = 0;
+		double t0, t1;
+
+		reachFill(&r, &boards[0], from[0].x, from[0].z, impl);
+		total[impl] = 0;
+		t0 = now();
+		for(f=0; f < fills; f++)
+		{
+			size_t n = f % boards.size();
+			total[impl] += reachFill(&r, &boards[n], from[n].x, from[n].z, impl);
+			sweeps += r.sweeps;
+		}
+		t1 = now();
+		printf("%-10s %-6s %12.1f fills/s  %10.1f Mcells/s  %8.1f sweeps/fill\n", name, reachImplName(impl),
+				fills / (t1 - t0), (double)boards[0].w * boards[0].d * fills / (t1 - t0) / 1e6,
+				(double)sweeps / fills);
+	}
+	if(total[REACH_SWEEP] != total[REACH_BFS] || total[REACH_AVX2] != total[REACH_BFS])
+		printf("%-10s MISMATCH\n", name);
+}
+
+static void randomBoards(std::vector<struct Bitboard> *boards, std::vector<struct PathPoint> *from,
+		int side, int blocked, int count)
+{
+	struct Pcg32 rng;
+	int n, x, z;
+
+	pcgSeed(&rng, blocked, 1);
+	boards->resize(count);
+	from->resize(count);
+	for(n=0; n < count; n++)
+	{
+		struct Bitboard *b = &(*boards)[n];
+		boardInit(b, side, side);
+		for(z=0; z < side; z++)
+			for(x=0; x < side; x++)
+				if((int)pcgRange(&rng, 100) >= blocked)
+					boardSet(b, x, z);
+		do {
+			(*from)[n].x = pcgRange(&rng, side);
+			(*from)[n].z = pcgRange(&rng, side);
+		} while(!boardTest(b, (*from)[n].x, (*from)[n].z));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	double scale = argc > 1 ? atof(argv[1]) : 1;
+	std::vector<struct Bitboard> boards;
+	std::vector<struct PathPoint> from;
+	struct Course course;
+	int n;
+
+	boards.resize(256);
+	from.resize(256);
+	for(n=0; n < 256; n++)
+	{
+		generateCourse(&course, n + 1);
+		boardWalkable(&boards[n], &course, true);
+		from[n].x = course.spawn_x;
+		from[n].z = course.spawn_z;
+	}
+	bench("17x20", boards, from, 2000000 * scale);
+
+	randomBoards(&boards, &from, 1000, 20, 4);
+	bench("1k 20%", boards, from, 200 * scale);
+	randomBoards(&boards, &from, 1000, 35, 4);
+	bench("1k 35%", boards, from, 200 * scale);
+
+	generateMazeCourse(&course, 1, 2001, 2001);
+	boards.resize(1);
+	from.resize(1);
+	boardWalkable(&boards[0], &course, true);
+	from[0].x = course.spawn_x;
+	from[0].z = course.spawn_z;
+	bench("maze 2k", boards, from, 10 * scale);
+	return EXIT_SUCCESS;
+}
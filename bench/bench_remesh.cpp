@@ -0,0 +1,130 @@
+/* Re-meshing only the chunks a tile edit touches.
+ *
+ *   make bench && ./bench/bench_remesh [edits]
+ *
+ * For maze courses from 101 x 101 to 4001 x 4001: meshes the whole course
+ * in chunks once, then makes edits one at a time, toggling an obstacle or
+ * knocking a hole in the floor at random cells, and waits for each to be
+ * uploaded, calling remeshUpdate as a frame would. Reports the latency
+ * from edit to upload, mean and worst, which must not grow with the
+ * course, against meshing the whole course again. The upload is a copy
+ * into a malloc'd buffer, written over in place when the new mesh fits,
+ * as glBufferSubData into the chunk's old buffer would be.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <thread>
+
+#include "../maze.h"
+#include "../remesh.h"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct Buffer {
+	size_t capacity;
+	char *p;
+};
+
+static void *upload(void *gpu, const struct Mesh *mesh, void *ctx)
+{
+	struct Buffer *b = (struct Buffer *)gpu;
+	size_t n = meshBytes(mesh);
+
+	(void)ctx;
+	if(!b || b->capacity < n)
+	{
+		if(b)
+			free(b->p);
+		else
+			b = new struct Buffer;
+		b->capacity = n + n / 2;
+		b->p = (char *)malloc(b->capacity + 1);
+	}
+	memcpy(b->p, mesh->pos.data(), mesh->pos.size() * sizeof(float));
+	memcpy(b->p + mesh->pos.size() * sizeof(float), mesh->color.data(), mesh->color.size() * sizeof(float));
+	return b;
+}
+
+static void release(void *gpu, void *ctx)
+{
+	struct Buffer *b = (struct Buffer *)gpu;
+
+	(void)ctx;
+	free(b->p);
+	delete b;
+}
+
+/* Frames until nothing is pending */
+static void settle(struct Remesher *rm)
+{
+	struct RemeshStats s;
+
+	for(;;)
+	{
+		remeshUpdate(rm, 64);
+		remeshStats(rm, &s);
+		if(s.pending == 0)
+			return;
+		std::this_thread::sleep_for(std::chrono::microseconds(20));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static const int sides[] = { 101, 501, 1001, 4001 };
+	int edits = argc > 1 ? atoi(argv[1]) : 500, threads = std::thread::hardware_concurrency(), e;
+	uint32_t x = 12345;
+	size_t n;
+
+	printf("%d edits a course, %d worker threads\n", edits, threads);
+	printf("%-12s %7s %10s %10s %10s %10s %9s\n", "course", "chunks", "first ms", "edit mean", "edit max", "full ms", "in place");
+	for(n=0; n < sizeof(sides) / sizeof(sides[0]); n++)
+	{
+		struct Course *course = new struct Course;
+		struct Remesher *rm = new struct Remesher;
+		struct RemeshStats s;
+		struct Mesh full;
+		double t0, t_first, t_full;
+
+		generateMazeCourse(course, 1, sides[n], sides[n]);
+		t0 = now();
+		remeshStart(rm, course, threads, upload, release, NULL);
+		settle(rm);
+		t_first = now() - t0;
+
+		for(e=0; e < edits; e++)
+		{
+			int i, k;
+			do
+			{
+				x = x * 1664525 + 1013904223;
+				i = (x >> 8) % course->w;
+				x = x * 1664525 + 1013904223;
+				k = (x >> 8) % course->d;
+			} while(e % 4 == 3 ? !remeshSetTile(rm, i, k, TILE_PIT) :
+					!remeshSetObstacle(rm, i, k, !(colCell(&course->index, i, k) & COL_OBSTACLE)));
+			settle(rm);
+		}
+		remeshStats(rm, &s);
+
+		t0 = now();
+		meshCourseGreedy(&full, course, 0, course->d);
+		t_full = now() - t0;
+
+		printf("%5d x %-5d %7zu %10.1f %8.3f ms %7.3f ms %10.1f %4zu/%zu\n", sides[n], sides[n], rm->chunks.size(),
+				t_first * 1e3, s.visible.sum / s.visible.n * 1e3, s.visible.max * 1e3, t_full * 1e3,
+				s.in_place, s.uploaded - rm->chunks.size());
+		remeshStop(rm);
+		delete rm;
+		delete course;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+/* Snapshot and restore cost of the rewind buffer.
+ *
+ *   make bench && ./bench/bench_rewind [ticks]
+ *
+ * Plays a random walk on the classic course, pushing every tick, then
+ * restores random ticks from the held history and checks each restored
+ * state against a plain copy taken while playing.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "../sim.h"
+#include "../rewind.h"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t ticks = argc > 1 ? atoi(argv[1]) : 1000000;
+	struct Course course;
+	struct SimState s;
+	struct Rewind *rw = new struct Rewind;
+	std::vector<struct SimState> states(ticks);
+	std::vector<unsigned> inputs(ticks);
+	double t0, t_step, t_push, t_restore;
+	uint32_t i, bad = 0, restores = ticks / 4;
+	unsigned input = 0;
+
+	srand(7);
+	for(i=0; i < ticks; i++)
+	{
+		if(i % 50 == 0)
+			input = rand() & (IN_UP | IN_DOWN | IN_RIGHT | IN_LEFT);
+		inputs[i] = input;
+	}
+
+	generateCourse(&course, 1);
+
+	/* Baseline: stepping alone */
+	simReset(&s, &course);
+	t0 = now();
+	for(i=0; i < ticks; i++)
+	{
+		simStep(&s, &course, inputs[i]);
+		states[i] = s;
+	}
+	t_step = now() - t0;
+
+	/* Stepping plus a snapshot per tick */
+	simReset(&s, &course);
+	rewindReset(rw, &s);
+	t0 = now();
+	for(i=0; i < ticks; i++)
+	{
+		simStep(&s, &course, inputs[i]);
+		rewindPush(rw, &s);
+	}
+	t_push = now() - t0 - t_step;
+
+	/* Restore random ticks from the held history. Restoring only moves the
+	   write position back, so putting next/count/head back afterwards leaves
+	   the history intact for the next restore. */
+	std::vector<uint32_t> backs(restores);
+	std::vector<struct SimState> got(restores);
+	for(i=0; i < restores; i++)
+		backs[i] = rand() % rw->count;
+	t0 = now();
+	for(i=0; i < restores; i++)
+	{
+		uint32_t next = rw->next, count = rw->count, head = rw->head;
+		got[i] = s;
+		rewindRestore(rw, backs[i], &got[i]);
+		rw->next = next;
+		rw->count = count;
+		rw->head = head;
+	}
+	t_restore = now() - t0;
+	for(i=0; i < restores; i++)
+	{
+		const struct SimState *want = &states[ticks - 1 - backs[i]];
+		if(got[i].tick != want->tick || got[i].x_cuboid != want->x_cuboid || got[i].z_cuboid != want->z_cuboid)
+			bad++;
+	}
+
+	printf("ticks %u, history %u ticks (%.1f s at %d Hz)\n", ticks, rw->count, (double)rw->count / SIM_HZ, SIM_HZ);
+	printf("memory: %zu bytes total, %zu bytes of deltas live, %zu bytes per tick raw\n",
+			sizeof(struct Rewind), rewindBytesUsed(rw), sizeof(struct SimState));
+	printf("simStep          %7.1f ns/tick\n", t_step / ticks * 1e9);
+	printf("snapshot (push)  %7.1f ns/tick\n", t_push / ticks * 1e9);
+	printf("restore          %7.1f ns/restore (%u restores, %u mismatches)\n", t_restore / restores * 1e9, restores, bad);
+
+	delete rw;
+	return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+/* Sparse world store against a dense byte per cell grid.
+ *
+ *   make bench && ./bench/bench_sparse [queries-scale]
+ *
+ * Builds a mostly empty level: walkers wander from random starts, laying a
+ * causeway three cells wide with an obstacle now and then. On an 8192 x
+ * 8192 level, which a dense grid can still hold, times lookups from both:
+ *   - random: anywhere in the level, nearly all of it water
+ *   - land: random cells of the causeways
+ *   - walk: along a causeway cell by cell, as the collision code and a
+ *     path search ask. The sparse store is timed with and without a cursor.
+ * Both must give the same flags. Then builds a 100k x 100k level the same
+ * way and reports its memory against the 10 GB a dense grid would need,
+ * and the same lookups on it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vector>
+
+#include "../rng.h"
+#include "../sparse.h"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+volatile unsigned sink;  // keeps the timed loops from being optimised away
+
+struct Level {
+	int size;
+	struct SparseWorld sparse;
+	std::vector<uint8_t> dense;     // empty when too big to hold
+	std::vector<int> land, walk;    // cells as x, z pairs
+};
+
+static void set(struct Level *lv, int x, int z, unsigned flags)
+{
+	if(x < 0 || z < 0 || x >= lv->size || z >= lv->size)
+		return;
+	sparseSet(&lv->sparse, x, z, flags);
+	if(!lv->dense.empty())
+		lv->dense[(size_t)z * lv->size + x] = flags;
+}
+
+static void build(struct Level *lv, int size, int walkers, int steps, bool dense)
+{
+	static const int dirs[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+	struct Pcg32 rng;
+	int w, s, x, z, d = 0, a, b;
+
+	pcgSeed(&rng, size, 0x73706172);
+	lv->size = size;
+	sparseInit(&lv->sparse);
+	if(dense)
+		lv->dense.assign((size_t)size * size, 0);
+	lv->land.clear();
+	lv->walk.clear();
+	for(w=0; w < walkers; w++)
+	{
+		x = pcgRange(&rng, size);
+		z = pcgRange(&rng, size);
+		for(s=0; s < steps; s++)
+		{
+			if(pcgRange(&rng, 8) == 0)
+				d = pcgRange(&rng, 4);
+			x += dirs[d][0];
+			z += dirs[d][1];
+			for(a=-1; a <= 1; a++)
+				for(b=-1; b <= 1; b++)
+					set(lv, x + a, z + b, COL_FLOOR);
+			if(pcgRange(&rng, 16) == 0)
+				set(lv, x + dirs[d][1], z + dirs[d][0], COL_FLOOR | COL_OBSTACLE);
+			if(s % 64 == 0)
+			{
+				lv->land.push_back(x);
+				lv->land.push_back(z);
+			}
+			if(w == 0)
+			{
+				lv->walk.push_back(x);
+				lv->walk.push_back(z);
+			}
+		}
+	}
+}
+
+/* Queries as x, z pairs, count is a multiple of the walk's length */
+static void queries(const struct Level *lv, int kind, size_t n, std::vector<int> *q)
+{
+	struct Pcg32 rng;
+	size_t i;
+
+	pcgSeed(&rng, kind, 0x71756572);
+	q->resize(2 * n);
+	for(i=0; i < n; i++)
+	{
+		if(kind == 0)
+		{
+			(*q)[2 * i] = pcgRange(&rng, lv->size);
+			(*q)[2 * i + 1] = pcgRange(&rng, lv->size);
+		}
+		else if(kind == 1)
+		{
+			size_t l = pcgRange(&rng, lv->land.size() / 2);
+			(*q)[2 * i] = lv->land[2 * l] + (int)pcgRange(&rng, 3) - 1;
+			(*q)[2 * i + 1] = lv->land[2 * l + 1] + (int)pcgRange(&rng, 3) - 1;
+		}
+		else
+		{
+			size_t l = i % (lv->walk.size() / 2);
+			(*q)[2 * i] = lv->walk[2 * l];
+			(*q)[2 * i + 1] = lv->walk[2 * l + 1];
+		}
+	}
+}
+
+static void timeLookups(const struct Level *lv, const char *name, int kind, size_t n)
+{
+	std::vector<int> q;
+	struct SparseCursor cur;
+	unsigned sum_dense = 0, sum_sparse = 0, sum_cursor = 0;
+	double t0, t_dense = 0, t_sparse, t_cursor;
+	size_t i;
+
+	queries(lv, kind, n, &q);
+	if(!lv->dense.empty())
+	{
+		t0 = now();
+		for(i=0; i < n; i++)
+		{
+			int x = q[2 * i], z = q[2 * i + 1];
+			if(x >= 0 && z >= 0 && x < lv->size && z < lv->size)
+				sum_dense += lv->dense[(size_t)z * lv->size + x];
+		}
+		t_dense = now() - t0;
+	}
+	t0 = now();
+	for(i=0; i < n; i++)
+		sum_sparse += sparseCell(&lv->sparse, q[2 * i], q[2 * i + 1]);
+	t_sparse = now() - t0;
+	sparseCursor(&cur, &lv->sparse);
+	t0 = now();
+	for(i=0; i < n; i++)
+		sum_cursor += sparseCellAt(&lv->sparse, &cur, q[2 * i], q[2 * i + 1]);
+	t_cursor = now() - t0;
+	sink = sum_dense + sum_sparse + sum_cursor;
+
+	printf("  %-6s", name);
+	if(!lv->dense.empty())
+		printf("  dense %7.1f M/s", n / t_dense / 1e6);
+	printf("  sparse %7.1f M/s  cursor %7.1f M/s", n / t_sparse / 1e6, n / t_cursor / 1e6);
+	if(sum_sparse != sum_cursor || (!lv->dense.empty() && sum_dense != sum_sparse))
+		printf("  MISMATCH");
+	printf("\n");
+}
+
+static void report(const struct Level *lv, double t_build, size_t n)
+{
+	double dense = (double)lv->size * lv->size;
+
+	printf("%d x %d: %zu chunks of %d cells (%.2f%% of the level), built in %.2f s\n", lv->size, lv->size,
+			lv->sparse.chunks, SPARSE_CELLS, 100.0 * lv->sparse.chunks * SPARSE_CELLS / dense, t_build);
+	printf("  memory: sparse %.1f MB (%.1f MB chunks, %.1f MB table), dense %s%.1f MB\n",
+			sparseBytes(&lv->sparse) / 1e6, lv->sparse.data.capacity() / 1e6,
+			lv->sparse.table.capacity() * sizeof(struct SparseEntry) / 1e6,
+			lv->dense.empty() ? "would be " : "", dense / 1e6);
+	timeLookups(lv, "random", 0, n);
+	timeLookups(lv, "land", 1, n);
+	timeLookups(lv, "walk", 2, n);
+}
+
+int main(int argc, char **argv)
+{
+	double scale = argc > 1 ? atof(argv[1]) : 1;
+	size_t n = 20000000 * scale;
+	struct Level *lv = new struct Level;
+	double t0;
+
+	t0 = now();
+	build(lv, 8192, 40, 20000, true);
+	report(lv, now() - t0, n);
+
+	lv->dense.clear();
+	lv->dense.shrink_to_fit();
+	t0 = now();
+	build(lv, 100000, 400, 100000, false);
+	report(lv, now() - t0, n);
+	delete lv;
+	return EXIT_SUCCESS;
+}
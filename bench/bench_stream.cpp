@@ -0,0 +1,89 @@
+/* Endless course streaming.
+ *
+ *   make bench && ./bench/bench_stream [chunks-scale]
+ *
+ * Runs a player forward through an endless course 17 cells wide, with
+ * one streamUpdate per frame and up to two uploads per frame, at three
+ * speeds:
+ *   - walk: a chunk every 30 frames of 1 ms, 100 chunks
+ *   - run: a chunk every 4 frames of 1 ms, 500 chunks
+ *   - sprint: a chunk every frame and no frame time at all, 2000 chunks.
+ *     The workers can't keep up, and streamWindow stalls.
+ * "tight" runs again at the run pace with a budget of about four chunks.
+ * The upload is a copy into a malloc'd buffer, roughly what a driver does
+ * for glBufferData. Reports generation, ready and upload latency (mean and
+ * worst), and resident bytes sampled at each quarter of the run. The
+ * resident bytes must stay flat.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "../stream.h"
+
+static void *upload(const struct Mesh *mesh, void *ctx)
+{
+	size_t *bytes = (size_t *)ctx;
+	char *p = (char *)malloc(meshBytes(mesh) + 1);
+
+	memcpy(p, mesh->pos.data(), mesh->pos.size() * sizeof(float));
+	memcpy(p + mesh->pos.size() * sizeof(float), mesh->color.data(), mesh->color.size() * sizeof(float));
+	*bytes += meshBytes(mesh);
+	return p;
+}
+
+static void release(void *gpu, void *ctx)
+{
+	(void)ctx;
+	free(gpu);
+}
+
+static void run(const char *name, int chunks, int frames_per_chunk, int frame_us, size_t budget)
+{
+	struct ChunkStream *st = new struct ChunkStream;
+	struct StreamStats s;
+	struct Course window;
+	size_t bytes = 0, samples[4];
+	int threads = std::thread::hardware_concurrency(), frame, at = -1;
+
+	streamStart(st, 7, COURSE_W, budget, threads > 2 ? 2 : 1, upload, release, &bytes);
+	for(frame=0; frame < chunks * frames_per_chunk; frame++)
+	{
+		if(frame / frames_per_chunk != at)
+		{
+			at = frame / frames_per_chunk;
+			streamWindow(st, at, &window);
+		}
+		streamUpdate(st, at, 2);
+		if(frame_us)
+			usleep(frame_us);
+		if(frame % (chunks * frames_per_chunk / 4) == 0)
+		{
+			streamStats(st, &s);
+			samples[frame / (chunks * frames_per_chunk / 4)] = s.resident;
+		}
+	}
+	streamStats(st, &s);
+	printf("%-7s %5d chunks  gen %5.2f/%6.2f ms  ready %6.2f/%7.2f ms  upload %6.2f/%7.2f ms  %4zu stalls\n",
+			name, chunks, s.gen.sum / s.gen.n * 1e3, s.gen.max * 1e3, s.ready.sum / s.ready.n * 1e3, s.ready.max * 1e3,
+			s.upload.sum / s.upload.n * 1e3, s.upload.max * 1e3, s.stalls);
+	printf("        resident %zu %zu %zu %zu -> %zu bytes, peak %zu, budget %zu; %zu generated, %zu evicted, %.1f MB uploaded\n",
+			samples[0], samples[1], samples[2], samples[3], s.resident, s.peak, budget, s.generated, s.evicted, bytes / 1e6);
+	streamStop(st);
+	delete st;
+}
+
+int main(int argc, char **argv)
+{
+	double scale = argc > 1 ? atof(argv[1]) : 1;
+	int chunks = 2000 * scale;
+
+	run("walk", chunks / 20, 30, 1000, 1 << 20);
+	run("run", chunks / 4, 4, 1000, 1 << 20);
+	run("sprint", chunks, 1, 0, 1 << 20);
+	run("tight", chunks / 4, 4, 1000, 512 << 10);
+	return EXIT_SUCCESS;
+}
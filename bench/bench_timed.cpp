@@ -0,0 +1,85 @@
+/* Time-dependent path queries over (cell, phase).
+ *
+ *   make bench && ./bench/bench_timed [queries-scale]
+ *
+ * Runs random start/goal/tick queries on generated courses of a few sizes.
+ * "cold" calls timedInit before every query, so each one works out its
+ * buckets' moves again; "warm" keeps the finder across the queries of a
+ * course, the way the game's hint does; "to row" asks for the far row
+ * from a random start with the finder kept, which is the hint's query.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vector>
+
+#include "../timepath.h"
+#include "../rng.h"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(int w, int d, int queries)
+{
+	std::vector<struct TimedStep> path;
+	struct TimedFinder tf;
+	struct Course course;
+	struct Pcg32 rng;
+	size_t expanded = 0;
+	double t[3];
+	long sum[2] = { 0, 0 };
+	int pass, q, found = 0;
+
+	generateCourse(&course, 7, w, d);
+	timedInit(&tf, &course);
+	for(pass=0; pass < 2; pass++)
+	{
+		double t0 = now();
+		pcgSeed(&rng, 42, 0);
+		for(q=0; q < queries; q++)
+		{
+			struct PathPoint from = { (int)pcgRange(&rng, w), (int)pcgRange(&rng, d) };
+			struct PathPoint to = { (int)pcgRange(&rng, w), (int)pcgRange(&rng, d) };
+			uint32_t tick = pcgRange(&rng, 1 << 24);
+			long arrive;
+
+			if(pass == 0)
+				timedInit(&tf, &course);
+			arrive = timedPath(&tf, from, tick, to, &path);
+			sum[pass] += arrive;
+			if(pass == 1)
+			{
+				expanded += tf.expanded;
+				found += arrive >= 0;
+			}
+		}
+		t[pass] = now() - t0;
+	}
+	/* To the far row from anywhere, warm, as the hint asks */
+	t[2] = now();
+	pcgSeed(&rng, 42, 0);
+	for(q=0; q < queries; q++)
+	{
+		struct PathPoint from = { (int)pcgRange(&rng, w), (int)pcgRange(&rng, d) };
+		timedPathToRow(&tf, from, pcgRange(&rng, 1 << 24), 0, &path);
+	}
+	t[2] = now() - t[2];
+	printf("%4dx%-4d cold %10.1f queries/s  warm %10.1f queries/s  %8.1f expanded/query  %d/%d reachable  to row %10.1f queries/s%s\n",
+			w, d, queries / t[0], queries / t[1], (double)expanded / queries, found, queries, queries / t[2],
+			sum[0] == sum[1] ? "" : "  MISMATCH");
+}
+
+int main(int argc, char **argv)
+{
+	double scale = argc > 1 ? atof(argv[1]) : 1;
+
+	bench(COURSE_W, COURSE_D, 20000 * scale);
+	bench(64, 64, 2000 * scale);
+	bench(256, 256, 100 * scale);
+	return EXIT_SUCCESS;
+}
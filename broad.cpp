@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <immintrin.h>
+
+#include "broad.h"
+
+const char *broadImplName(int impl)
+{
+	static const char *names[BROAD_IMPLS] = { "scalar", "sse", "avx2" };
+	return names[impl];
+}
+
+/* Low and high edge of a box along axis 'axis' (a) and the other one (b) */
+static inline float boxA0(const struct Box *b, int axis) { return axis == BROAD_X ? b->x0 : b->z0; }
+static inline float boxA1(const struct Box *b, int axis) { return axis == BROAD_X ? b->x1 : b->z1; }
+static inline float boxB0(const struct Box *b, int axis) { return axis == BROAD_X ? b->z0 : b->x0; }
+static inline float boxB1(const struct Box *b, int axis) { return axis == BROAD_X ? b->z1 : b->x1; }
+
+void broadBuild(struct Broadphase *bp, const struct Box *obs, size_t n)
+{
+	std::vector<uint32_t> sorted(n);
+	int axis;
+	size_t i;
+
+	for(axis=0; axis < 2; axis++)
+	{
+		struct BroadAxis *ax = &bp->axis[axis];
+
+		for(i=0; i < n; i++)
+			sorted[i] = i;
+		std::sort(sorted.begin(), sorted.end(), [&](uint32_t p, uint32_t q) {
+			return boxA0(&obs[p], axis) < boxA0(&obs[q], axis);
+		});
+		ax->a0.resize(n);
+		ax->a1.resize(n);
+		ax->b0.resize(n);
+		ax->b1.resize(n);
+		ax->id.resize(n);
+		ax->reach = 0;
+		for(i=0; i < n; i++)
+		{
+			const struct Box *b = &obs[sorted[i]];
+			ax->a0[i] = boxA0(b, axis);
+			ax->a1[i] = boxA1(b, axis);
+			ax->b0[i] = boxB0(b, axis);
+			ax->b1[i] = boxB1(b, axis);
+			ax->id[i] = sorted[i];
+			ax->reach = std::max(ax->reach, ax->a1[i] - ax->a0[i]);
+		}
+		/* A little over, so rounding in the sweep never skips a box */
+		ax->reach = ax->reach * 1.0001f + 1e-6f;
+	}
+}
+
+/* Test obstacles [i, end) of ax against mover box (ma0, ma1, mb0, mb1).
+   Everything in the range starts before ma1 on the sweep axis already. */
+static void testScalar(const struct BroadAxis *ax, size_t i, size_t end, float ma0, float mb0, float mb1,
+		uint32_t mover, std::vector<struct Contact> *out)
+{
+	for(; i < end; i++)
+		if(ax->a1[i] > ma0 && ax->b0[i] < mb1 && ax->b1[i] > mb0)
+		{
+			struct Contact c = { mover, ax->id[i] };
+			out->push_back(c);
+		}
+}
+
+static void testSse(const struct BroadAxis *ax, size_t i, size_t end, float ma0, float mb0, float mb1,
+		uint32_t mover, std::vector<struct Contact> *out)
+{
+	__m128 va0 = _mm_set1_ps(ma0), vb0 = _mm_set1_ps(mb0), vb1 = _mm_set1_ps(mb1);
+
+	for(; i + 4 <= end; i += 4)
+	{
+		__m128 hit = _mm_and_ps(_mm_cmpgt_ps(_mm_loadu_ps(&ax->a1[i]), va0),
+				_mm_and_ps(_mm_cmplt_ps(_mm_loadu_ps(&ax->b0[i]), vb1), _mm_cmpgt_ps(_mm_loadu_ps(&ax->b1[i]), vb0)));
+		unsigned mask = _mm_movemask_ps(hit);
+		while(mask)
+		{
+			struct Contact c = { mover, ax->id[i + __builtin_ctz(mask)] };
+			out->push_back(c);
+			mask &= mask - 1;
+		}
+	}
+	testScalar(ax, i, end, ma0, mb0, mb1, mover, out);
+}
+
+__attribute__((target("avx2")))
+static void testAvx2(const struct BroadAxis *ax, size_t i, size_t end, float ma0, float mb0, float mb1,
+		uint32_t mover, std::vector<struct Contact> *out)
+{
+	__m256 va0 = _mm256_set1_ps(ma0), vb0 = _mm256_set1_ps(mb0), vb1 = _mm256_set1_ps(mb1);
+
+	for(; i + 8 <= end; i += 8)
+	{
+		__m256 hit = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(&ax->a1[i]), va0, _CMP_GT_OQ),
+				_mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(&ax->b0[i]), vb1, _CMP_LT_OQ),
+					_mm256_cmp_ps(_mm256_loadu_ps(&ax->b1[i]), vb0, _CMP_GT_OQ)));
+		unsigned mask = _mm256_movemask_ps(hit);
+		while(mask)
+		{
+			struct Contact c = { mover, ax->id[i + __builtin_ctz(mask)] };
+			out->push_back(c);
+			mask &= mask - 1;
+		}
+	}
+	testSse(ax, i, end, ma0, mb0, mb1, mover, out);
+}
+
+size_t broadQuery(struct Broadphase *bp, const struct Box *movers, size_t n, int axis, int impl,
+		std::vector<struct Contact> *out)
+{
+	const struct BroadAxis *ax = &bp->axis[axis];
+	size_t before = out->size(), start = 0, k;
+	void (*test)(const struct BroadAxis *, size_t, size_t, float, float, float, uint32_t, std::vector<struct Contact> *);
+
+	if(impl == BROAD_AVX2 && __builtin_cpu_supports("avx2"))
+		test = testAvx2;
+	else if(impl == BROAD_SCALAR)
+		test = testScalar;
+	else
+		test = testSse;
+
+	bp->order.resize(n);
+	for(k=0; k < n; k++)
+		bp->order[k] = k;
+	std::sort(bp->order.begin(), bp->order.end(), [&](uint32_t p, uint32_t q) {
+		return boxA0(&movers[p], axis) < boxA0(&movers[q], axis);
+	});
+
+	/* Movers in order of their low edge, so the first obstacle that can
+	   still reach one only ever moves forward */
+	for(k=0; k < n; k++)
+	{
+		const struct Box *m = &movers[bp->order[k]];
+		float ma0 = boxA0(m, axis), ma1 = boxA1(m, axis);
+		size_t end;
+
+		while(start < ax->a0.size() && ax->a0[start] < ma0 - ax->reach)
+			start++;
+		end = std::lower_bound(ax->a0.begin() + start, ax->a0.end(), ma1) - ax->a0.begin();
+		test(ax, start, end, ma0, boxB0(m, axis), boxB1(m, axis), bp->order[k], out);
+	}
+	return out->size() - before;
+}
@@ -0,0 +1,64 @@
+#ifndef BROAD_H
+#define BROAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/* Broadphase for many moving things against many obstacles, both as
+ * axis aligned boxes on the ground plane.
+ *
+ * Obstacles are kept as structure of arrays, once sorted by their low x
+ * and once by their low z. A query picks the axis the movers mostly move
+ * along, sorts the movers by it, and sweeps: for each mover only the run
+ * of obstacles whose low edge falls within its reach on that axis is
+ * looked at, and that run is tested 4 (SSE) or 8 (AVX2) boxes at a time.
+ * Boxes are open: touching is not overlapping, as in collide.h.
+ */
+struct Box {
+	float x0, z0, x1, z1;
+};
+
+struct Contact {
+	uint32_t mover;     // index into the movers passed to the query
+	uint32_t obstacle;  // index into the boxes passed to broadBuild
+};
+
+enum { BROAD_X, BROAD_Z };
+
+/* Obstacles sorted along one axis: a is that axis, b the other */
+struct BroadAxis {
+	std::vector<float> a0, a1, b0, b1;
+	std::vector<uint32_t> id;
+	float reach;  // largest extent along a, how far back a sweep must look
+};
+
+struct Broadphase {
+	struct BroadAxis axis[2];
+	std::vector<uint32_t> order;  // query scratch, movers sorted
+};
+
+enum {
+	BROAD_SCALAR,
+	BROAD_SSE,
+	BROAD_AVX2,   // falls back to SSE without AVX2
+	BROAD_IMPLS
+};
+
+const char *broadImplName(int impl);
+
+void broadBuild(struct Broadphase *bp, const struct Box *obs, size_t n);
+
+/* Axis to sweep along for things moving by (dx, dz) */
+static inline int broadAxis(float dx, float dz)
+{
+	return (dx < 0 ? -dx : dx) >= (dz < 0 ? -dz : dz) ? BROAD_X : BROAD_Z;
+}
+
+/* Append every (mover, obstacle) pair that overlaps to 'out' and return
+   how many were added. Movers are usually each one's box swept over its
+   move this tick. Pairs come grouped by mover, in sweep order. */
+size_t broadQuery(struct Broadphase *bp, const struct Box *movers, size_t n, int axis, int impl,
+		std::vector<struct Contact> *out);
+
+#endif
@@ -0,0 +1,153 @@
+#include "collide.h"
+#include "course.h"
+
+void colBuild(struct CollisionIndex *ci, const struct Course *course)
+{
+	int i, k;
+	size_t n;
+
+	ci->w = course->w;
+	ci->d = course->d;
+	ci->stride = course->w + 2;
+	ci->own.assign((size_t)ci->stride * (course->d + 2), 0);
+	for(k=0; k < course->d; k++)
+		for(i=0; i < course->w; i++)
+		{
+			int t = courseTile(course, i, k);
+			ci->own[(size_t)(k + 1) * ci->stride + i + 1] = t == TILE_FLOOR ? COL_FLOOR : t == TILE_MOVING ? COL_MOVING : 0;
+		}
+	for(n=0; n < course->obs.size(); n++)
+		ci->own[(size_t)(course->obs[n].z + 1) * ci->stride + course->obs[n].x + 1] |= COL_OBSTACLE;
+	ci->cells = ci->own.data();
+}
+
+/* Time the sweep reaches grid line 'line' from 'from', moving by d */
+static inline float lineTime(int line, float from, float d)
+{
+	return d != 0 ? (line - from) / d : INFINITY;
+}
+
+static inline bool colMatch(const struct CollisionIndex *ci, int i, int k, unsigned mask, unsigned match)
+{
+	return (colCell(ci, i, k) & mask) == match;
+}
+
+static inline void setHit(struct ColHit *hit, float t, int i, int k, int nx, int nz)
+{
+	hit->t = t;
+	hit->i = i;
+	hit->k = k;
+	hit->nx = nx;
+	hit->nz = nz;
+}
+
+/* The box covers columns i0..i1 and rows k0..k1. Along each axis two
+   things happen, in order of time: the leading edge takes in a new column
+   (or row) just after it crosses a grid line, and the trailing edge lets
+   one go as it reaches a line. Only cells taken in need testing. Letting
+   go comes first on a tie, so a cell the box only touches is never hit. */
+bool colSweepBox(const struct CollisionIndex *ci, float x0, float z0, float x1, float z1, float dx, float dz,
+		unsigned mask, unsigned match, struct ColHit *hit)
+{
+	int i0 = (int)floorf(x0), i1 = (int)ceilf(x1) - 1, k0 = (int)floorf(z0), k1 = (int)ceilf(z1) - 1, i, k;
+	int sx = dx > 0 ? 1 : -1, sz = dz > 0 ? 1 : -1;
+	float enterX, leaveX, enterZ, leaveZ;
+
+	for(k=k0; k <= k1; k++)
+		for(i=i0; i <= i1; i++)
+			if(colMatch(ci, i, k, mask, match))
+			{
+				setHit(hit, 0, i, k, 0, 0);
+				return true;
+			}
+
+	enterX = sx > 0 ? lineTime(i1 + 1, x1, dx) : lineTime(i0, x0, dx);
+	leaveX = sx > 0 ? lineTime(i0 + 1, x0, dx) : lineTime(i1, x1, dx);
+	enterZ = sz > 0 ? lineTime(k1 + 1, z1, dz) : lineTime(k0, z0, dz);
+	leaveZ = sz > 0 ? lineTime(k0 + 1, z0, dz) : lineTime(k1, z1, dz);
+	for(;;)
+	{
+		float t = fminf(fminf(enterX, enterZ), fminf(leaveX, leaveZ));
+
+		if(t >= 1)
+			return false;
+		if(leaveX == t)
+		{
+			if(sx > 0)
+				leaveX = lineTime(++i0 + 1, x0, dx);
+			else
+				leaveX = lineTime(--i1, x1, dx);
+		}
+		else if(leaveZ == t)
+		{
+			if(sz > 0)
+				leaveZ = lineTime(++k0 + 1, z0, dz);
+			else
+				leaveZ = lineTime(--k1, z1, dz);
+		}
+		else if(enterX == t)
+		{
+			int c = sx > 0 ? ++i1 : --i0;
+			for(k=k0; k <= k1; k++)
+				if(colMatch(ci, c, k, mask, match))
+				{
+					setHit(hit, t, c, k, -sx, 0);
+					return true;
+				}
+			enterX = sx > 0 ? lineTime(i1 + 1, x1, dx) : lineTime(i0, x0, dx);
+		}
+		else
+		{
+			int r = sz > 0 ? ++k1 : --k0;
+			for(i=i0; i <= i1; i++)
+				if(colMatch(ci, i, r, mask, match))
+				{
+					setHit(hit, t, i, r, 0, -sz);
+					return true;
+				}
+			enterZ = sz > 0 ? lineTime(k1 + 1, z1, dz) : lineTime(k0, z0, dz);
+		}
+	}
+}
+
+/* A grid walk (Amanatides and Woo): step into whichever neighbour's line
+   comes first. A point on a line is in the cell above it, so moving up an
+   axis it is in the new cell at the crossing, moving down only after. */
+bool colSweepPoint(const struct CollisionIndex *ci, float x, float z, float dx, float dz,
+		unsigned mask, unsigned match, struct ColHit *hit)
+{
+	int i = (int)floorf(x), k = (int)floorf(z);
+	int sx = dx > 0 ? 1 : -1, sz = dz > 0 ? 1 : -1;
+	float nextX, nextZ;
+
+	if(colMatch(ci, i, k, mask, match))
+	{
+		setHit(hit, 0, i, k, 0, 0);
+		return true;
+	}
+	nextX = lineTime(sx > 0 ? i + 1 : i, x, dx);
+	nextZ = lineTime(sz > 0 ? k + 1 : k, z, dz);
+	for(;;)
+	{
+		bool alongX = nextX <= nextZ;
+		float t = alongX ? nextX : nextZ;
+
+		if(t > 1 || (t == 1 && (alongX ? sx : sz) < 0))
+			return false;
+		if(alongX)
+		{
+			i += sx;
+			nextX = lineTime(sx > 0 ? i + 1 : i, x, dx);
+		}
+		else
+		{
+			k += sz;
+			nextZ = lineTime(sz > 0 ? k + 1 : k, z, dz);
+		}
+		if(colMatch(ci, i, k, mask, match))
+		{
+			setHit(hit, t, i, k, alongX ? -sx : 0, alongX ? 0 : -sz);
+			return true;
+		}
+	}
+}
@@ -0,0 +1,124 @@
+#ifndef COLLIDE_H
+#define COLLIDE_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct Course;
+
+/* Collision index: what every cell of a course holds, as flags, so the
+ * simulation asks "what is under this point" or "what does this box touch"
+ * without going through the obstacle list. Cell (i, k) covers [i, i+1) x
+ * [k, k+1). A ring of pit cells is kept around the course, so a box at
+ * the edge needs no bounds checks; anything further out is a pit too.
+ */
+enum {
+	COL_FLOOR = 1 << 0,     // static floor; no flags at all is a pit
+	COL_MOVING = 1 << 1,    // moving floor tile
+	COL_OBSTACLE = 1 << 2   // an obstacle stands on the cell
+};
+
+struct CollisionIndex {
+	int w, d;
+	int stride;                  // w + 2
+	const uint8_t *cells;        // (d + 2) rows, cell (i, k) at (k+1)*stride + i+1
+	std::vector<uint8_t> own;    // what cells points at, unless a mapped level holds them
+
+	/* A copy's cells are its own copy of own, or the same mapped level */
+	CollisionIndex() : w(0), d(0), stride(0), cells(NULL) {}
+	CollisionIndex(const CollisionIndex &o) : w(o.w), d(o.d), stride(o.stride), own(o.own)
+	{
+		cells = o.cells == o.own.data() ? own.data() : o.cells;
+	}
+	CollisionIndex(CollisionIndex &&o) : w(o.w), d(o.d), stride(o.stride)
+	{
+		bool owned = o.cells == o.own.data();
+		own = std::move(o.own);
+		cells = owned ? own.data() : o.cells;
+		o.own.clear();
+		o.cells = NULL;
+	}
+	CollisionIndex &operator=(const CollisionIndex &o)
+	{
+		if(this != &o)
+		{
+			w = o.w;
+			d = o.d;
+			stride = o.stride;
+			own = o.own;
+			cells = o.cells == o.own.data() ? own.data() : o.cells;
+		}
+		return *this;
+	}
+	CollisionIndex &operator=(CollisionIndex &&o)
+	{
+		if(this != &o)
+		{
+			bool owned = o.cells == o.own.data();
+			w = o.w;
+			d = o.d;
+			stride = o.stride;
+			own = std::move(o.own);
+			cells = owned ? own.data() : o.cells;
+			o.own.clear();
+			o.cells = NULL;
+		}
+		return *this;
+	}
+};
+
+/* Index a course's tiles and obstacles. Course generators do this; call it
+   again after editing a course by hand. */
+void colBuild(struct CollisionIndex *ci, const struct Course *course);
+
+static inline unsigned colCell(const struct CollisionIndex *ci, int i, int k)
+{
+	if(i < -1 || k < -1 || i > ci->w || k > ci->d)
+		return 0;
+	return ci->cells[(size_t)(k + 1) * ci->stride + i + 1];
+}
+
+/* Flags of every cell the open box (x0, x1) x (z0, z1) overlaps, or'ed */
+static inline unsigned colBox(const struct CollisionIndex *ci, float x0, float z0, float x1, float z1)
+{
+	int i0 = (int)floorf(x0), i1 = (int)ceilf(x1) - 1, k0 = (int)floorf(z0), k1 = (int)ceilf(z1) - 1, i, k;
+	unsigned flags = 0;
+
+	if(i0 < -1)
+		i0 = -1;
+	if(k0 < -1)
+		k0 = -1;
+	if(i1 > ci->w)
+		i1 = ci->w;
+	if(k1 > ci->d)
+		k1 = ci->d;
+	for(k=k0; k <= k1; k++)
+		for(i=i0; i <= i1; i++)
+			flags |= ci->cells[(size_t)(k + 1) * ci->stride + i + 1];
+	return flags;
+}
+
+/* First contact of a sweep: the time of impact as a fraction of the move,
+   the cell hit, and the normal of the face that was hit, pointing back
+   at the mover. Something already overlapped at the start is hit at time
+   0 with no normal. */
+struct ColHit {
+	float t;
+	int i, k;
+	int nx, nz;
+};
+
+/* Move the open box (x0, x1) x (z0, z1) by (dx, dz) and find the first cell
+   it overlaps whose flags and'ed with mask equal match. Cells are visited
+   in the order the box reaches them, so the cost follows the number of
+   cells crossed, however long the move. */
+bool colSweepBox(const struct CollisionIndex *ci, float x0, float z0, float x1, float z1, float dx, float dz,
+		unsigned mask, unsigned match, struct ColHit *hit);
+
+/* The same for a point, which is in the cell it would floor to */
+bool colSweepPoint(const struct CollisionIndex *ci, float x, float z, float dx, float dz,
+		unsigned mask, unsigned match, struct ColHit *hit);
+
+#endif
@@ -0,0 +1,78 @@
+#include <math.h>
+
+#include "course.h"
+#include "rng.h"
+#include "solve.h"
+
+/* Height of the moving floor tiles at a given tick. Derived from the tick
+   rather than accumulated so it never drifts and replays stay exact. */
+float movingFloorHeight(uint32_t tick)
+{
+	uint32_t p = tick % (2 * FARSH_M_LEG);
+
+	if(p > FARSH_M_LEG)
+		p = 2 * FARSH_M_LEG - p;
+	return FARSH_M_LOW + (FARSH_M_HIGH - FARSH_M_LOW) * (float)p / (float)FARSH_M_LEG;
+}
+
+bool movingWalkable(uint32_t tick)
+{
+	return fabsf(movingFloorHeight(tick) - FARSH_Y) <= MOVING_STEP;
+}
+
+static void setTile(struct Course *c, int i, int k, int tile)
+{
+	c->tiles[(size_t)k * c->w + i] = tile;
+}
+
+int generateCourse(struct Course *course, uint32_t seed, int w, int d)
+{
+	struct Pcg32 rng;
+	int i, k, n, n_obs, n_pits;
+
+	pcgSeed(&rng, seed, 0x6d617a65);
+	course->seed = seed;
+	course->maze = 0;
+	course->w = w;
+	course->d = d;
+	course->spawn_x = 0;
+	course->spawn_z = d - 1;
+	course->tiles.assign((size_t)w * d, TILE_FLOOR);
+	course->obs.clear();
+
+	/* Each column gets one moving tile, and now and then a whole column moves */
+	for(i=0; i < w; i++)
+	{
+		if(pcgRange(&rng, 20) == 0)
+			for(k=1; k < d-1; k++)
+				setTile(course, i, k, TILE_MOVING);
+		else
+			setTile(course, i, 1 + pcgRange(&rng, d-2), TILE_MOVING);
+	}
+
+	/* Missing floor, about one cell in twenty */
+	n_pits = w * d / 20;
+	for(n=0; n < n_pits; n++)
+		setTile(course, pcgRange(&rng, w), 1 + pcgRange(&rng, d-2), TILE_PIT);
+
+	/* Obstacles on plain floor, one for every twenty cells */
+	n_obs = w * d / 20;
+	for(n=0; n < n_obs; n++)
+	{
+		struct Obstacle o;
+		o.x = pcgRange(&rng, w);
+		o.z = pcgRange(&rng, d);
+		if(courseTile(course, o.x, o.z) == TILE_FLOOR)
+			course->obs.push_back(o);
+	}
+
+	/* Never spawn in a hole or inside an obstacle */
+	setTile(course, course->spawn_x, course->spawn_z, TILE_FLOOR);
+	for(n=0; n < (int)course->obs.size(); n++)
+		if(course->obs[n].x == course->spawn_x && course->obs[n].z == course->spawn_z)
+			course->obs.erase(course->obs.begin() + n--);
+
+	n = repairCourse(course);
+	colBuild(&course->index, course);
+	return n;
+}
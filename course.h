@@ -0,0 +1,63 @@
+#ifndef COURSE_H
+#define COURSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "collide.h"
+
+/* Default course dimensions */
+#define COURSE_W 17
+#define COURSE_D 20
+
+/* Moving floor tiles travel between these heights, one leg every FARSH_M_LEG ticks */
+#define FARSH_Y -1.0f
+#define FARSH_M_LOW -4.0f
+#define FARSH_M_HIGH 2.0f
+#define FARSH_M_LEG 2400
+
+/* A moving tile can be stood on while it is within this of the floor height */
+#define MOVING_STEP 1.0f
+
+/* What a floor cell holds. Everything outside the grid is water. */
+enum {
+	TILE_PIT = 0,     // no floor, the player falls into the water
+	TILE_FLOOR = 1,
+	TILE_MOVING = 2   // floor tile that rises and sinks, see movingFloorHeight
+};
+
+struct Obstacle {
+	int x, z;
+};
+
+/* The course is a w x d grid of tiles, row k at tiles[k*w .. k*w + w-1],
+   plus obstacles standing on floor cells. The player starts at
+   (spawn_x, spawn_z) and finishes on row 0. */
+struct Course {
+	uint32_t seed;
+	int maze;       // built by generateMazeCourse rather than generateCourse
+	int w, d;
+	int spawn_x, spawn_z;
+	std::vector<uint8_t> tiles;
+	std::vector<struct Obstacle> obs;
+	struct CollisionIndex index;  // tiles and obstacles by cell, see collide.h
+};
+
+static inline int courseTile(const struct Course *c, int i, int k)
+{
+	if(i < 0 || i >= c->w || k < 0 || k >= c->d)
+		return TILE_PIT;
+	return c->tiles[(size_t)k * c->w + i];
+}
+
+float movingFloorHeight(uint32_t tick);
+bool movingWalkable(uint32_t tick);
+
+/* Build a course from a seed. The same seed and size always give the same
+   course, on any machine. w and d must be at least 3. Layouts that can't be
+   finished are repaired (see repairCourse); returns the number of cells the
+   repair changed. */
+int generateCourse(struct Course *course, uint32_t seed, int w = COURSE_W, int d = COURSE_D);
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef EMBED_H
+#define EMBED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "course.h"
+#include "level.h"
+
+/* Levels built into the binary.
+ *
+ * The text is levelc's maze format (see levelc.cpp) in a string constant,
+ * and the compiler parses it: EMBED_LEVEL gives a constexpr object holding
+ * the header, tiles, obstacles, moving tiles and collision index laid out
+ * exactly as the sections of a level file, in read-only data. embedOpen
+ * points a struct Level at it the way levelOpen points one at a mapping,
+ * so playing it costs nothing at startup and nothing can change it.
+ *
+ * A newline straight after the opening quote is skipped, so the text can
+ * start on a line of its own:
+ *
+ *   static constexpr char text[] = R"(
+ *   ....
+ *   #S..
+ *   )";
+ *   EMBED_LEVEL(name, text);
+ *
+ * A level that isn't one the game can play doesn't compile: the parser
+ * calls one of the embedError functions below, which have no constexpr
+ * definition, and the error names it.
+ */
+
+void embedErrorNoMaze();
+void embedErrorNotATile();
+void embedErrorNoSpawn();
+void embedErrorTwoSpawns();
+
+struct EmbedSize {
+	int w, d;
+	int obs, movers;
+};
+
+/* Rows past the last with floor on them are dropped, as levelc does */
+constexpr bool embedWater(char c)
+{
+	return c == ' ' || c == '~' || c == '\r';
+}
+
+constexpr const char *embedStart(const char *text)
+{
+	return *text == '\n' ? text + 1 : text;
+}
+
+constexpr struct EmbedSize embedMeasure(const char *text)
+{
+	struct EmbedSize s = { 0, 0, 0, 0 };
+	int n = 0, row = 0, spawns = 0;
+	const char *p = embedStart(text);
+
+	for(; ; p++)
+	{
+		if(*p == '\n' || *p == 0)
+		{
+			if(n > s.w)
+				s.w = n;
+			if(!*p)
+				break;
+			n = 0;
+			row++;
+			continue;
+		}
+		if(*p != '\r')
+			n++;
+		if(!embedWater(*p))
+			s.d = row + 1;
+		switch(*p)
+		{
+		case 'S':
+			spawns++;
+			break;
+		case '#':
+			s.obs++;
+			break;
+		case 'M':
+			s.movers++;
+			break;
+		case '.':
+		case ' ':
+		case '~':
+		case '\r':
+			break;
+		default:
+			embedErrorNotATile();
+		}
+	}
+	if(s.w == 0 || s.d == 0)
+		embedErrorNoMaze();
+	if(spawns == 0)
+		embedErrorNoSpawn();
+	if(spawns > 1)
+		embedErrorTwoSpawns();
+	return s;
+}
+
+template<int W, int D, int OBS, int MOVERS>
+struct EmbedLevel {
+	struct LevelHeader hdr;
+	uint8_t tiles[W * D];
+	struct Obstacle obs[OBS ? OBS : 1];
+	struct LevelMover movers[MOVERS ? MOVERS : 1];
+	uint8_t cells[(W + 2) * (D + 2)];
+};
+
+template<int W, int D, int OBS, int MOVERS>
+constexpr EmbedLevel<W, D, OBS, MOVERS> embedParse(const char *text)
+{
+	EmbedLevel<W, D, OBS, MOVERS> e{};
+	int i = 0, k = 0, o = 0, m = 0;
+	const char *p = embedStart(text);
+
+	e.hdr.magic[0] = LEVEL_MAGIC[0];
+	e.hdr.magic[1] = LEVEL_MAGIC[1];
+	e.hdr.magic[2] = LEVEL_MAGIC[2];
+	e.hdr.magic[3] = LEVEL_MAGIC[3];
+	e.hdr.version = LEVEL_VERSION;
+	e.hdr.w = W;
+	e.hdr.d = D;
+	e.hdr.band = LEVEL_BAND;
+	for(; *p && k < D; p++)
+	{
+		uint8_t *t = &e.tiles[k * W + i];
+		uint8_t *c = &e.cells[(k + 1) * (W + 2) + i + 1];
+		switch(*p)
+		{
+		case '\n':
+			i = 0;
+			k++;
+			continue;
+		case '\r':
+			continue;
+		case 'S':
+			e.hdr.spawn_x = i;
+			e.hdr.spawn_z = k;
+			/* fall through */
+		case '.':
+			*t = TILE_FLOOR;
+			*c = COL_FLOOR;
+			break;
+		case '#':
+			*t = TILE_FLOOR;
+			*c = COL_FLOOR | COL_OBSTACLE;
+			e.obs[o].x = i;
+			e.obs[o].z = k;
+			o++;
+			break;
+		case 'M':
+			*t = TILE_MOVING;
+			*c = COL_MOVING;
+			e.movers[m] = { i, k, FARSH_M_LOW, FARSH_M_HIGH, FARSH_M_LEG, 0 };
+			m++;
+			break;
+		}
+		i++;
+	}
+	return e;
+}
+
+#define EMBED_LEVEL(name, text) \
+	static constexpr auto name = embedParse<embedMeasure(text).w, embedMeasure(text).d, \
+			embedMeasure(text).obs, embedMeasure(text).movers>(text)
+
+/* A level view of an embedded level: header, tiles, obstacles, moving
+   tiles and collision index. There is no grid, reach, HPA* or mesh, so it
+   goes to levelCourse and the like but not to levelCheck or levelGrid, and
+   never to levelClose. */
+template<int W, int D, int OBS, int MOVERS>
+void embedOpen(struct Level *lv, const EmbedLevel<W, D, OBS, MOVERS> &e)
+{
+	*lv = {};
+	lv->path = "(built in)";
+	lv->hdr = &e.hdr;
+	lv->tiles = e.tiles;
+	lv->obs = e.obs;
+	lv->n_obs = OBS;
+	lv->movers = e.movers;
+	lv->n_movers = MOVERS;
+	lv->cells = e.cells;
+}
+
+/* levelCourse, with the tiles and obstacles copied in for what draws and
+   plans from them. The index stays the level's. */
+static inline void embedCourse(const struct Level *lv, struct Course *course)
+{
+	levelCourse(lv, course);
+	course->tiles.assign(lv->tiles, lv->tiles + (size_t)lv->hdr->w * lv->hdr->d);
+	course->obs.assign(lv->obs, lv->obs + lv->n_obs);
+}
+
+#endif
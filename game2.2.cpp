@@ -2,6 +2,10 @@
 #include <cmath>
 #include <fstream>
 #include <vector>
+#include <cstring>
+#include <ctime>
+#include <atomic>
+#include <thread>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -11,12 +15,24 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <SFML/Audio.hpp>
+
+#include "sim.h"
+#include "replay.h"
+#include "rewind.h"
+#include "solve.h"
+#include "maze.h"
+#include "timepath.h"
+#include "stream.h"
+#include "level.h"
+#include "remesh.h"
+#include "pack.h"
+#include "pool.h"
+#include "gpu.h"
+#include "levels/default.h"
 using namespace std;
 
 struct VAO {
-	GLuint VertexArrayID;
-	GLuint VertexBuffer;
-	GLuint ColorBuffer;
+	struct PoolAlloc *Range;  // where in the pooled buffers, read at draw time as defragmenting moves it
 
 	GLenum PrimitiveMode;
 	GLenum FillMode;
@@ -24,6 +40,25 @@ struct VAO {
 };
 typedef struct VAO VAO;
 
+/* Every GL object is owned through the registry (see gpu.h), which
+   deletes it with its owner, counts it and keeps the buffers within
+   --gpu-budget MB */
+struct GpuRegistry gpu_objects;
+#define GPU_BUDGET 256             // MB, by default
+int gpu_budget = GPU_BUDGET;
+
+/* Every object's vertices are a range of a few big buffers (see pool.h),
+   and a draw is (buffer, first vertex, count). A pooled buffer is a VAO
+   over a position and a colour VBO. */
+struct PoolGL {
+	struct GpuObject VertexArrayID;
+	struct GpuObject VertexBuffer;
+	struct GpuObject ColorBuffer;
+};
+struct Pool pool;
+#define POOL_DEFRAG_BUDGET (1 << 15)  // vertices poolDefrag may move a frame
+#define POOL_VERTEX_BYTES (6 * sizeof(GLfloat))  // a position and a colour
+
 struct GLMatrices {
 	glm::mat4 projection;
 	glm::mat4 model;
@@ -32,6 +67,103 @@ struct GLMatrices {
 } Matrices;
 
 GLuint programID;
+struct GpuObject program;
+
+struct Course course;
+struct SimState sim;
+struct Replay replay;
+struct Rewind *rewind_buf = NULL;  // NULL when dying respawns instead
+const char *record_path = NULL;
+const char *play_path = NULL;
+
+/* The next course is generated on a worker thread while this one is played,
+   and swapped in between frames once it is wanted. */
+std::thread gen_thread;
+std::atomic<struct Course *> next_course(NULL);
+int want_next = 0;
+
+/* --endless streams the course in chunks (see stream.h). The simulation
+   plays a two chunk window of it, which moves on a chunk whenever the
+   player gets into the far one. */
+struct ChunkStream *stream = NULL;
+int stream_base = 0;               // chunk in the lower half of the window
+#define STREAM_BUDGET (4 << 20)
+#define STREAM_UPLOADS 2           // chunk meshes uploaded per frame
+
+/* --level plays a level file in place (see level.h). Its mesh bands are
+   uploaded once from the mapping and the ones near the player drawn. */
+struct Level *level = NULL;
+std::vector<struct VAO *> level_bands;
+
+/* Other courses are drawn from chunk meshes kept up to date as cells are
+   edited (see remesh.h): O puts an obstacle on the cell ahead of the player
+   or takes it off, C knocks a hole in it. */
+struct Remesher *remesh = NULL;
+#define REMESH_UPLOADS 4           // chunk meshes uploaded per frame
+
+/* Random courses are the best of PICK_CANDIDATES by difficulty, and each
+   one aims a little harder than the last */
+#define PICK_CANDIDATES 64
+int difficulty = 40;
+
+void generateNext (uint32_t seed, int w, int d, int target, int maze)
+{
+	struct Course *c = new struct Course;
+	struct GenStats gs;
+	int threads = std::thread::hardware_concurrency();
+	if(maze)
+		generateMazeCourse(c, seed, w, d);
+	else
+		pickCourse(c, seed, w, d, PICK_CANDIDATES, target, threads > 1 ? threads - 1 : 1, &gs);
+	next_course.store(c);
+}
+
+void startNextCourse ()
+{
+	if(gen_thread.joinable())
+		gen_thread.join();
+	difficulty += 4;
+	gen_thread = std::thread(generateNext, course.seed + 1, course.w, course.d, difficulty, course.maze);
+}
+
+/* Way hint: the quickest way from the player's cell to the far row, timed
+   so it only crosses moving tiles while they are up. Recomputed whenever
+   the player changes cell or falls a step behind it, on the render
+   thread, so it has to fit in a frame: when the far row can't be reached
+   the search goes over every (cell, phase) there is, about 9 ms at
+   HINT_MAX_CELLS. Bigger courses, big packed ones, go without. */
+struct TimedFinder finder;
+std::vector<struct TimedStep> hint;
+int hint_fl = 0;
+int hint_ok = 0;                   // finder set up for this course
+int hint_x = -1, hint_z = -1;
+uint32_t hint_tick;
+#define HINT_MAX_CELLS (24 * 24)
+
+void hintInit ()
+{
+	hint_ok = (size_t)course.w * course.d <= HINT_MAX_CELLS;
+	hint.clear();
+	hint_x = -1;
+	if(hint_ok)
+		timedInit(&finder, &course);
+	else
+		finder = TimedFinder();
+}
+
+void updateHint ()
+{
+	struct PathPoint from;
+
+	from.x = (int)floorf(sim.x_cuboid + 0.5f);
+	from.z = (int)floorf(sim.z_cuboid + 0.5f);
+	if(from.x == hint_x && from.z == hint_z && sim.tick - hint_tick < CELL_TICKS)
+		return;
+	hint_x = from.x;
+	hint_z = from.z;
+	hint_tick = sim.tick;
+	timedPathToRow(&finder, from, sim.tick, 0, &hint);
+}
 
 /* Function to load Shaders - Use it as it is */
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
@@ -115,31 +247,102 @@ static void error_callback(int error, const char* description)
 	fprintf(stderr, "Error: %s\n", description);
 }
 
+void releaseGL ();
+
 void quit(GLFWwindow *window)
 {
+	if(record_path && replaySave(&replay, record_path))
+		printf("Replay saved to %s (%u ticks)\n", record_path, (unsigned)replay.inputs.size());
+	if(gen_thread.joinable())
+		gen_thread.join();
+	if(stream)
+	{
+		struct StreamStats s;
+		streamStats(stream, &s);
+		printf("Streamed %zu chunks: generate %.2f ms (worst %.2f), ready %.2f ms (worst %.2f), upload %.2f ms (worst %.2f)\n",
+				s.generated, s.gen.n ? s.gen.sum / s.gen.n * 1e3 : 0, s.gen.max * 1e3,
+				s.ready.n ? s.ready.sum / s.ready.n * 1e3 : 0, s.ready.max * 1e3,
+				s.upload.n ? s.upload.sum / s.upload.n * 1e3 : 0, s.upload.max * 1e3);
+		printf("Resident %zu KB, peak %zu KB, budget %d KB; %zu stalls\n",
+				s.resident >> 10, s.peak >> 10, STREAM_BUDGET >> 10, s.stalls);
+		streamStop(stream);
+	}
+	if(remesh)
+	{
+		struct RemeshStats s;
+		remeshStats(remesh, &s);
+		printf("Remeshed %zu chunks for %zu edits: mesh %.2f ms (worst %.2f), edit to upload %.2f ms (worst %.2f), %zu of %zu uploads in place\n",
+				s.meshed, s.edits, s.mesh.n ? s.mesh.sum / s.mesh.n * 1e3 : 0, s.mesh.max * 1e3,
+				s.visible.n ? s.visible.sum / s.visible.n * 1e3 : 0, s.visible.max * 1e3, s.in_place, s.uploaded);
+		remeshStop(remesh);
+	}
+	{
+		struct PoolStats s;
+		poolStats(&pool, &s);
+		printf("Pooled %zu buffers, %zu KB, %zu KB in use, %.0f%% of the free space fragmented; %zu allocations, %zu moved (%zu KB), %zu buffers made\n",
+				s.buffers, s.reserved * POOL_VERTEX_BYTES >> 10, s.used * POOL_VERTEX_BYTES >> 10, s.fragmentation * 100,
+				s.allocs, s.moves, s.moved * POOL_VERTEX_BYTES >> 10, s.created);
+		releaseGL();
+		poolStats(&pool, &s);
+		if(s.allocs != s.frees)
+			printf("Leaked %zu meshes, %zu KB\n", s.allocs - s.frees, s.used * POOL_VERTEX_BYTES >> 10);
+		poolClear(&pool);
+		if(gpuReport(&gpu_objects, stdout))
+			printf("Leaked GPU objects, listed above\n");
+	}
+	if(level)
+		levelClose(level);
 	glfwDestroyWindow(window);
 	glfwTerminate();
 	exit(EXIT_SUCCESS);
 }
 
 
-/* Generate VAO, VBOs and return VAO handle */
-struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, GLenum fill_mode=GL_FILL)
+void gpuDeleteGL (int kind, unsigned name, void *ctx)
 {
-	struct VAO* vao = new struct VAO;
-	vao->PrimitiveMode = primitive_mode;
-	vao->NumVertices = numVertices;
-	vao->FillMode = fill_mode;
+	GLuint n = name;
+
+	if(kind == GPU_VAO)
+		glDeleteVertexArrays(1, &n);
+	else if(kind == GPU_BUFFER)
+		glDeleteBuffers(1, &n);
+	else if(kind == GPU_PROGRAM)
+		glDeleteProgram(n);
+}
+
+/* A GL name of the given kind, owned by o */
+void genGL (struct GpuObject *o, int kind, const char *what)
+{
+	GLuint n;
+
+	if(kind == GPU_VAO)
+		glGenVertexArrays(1, &n);
+	else
+		glGenBuffers(1, &n);
+	gpuAdopt(&gpu_objects, o, kind, n, what);
+}
+
+/* A pooled buffer of 'size' vertices, nothing in it yet. NULL if the
+   budget has no room for it. */
+void *poolCreateGL (size_t size, void *ctx)
+{
+	size_t bytes = 3*size*sizeof(GLfloat);
+	struct PoolGL *g = new struct PoolGL;
 
 	// Create Vertex Array Object
 	// Should be done after CreateWindow and before any other GL calls
-	glGenVertexArrays(1, &(vao->VertexArrayID)); // VAO
-	glGenBuffers (1, &(vao->VertexBuffer)); // VBO - vertices
-	glGenBuffers (1, &(vao->ColorBuffer));  // VBO - colors
+	genGL(&g->VertexArrayID, GPU_VAO, "pooled vertex array"); // VAO
+	genGL(&g->VertexBuffer, GPU_BUFFER, "pooled positions"); // VBO - vertices
+	genGL(&g->ColorBuffer, GPU_BUFFER, "pooled colours");  // VBO - colors
+	if(!gpuResize(&g->VertexBuffer, bytes) || !gpuResize(&g->ColorBuffer, bytes))
+	{
+		delete g;
+		return NULL;
+	}
 
-	glBindVertexArray (vao->VertexArrayID); // Bind the VAO 
-	glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer); // Bind the VBO vertices 
-	glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), vertex_buffer_data, GL_STATIC_DRAW); // Copy the vertices into VBO
+	glBindVertexArray (g->VertexArrayID.name); // Bind the VAO 
+	glBindBuffer (GL_ARRAY_BUFFER, g->VertexBuffer.name); // Bind the VBO vertices 
+	glBufferData (GL_ARRAY_BUFFER, bytes, NULL, GL_DYNAMIC_DRAW); // Room for the vertices
 	glVertexAttribPointer(
 			0,                  // attribute 0. Vertices
 			3,                  // size (x,y,z)
@@ -149,8 +352,8 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
 			(void*)0            // array buffer offset
 			);
 
-	glBindBuffer (GL_ARRAY_BUFFER, vao->ColorBuffer); // Bind the VBO colors 
-	glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), color_buffer_data, GL_STATIC_DRAW);  // Copy the vertex colors
+	glBindBuffer (GL_ARRAY_BUFFER, g->ColorBuffer.name); // Bind the VBO colors 
+	glBufferData (GL_ARRAY_BUFFER, bytes, NULL, GL_DYNAMIC_DRAW);  // Room for the vertex colors
 	glVertexAttribPointer(
 			1,                  // attribute 1. Color
 			3,                  // size (r,g,b)
@@ -159,6 +362,61 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
 			0,                  // stride
 			(void*)0            // array buffer offset
 			);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+
+	return g;
+}
+
+/* The GL objects go with it */
+void poolDestroyGL (void *gpu, void *ctx)
+{
+	delete (struct PoolGL *)gpu;
+}
+
+/* Defragmenting moves a range from one pooled buffer to another, on the GPU */
+void poolCopyGL (void *from, size_t from_offset, void *to, size_t to_offset, size_t count, void *ctx)
+{
+	struct PoolGL *f = (struct PoolGL *)from, *t = (struct PoolGL *)to;
+	GLsizeiptr v = 3 * sizeof(GLfloat);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, f->VertexBuffer.name);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, t->VertexBuffer.name);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from_offset * v, to_offset * v, count * v);
+	glBindBuffer(GL_COPY_READ_BUFFER, f->ColorBuffer.name);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, t->ColorBuffer.name);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from_offset * v, to_offset * v, count * v);
+}
+
+/* Write n vertices over the start of vao's range */
+void fill3DObject (struct VAO *vao, int n, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data)
+{
+	struct PoolGL *g = (struct PoolGL *)poolGpu(&pool, vao->Range);
+	GLintptr at = vao->Range->offset * 3 * sizeof(GLfloat);
+
+	glBindBuffer(GL_ARRAY_BUFFER, g->VertexBuffer.name);
+	glBufferSubData(GL_ARRAY_BUFFER, at, 3 * n * sizeof(GLfloat), vertex_buffer_data);
+	glBindBuffer(GL_ARRAY_BUFFER, g->ColorBuffer.name);
+	glBufferSubData(GL_ARRAY_BUFFER, at, 3 * n * sizeof(GLfloat), color_buffer_data);
+	vao->NumVertices = n;
+	vao->Range->count = n;
+}
+
+/* Take a range of the pooled buffers for numVertices and fill it, unless
+   the data is NULL. Returns the handle drawn with, for releaseChunk to
+   give back, or NULL if the GPU budget has no room for it. */
+struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, GLenum fill_mode=GL_FILL)
+{
+	struct PoolAlloc *range = poolAlloc(&pool, numVertices);
+	if(!range)
+		return NULL;
+	struct VAO* vao = new struct VAO;
+	vao->PrimitiveMode = primitive_mode;
+	vao->NumVertices = 0;
+	vao->FillMode = fill_mode;
+	vao->Range = range;
+	if(vertex_buffer_data && color_buffer_data)
+		fill3DObject(vao, numVertices, vertex_buffer_data, color_buffer_data);
 
 	return vao;
 }
@@ -166,14 +424,63 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
 /* Generate VAO, VBOs and return VAO handle - Common Color for all vertices */
 struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat red, const GLfloat green, const GLfloat blue, GLenum fill_mode=GL_FILL)
 {
-	GLfloat* color_buffer_data = new GLfloat [3*numVertices];
+	std::vector<GLfloat> color_buffer_data(3*numVertices);
 	for (int i=0; i<numVertices; i++) {
 		color_buffer_data [3*i] = red;
 		color_buffer_data [3*i + 1] = green;
 		color_buffer_data [3*i + 2] = blue;
 	}
 
-	return create3DObject(primitive_mode, numVertices, vertex_buffer_data, color_buffer_data, fill_mode);
+	return create3DObject(primitive_mode, numVertices, vertex_buffer_data, color_buffer_data.data(), fill_mode);
+}
+
+/* Upload and free chunk meshes for the stream, on the GL thread */
+void *uploadChunk (const struct Mesh *mesh, void *ctx)
+{
+	return create3DObject(GL_TRIANGLES, meshVertices(mesh), mesh->pos.data(), mesh->color.data(), GL_FILL);
+}
+
+/* Every band of the level's mesh, straight from the mapped file */
+void uploadLevel ()
+{
+	size_t b;
+
+	for(b=0; b < level->n_bands; b++)
+	{
+		const struct LevelBand *band = &level->bands[b];
+		if(band->count == 0 || band->first > level->vertices || band->count > level->vertices - band->first)
+			level_bands.push_back(NULL);
+		else
+			level_bands.push_back(create3DObject(GL_TRIANGLES, band->count, level->pos + 3 * (size_t)band->first,
+					level->color + 3 * (size_t)band->first, GL_FILL));
+	}
+}
+
+void releaseChunk (void *gpu, void *ctx)
+{
+	struct VAO *vao = (struct VAO *)gpu;
+
+	poolFree(&pool, vao->Range);
+	delete vao;
+}
+
+/* A re-meshed chunk goes over its old geometry when it fits, otherwise
+   into a new range with room to grow */
+void *uploadRemesh (void *gpu, const struct Mesh *mesh, void *ctx)
+{
+	struct VAO *vao = (struct VAO *)gpu;
+	int n = meshVertices(mesh);
+
+	if(!vao || vao->Range->size < (size_t)n)
+	{
+		if(vao)
+			releaseChunk(vao, ctx);
+		vao = create3DObject(GL_TRIANGLES, n + n / 2 + 36, NULL, NULL, GL_FILL);
+		if(!vao)
+			return NULL;
+	}
+	fill3DObject(vao, n, mesh->pos.data(), mesh->color.data());
+	return vao;
 }
 
 /* Render the VBOs handled by VAO */
@@ -182,21 +489,38 @@ void draw3DObject (struct VAO* vao)
 	// Change the Fill Mode for this object
 	glPolygonMode (GL_FRONT_AND_BACK, vao->FillMode);
 
-	// Bind the VAO to use
-	glBindVertexArray (vao->VertexArrayID);
-
-	// Enable Vertex Attribute 0 - 3d Vertices
-	glEnableVertexAttribArray(0);
-	// Bind the VBO to use
-	glBindBuffer(GL_ARRAY_BUFFER, vao->VertexBuffer);
+	// Bind the pooled buffer's VAO, attributes enabled when it was made
+	glBindVertexArray (((struct PoolGL *)poolGpu(&pool, vao->Range))->VertexArrayID.name);
 
-	// Enable Vertex Attribute 1 - Color
-	glEnableVertexAttribArray(1);
-	// Bind the VBO to use
-	glBindBuffer(GL_ARRAY_BUFFER, vao->ColorBuffer);
+	// Draw the geometry from where its range starts
+	glDrawArrays(vao->PrimitiveMode, vao->Range->offset, vao->NumVertices);
+}
 
-	// Draw the geometry !
-	glDrawArrays(vao->PrimitiveMode, 0, vao->NumVertices); // Starting from vertex 0; 3 vertices total -> 1 triangle
+/* Many meshes under one transform, triangles all of them: one multi-draw
+   a pooled buffer rather than a draw each */
+void draw3DObjects (const std::vector<struct VAO *> &vaos)
+{
+	static std::vector<std::vector<GLint> > first;
+	static std::vector<std::vector<GLsizei> > count;
+	size_t n, b;
+
+	first.resize(pool.buffers.size());
+	count.resize(pool.buffers.size());
+	for(n=0; n < vaos.size(); n++)
+		if(vaos[n] && vaos[n]->NumVertices)
+		{
+			first[vaos[n]->Range->buffer].push_back(vaos[n]->Range->offset);
+			count[vaos[n]->Range->buffer].push_back(vaos[n]->NumVertices);
+		}
+	glPolygonMode (GL_FRONT_AND_BACK, GL_FILL);
+	for(b=0; b < first.size(); b++)
+		if(!first[b].empty())
+		{
+			glBindVertexArray(((struct PoolGL *)pool.buffers[b]->gpu)->VertexArrayID.name);
+			glMultiDrawArrays(GL_TRIANGLES, first[b].data(), count[b].data(), first[b].size());
+			first[b].clear();
+			count[b].clear();
+		}
 }
 
 /**************************
@@ -238,8 +562,6 @@ int adv_fl = 0;
 int tower_fl = 0;
 int top_fl = 0;
 int heli_fl = 0;
-int jump_fl = 0;
-int dir_up = 1;
 void enableTopcam()
 {
 	x_cam = 10;
@@ -327,40 +649,97 @@ void enableAdvcam()
 	heli_fl = 0;
 }
 
-bool checkIfFloor(float floor_y)
+/*void enableHelicoptercam()  {
+
+  }
+ */
+/* Sample the movement keys once per simulation tick. Movement is driven from
+   here rather than from key events so it does not depend on the OS key
+   repeat rate, and so the same mask can be recorded and replayed. */
+unsigned readInput (GLFWwindow* window)
 {
-	if(floor_y == y_cuboid && x_cuboid > 0 && x_cuboid < 17 && z_cuboid > 0 && z_cuboid < 20)
-		return true;
-	else 
-		return false;
+	unsigned input = 0;
+
+	if(glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+		input |= IN_UP;
+	if(glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+		input |= IN_DOWN;
+	if(glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+		input |= IN_RIGHT;
+	if(glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+		input |= IN_LEFT;
+	if(glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+		input |= IN_JUMP;
+	return input;
 }
 
-bool checkIfMovableFloor(float x_mov_floor, float z_mov_floor)
+/* The adventure camera looks the way the player last moved */
+void setFacing (unsigned input)
 {
-	if(x_cuboid < x_mov_floor + 1.9f && x_cuboid > x_mov_floor - 0.9f && z_cuboid < z_mov_floor + 1.9f && z_cuboid > z_mov_floor - 0.9f)
-		return true;
-	else
-		return false;
+	if(input & (IN_UP | IN_DOWN | IN_RIGHT | IN_LEFT))
+	{
+		up_fl = (input & IN_UP) != 0;
+		down_fl = (input & IN_DOWN) != 0;
+		right_fl = (input & IN_RIGHT) != 0;
+		left_fl = (input & IN_LEFT) != 0;
+	}
+}
+
+/* Whether the player, left alone, dies within a second as things are */
+bool simDying ()
+{
+	struct SimState at = sim;
+	int t;
+
+	for(t=0; t < SIM_HZ; t++)
+		if(simStep(&at, &course, 0) & SIM_EV_DIED)
+			return true;
+	return false;
 }
-bool checkIfObs(float x_obs, float z_obs)
+
+/* The cell ahead of the player gets an obstacle or loses it, or has a hole
+   knocked in it. A replay couldn't hold the edit. */
+void editAhead (bool hole)
 {
-	/*if(down_fl == 1 && z_cuboid + 1 > z_obs && x_cuboid < x_obs + 1.9f && x_cuboid > x_obs - 0.9f)
-		return true;
-	else if(up_fl == 1 && z_cuboid < z_obs + 1 && x_cuboid < x_obs + 1.9f && x_cuboid > x_obs - 0.9f)
-		return true;
-    else if(right_fl == 1 && x_cuboid + 1 > x_obs && z_cuboid < z_obs + 1.9f && z_cuboid > z_obs - 0.9f)
-		return true;
-	else if(left_fl == 1 && x_cuboid < x_obs + 1 && z_cuboid < z_obs + 1.9f && z_cuboid > z_obs - 0.9f)
-		return true;*/
-	if(x_cuboid > x_obs && x_cuboid < x_obs + 1 && z_cuboid > z_obs && z_cuboid < z_obs + 1)
-		return true;
+	int i = (int)floorf(sim.x_cuboid + 0.5f) + right_fl - left_fl;
+	int k = (int)floorf(sim.z_cuboid + 0.5f) + down_fl - up_fl;
+	struct SimState from;
+	bool done;
+
+	if(!remesh || play_path || record_path)
+	{
+		printf("Cannot edit a level, an endless course or a course with a replay running\n");
+		return;
+	}
+	/* Off-centre the player covers two cells, and "ahead" can be one of
+	   them: an edit under the inset box would kill them where they stand */
+	if(i >= (int)floorf(sim.x_cuboid + HIT_INSET) && i <= (int)floorf(sim.x_cuboid + 1 - HIT_INSET) &&
+			k >= (int)floorf(sim.z_cuboid + HIT_INSET) && k <= (int)floorf(sim.z_cuboid + 1 - HIT_INSET))
+		return;
+	if(hole)
+		done = remeshSetTile(remesh, i, k, TILE_PIT);
 	else
-		return false;
+		done = remeshSetObstacle(remesh, i, k, !(colCell(&course.index, i, k) & COL_OBSTACLE));
+	if(!done)
+		return;
+	if(hint_ok)
+		timedSetCell(&finder, &course, i, k);
+	hint_x = -1;
+	/* The history before the edit may run into it, so it starts again from
+	   here; or from the spawn if here is already on the way to dying, or
+	   every death would come back to it */
+	if(rewind_buf)
+	{
+		from = sim;
+		if(simDying())
+		{
+			simReset(&from, &course);
+			from.tick = sim.tick;
+		}
+		rewindReset(rewind_buf, &from);
+	}
 }
-/*void enableHelicoptercam()  {
 
-  }
- */
 /* Executed when a regular key is pressed/released/held-down */
 /* Prefered for Keyboard events */
 void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
@@ -369,37 +748,6 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 
 	if (action == GLFW_RELEASE) {
 		switch (key) {
-			case GLFW_KEY_UP:
-				z_cuboid -= 0.2f;
-				up_fl = 1;
-				down_fl = 0;
-				right_fl = 0;
-				left_fl = 0;
-				break;
-			case GLFW_KEY_DOWN:
-				z_cuboid += 0.2f;
-				up_fl = 0;
-				down_fl = 1;
-				right_fl = 0;
-				left_fl = 0;
-				break;
-			case GLFW_KEY_RIGHT:
-				x_cuboid += 0.2f;
-				up_fl = 0;
-				down_fl = 0;
-				right_fl = 1;
-				left_fl = 0;
-				break;
-			case GLFW_KEY_LEFT:
-				up_fl = 0;
-				down_fl = 0;
-				right_fl = 0;
-				left_fl = 1;
-				x_cuboid -= 0.2f;
-				break;
-			case GLFW_KEY_SPACE:
-				jump_fl = 1;
-				break;
 			case GLFW_KEY_T:
 				tower_fl = 1;
 				top_fl = 0;
@@ -426,6 +774,24 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 				//case GLFW_KEY_H:
 				//	enableHelicoptercam();
 				//	break;
+			case GLFW_KEY_G:
+				hint_fl = !hint_fl;
+				hint_x = -1;
+				if(hint_fl && !hint_ok)
+					printf("No way hint on a level or a course over %d cells\n", HINT_MAX_CELLS);
+				break;
+			case GLFW_KEY_N:
+				if(play_path || record_path)
+					printf("Cannot change course while a replay is running\n");
+				else
+					want_next = 1;
+				break;
+			case GLFW_KEY_O:
+				editAhead(false);
+				break;
+			case GLFW_KEY_C:
+				editAhead(true);
+				break;
 			case GLFW_KEY_F:
 				follow_flag = 1;
 				adv_fl = 0;
@@ -442,28 +808,6 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 		}
 	}
 
-	else if (action == GLFW_REPEAT) {
-		switch (key) {
-			case GLFW_KEY_UP:
-				z_cuboid -= 0.2f;
-				break;
-			case GLFW_KEY_DOWN:
-				z_cuboid += 0.2f;
-				break;
-			case GLFW_KEY_RIGHT:
-				x_cuboid += 0.2f;
-				break;
-			case GLFW_KEY_LEFT:
-				x_cuboid -= 0.2f;
-				break;
-				//   case GLFW_KEY_SPACE:
-
-				//       break;
-			default:
-				break;
-		}
-	}
-
 	else if (action == GLFW_PRESS) {
 		switch (key) {
 			case GLFW_KEY_ESCAPE:
@@ -590,7 +934,7 @@ void reshapeWindow (GLFWwindow* window, int width, int height)
   }
   };
  */
-VAO *cuboid, *zameen, *obs, *paani;
+VAO *cuboid, *zameen, *obs, *paani, *raasta;
 
 void createCuboid()
 {
@@ -983,6 +1327,21 @@ void createObs()
 	obs = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data, GL_FILL);
 }
 
+/* Way hint marker, a small square just above the floor */
+void createRaasta()
+{
+	static const GLfloat vertex_buffer_data [] = {
+		0.35f,0.01f,0.35f,
+		0.65f,0.01f,0.35f,
+		0.65f,0.01f,0.65f,
+
+		0.65f,0.01f,0.65f,
+		0.35f,0.01f,0.65f,
+		0.35f,0.01f,0.35f
+	};
+	raasta = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, 0.1f, 0.8f, 0.2f, GL_FILL);
+}
+
 /* Render the scene with openGL */
 /* Edit this function according to your assignment */
 void drawCuboid()
@@ -1034,7 +1393,7 @@ void drawCuboid()
 
 }
 
-void drawFloor(int x_floor, int y_floor, int z_floor)
+void drawFloor(int x_floor, float y_floor, int z_floor)
 {
 
 	// use the loaded shader program
@@ -1180,6 +1539,89 @@ void drawObs(int x_obs, int z_obs)
 }
 
 
+/* A streamed chunk's floor and obstacles, its row 0 at z_chunk */
+void drawChunk(struct VAO *vao, float z_chunk)
+{
+	glUseProgram (programID);
+
+	glm::vec3 eye (x_cam,y_cam,z_cam);
+	glm::vec3 target (x_target, y_target, z_target);
+	glm::vec3 up (x_axis, y_axis, z_axis);
+	Matrices.view = glm::lookAt( eye, target, up );
+	glm::mat4 VP = Matrices.projection * Matrices.view;
+
+	Matrices.model = glm::translate (glm::vec3(0,0,z_chunk));
+	glm::mat4 MVP = VP * Matrices.model;
+	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+
+	draw3DObject(vao);
+}
+
+/* Chunks with their vertices where they are drawn, all at once */
+void drawChunks(const std::vector<struct VAO *> &vaos)
+{
+	glUseProgram (programID);
+
+	glm::vec3 eye (x_cam,y_cam,z_cam);
+	glm::vec3 target (x_target, y_target, z_target);
+	glm::vec3 up (x_axis, y_axis, z_axis);
+	Matrices.view = glm::lookAt( eye, target, up );
+	glm::mat4 MVP = Matrices.projection * Matrices.view;
+	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+
+	draw3DObjects(vaos);
+}
+
+void drawRaasta(int x_raasta, int z_raasta)
+{
+
+	// use the loaded shader program
+	// Don't change unless you know what you are doing
+	glUseProgram (programID);
+
+	// Eye - Location of camera. Don't change unless you are sure!!
+	glm::vec3 eye (x_cam,y_cam,z_cam);
+	// Target - Where is the camera looking at.  Don't change unless you are sure!!
+	glm::vec3 target (x_target, y_target, z_target);
+	// Up - Up vector defines tilt of camera.  Don't change unless you are sure!!
+	glm::vec3 up (x_axis, y_axis, z_axis);
+
+	// Compute Camera matrix (view)
+	Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
+	//  Don't change unless you are sure!!
+	//Matrices.view = glm::lookAt(glm::vec3(10,10,10), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
+
+	// Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
+	//  Don't change unless you are sure!!
+	glm::mat4 VP = Matrices.projection * Matrices.view;
+
+	// Send our transformation to the currently bound shader, in the "MVP" uniform
+	// For each model you render, since the MVP will be different (at least the M part)
+	//  Don't change unless you are sure!!
+	glm::mat4 MVP;	// MVP = Projection * View * Model
+
+
+	Matrices.model = glm::mat4(1.0f);
+
+	/* Render your scene */
+
+	glm::mat4 translateRaasta = glm::translate (glm::vec3(x_raasta,0,z_raasta)); // glTranslatef
+	//glm::mat4 rotateTriangle = glm::rotate((float)(triangle_rotation*M_PI/180.0f), glm::vec3(0,0,1));  // rotate about vector (1,0,0)
+	glm::mat4 raastaTransform = translateRaasta;
+	Matrices.model *= raastaTransform; 
+	MVP = VP * Matrices.model; // MVP = p * V * M
+
+	//  Don't change unless you are sure!!
+	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+
+	// draw3DObject draws the VAO given to it using current MVP matrix
+	draw3DObject(raasta);
+
+	// Pop matrix to undo transformations till last push matrix instead of recomputing model matrix
+	// glPopMatrix ();
+}
+
+
 /* Initialise glfw window, I/O callbacks and the renderer to use */
 /* Nothing to Edit here */
 GLFWwindow* initGLFW (int width, int height)
@@ -1233,13 +1675,22 @@ GLFWwindow* initGLFW (int width, int height)
 void initGL (GLFWwindow* window, int width, int height)
 {
 	/* Objects should be created before any other gl function and shaders */
+	gpuInit(&gpu_objects, (size_t)gpu_budget << 20, gpuDeleteGL, NULL);
+	poolInit(&pool, poolCreateGL, poolDestroyGL, poolCopyGL, NULL);
 	// Create the models
 	createCuboid();
 	createFloor();
 	createObs();
+	createRaasta();
 	createWater();
+	if(!cuboid || !zameen || !obs || !raasta || !paani)
+	{
+		fprintf(stderr, "No room for the models in %d MB of GPU memory\n", gpu_budget);
+		quit(window);
+	}
 	// Create and compile our GLSL program from the shaders
 	programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
+	gpuAdopt(&gpu_objects, &program, GPU_PROGRAM, programID, "shader program");
 	// Get a handle for our "MVP" uniform
 	Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
 
@@ -1259,11 +1710,112 @@ void initGL (GLFWwindow* window, int width, int height)
 	cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
 }
 
+/* Give back everything initGL and the course made, before the context
+   goes. Whatever is left after is a leak. */
+void releaseGL ()
+{
+	size_t b;
+	VAO **models[] = { &cuboid, &zameen, &obs, &paani, &raasta };
+
+	for(b=0; b < level_bands.size(); b++)
+		if(level_bands[b])
+			releaseChunk(level_bands[b], NULL);
+	level_bands.clear();
+	for(b=0; b < sizeof(models) / sizeof(models[0]); b++)
+		if(*models[b])
+		{
+			releaseChunk(*models[b], NULL);
+			*models[b] = NULL;
+		}
+	gpuRelease(&program);
+}
+
 //sf::SoundBuffer buffer;
 //	sf::Sound sound;
 
+/* Replay a recording with no window. Prints where the run diverged, if it did. */
+int runHeadless (const char *path)
+{
+	long bad;
+
+	if(!replayLoad(&replay, path, REPLAY_MAX_TICKS))
+		return EXIT_FAILURE;
+	bad = replayRun(&replay, &course, &sim);
+	if(bad >= 0)
+	{
+		printf("%s: DIVERGED at tick %ld\n", path, bad);
+		return EXIT_FAILURE;
+	}
+	printf("%s: OK %u ticks, hash %016llx\n", path, (unsigned)replay.inputs.size(), (unsigned long long)replay.final_hash);
+	return EXIT_SUCCESS;
+}
+
+void usage (const char *prog)
+{
+	fprintf(stderr, "usage: %s [--seed n | --difficulty n] [--maze | --endless | --level file | --course file] [--save-course file] [--gpu-budget MB] [--no-rewind] [--record file | --play file [--headless]]\n", prog);
+	exit(EXIT_FAILURE);
+}
+
 int main (int argc, char** argv)
 {
+	int headless = 0;
+	int rewind_fl = 1;
+	uint32_t seed = (uint32_t)time(NULL);
+	int seed_fl = 0;
+	int pick_fl = 0;
+	int maze_fl = 0;
+	int endless_fl = 0;
+	const char *level_path = NULL;
+	const char *course_path = NULL;
+	const char *save_path = NULL;
+	for(int a=1; a<argc; a++)
+	{
+		if(!strcmp(argv[a], "--record") && a+1 < argc)
+			record_path = argv[++a];
+		else if(!strcmp(argv[a], "--play") && a+1 < argc)
+			play_path = argv[++a];
+		else if(!strcmp(argv[a], "--headless"))
+			headless = 1;
+		else if(!strcmp(argv[a], "--no-rewind"))
+			rewind_fl = 0;
+		else if(!strcmp(argv[a], "--seed") && a+1 < argc)
+		{
+			seed = strtoul(argv[++a], NULL, 0);
+			seed_fl = 1;
+		}
+		else if(!strcmp(argv[a], "--maze"))
+			maze_fl = 1;
+		else if(!strcmp(argv[a], "--endless"))
+			endless_fl = 1;
+		else if(!strcmp(argv[a], "--level") && a+1 < argc)
+			level_path = argv[++a];
+		else if(!strcmp(argv[a], "--course") && a+1 < argc)
+			course_path = argv[++a];
+		else if(!strcmp(argv[a], "--save-course") && a+1 < argc)
+			save_path = argv[++a];
+		else if(!strcmp(argv[a], "--gpu-budget") && a+1 < argc)
+			gpu_budget = atoi(argv[++a]);
+		else if(!strcmp(argv[a], "--difficulty") && a+1 < argc)
+		{
+			difficulty = atoi(argv[++a]);
+			pick_fl = 1;
+		}
+		else
+			usage(argv[0]);
+	}
+	/* A replay rebuilds its course from the seed, an endless one, a level
+	   file or a packed course has none */
+	if((endless_fl || level_path || course_path) && (maze_fl || record_path || play_path))
+		usage(argv[0]);
+	if(!!endless_fl + !!level_path + !!course_path > 1 || (save_path && (endless_fl || play_path)))
+		usage(argv[0]);
+	if(headless)
+	{
+		if(!play_path)
+			usage(argv[0]);
+		return runHeadless(play_path);
+	}
+
 	//bg music
 	
 	sf::Music music;
@@ -1271,39 +1823,185 @@ int main (int argc, char** argv)
 		return -1; // error
 	music.play();
 	
-	float t = 0 ;
 	int width = 600;
 	int height = 600;
-	int i,k,x[20],z[20],obsx[20],obsz[20],o;
-	float farsh_m_y = -4.0f;
-	float farsh_y = -1.0f;
-	int farsh_up_fl = 1;
+	int i,k,o;
+	float farsh_m_y;
+	float farsh_y = FARSH_Y;
+	int replay_done = 0;
+	int builtin = 0;                // playing the level built into the game
 	GLFWwindow* window = initGLFW(width, height);
 
 	initGL (window, width, height);
 
-	double last_update_time = glfwGetTime(), current_time;
-	for(i=0; i<20; i++)
+	if(play_path)
+	{
+		if(!replayLoad(&replay, play_path, REPLAY_MAX_TICKS))
+			quit(window);
+		replayStart(&replay, &course, &sim);
+		rewind_fl = (replay.flags & REPLAY_REWIND) != 0;
+	}
+	else
+	{
+		/* An explicit seed is played as is, otherwise pick one */
+		if(endless_fl)
+		{
+			int threads = std::thread::hardware_concurrency();
+			stream = new struct ChunkStream;
+			streamStart(stream, seed, COURSE_W, STREAM_BUDGET, threads > 2 ? threads - 1 : 1,
+					uploadChunk, releaseChunk, NULL);
+			streamWindow(stream, 0, &course);
+		}
+		else if(level_path)
+		{
+			level = new struct Level;
+			if(!levelOpen(level, level_path))
+			{
+				delete level;
+				level = NULL;
+				quit(window);
+			}
+			levelCourse(level, &course);
+			uploadLevel();
+		}
+		else if(course_path)
+		{
+			if(!packLoad(course_path, &course))
+				quit(window);
+		}
+		else if(maze_fl)
+			generateMazeCourse(&course, seed, COURSE_W, COURSE_D + 1);
+		else if(seed_fl)
+			generateCourse(&course, seed);
+		else if(!pick_fl && !record_path)
+		{
+			/* The built in level, parsed when the game was compiled. A
+			   replay couldn't rebuild it from a seed. */
+			struct Level lv;
+			embedOpen(&lv, default_level);
+			embedCourse(&lv, &course);
+			builtin = 1;
+		}
+		else
+		{
+			struct GenStats gs;
+			pickCourse(&course, seed, COURSE_W, COURSE_D, PICK_CANDIDATES, difficulty,
+					std::thread::hardware_concurrency(), &gs);
+			printf("Picked from %d courses in %.1f ms on %d threads\n",
+					gs.candidates, gs.seconds * 1e3, gs.threads);
+		}
+		if(save_path && !packSave(save_path, &course))
+			quit(window);
+		simReset(&sim, &course);
+		if(builtin)
+			printf("Built in level, %d x %d\n", course.w, course.d);
+		else
+			printf("Course seed %u\n", course.seed);
+		if(!record_path && !stream && !level && !course_path)
+			startNextCourse();
+		if(record_path)
+			replayBegin(&replay, &course, rewind_fl ? REPLAY_REWIND : 0);
+	}
+	/* The way hint needs the tiles, which a level keeps to itself */
+	if(!level)
+		hintInit();
+	if(!level && !stream)
 	{
-		obsx[i] = (rand() % 20);
-		x[i] = (rand() % 20);
-		z[i] = (rand() % 20);
-		obsz[i] = (rand() % 20);
+		int threads = std::thread::hardware_concurrency();
+		remesh = new struct Remesher;
+		remeshStart(remesh, &course, threads > 2 ? threads - 1 : 1, uploadRemesh, releaseChunk, NULL);
+	}
+	if(rewind_fl)
+	{
+		rewind_buf = new struct Rewind;
+		rewindReset(rewind_buf, &sim);
 	}
 
+	const double dt = 1.0 / SIM_HZ;
+	double last_update_time = glfwGetTime(), current_time;
+	double acc = 0;
+
 	/* Draw in loop */
 	while (!glfwWindowShouldClose(window)) {
-		if(farsh_m_y < 2.0f && farsh_up_fl == 1)
-			farsh_m_y += 0.005f;
+		/* Swap in the pre-generated course, then start on the one after */
+		if(want_next && next_course.load())
+		{
+			struct Course *c = next_course.exchange(NULL);
+			int threads = std::thread::hardware_concurrency();
+			remeshStop(remesh);
+			std::swap(course, *c);
+			delete c;
+			remeshStart(remesh, &course, threads > 2 ? threads - 1 : 1, uploadRemesh, releaseChunk, NULL);
+			simReset(&sim, &course);
+			if(rewind_buf)
+				rewindReset(rewind_buf, &sim);
+			hintInit();
+			printf("Course seed %u\n", course.seed);
+			want_next = 0;
+			startNextCourse();
+		}
+
+		current_time = glfwGetTime(); // Time in seconds
+		acc += current_time - last_update_time;
+		last_update_time = current_time;
+		if(acc > 0.25)
+			acc = 0.25; // don't try to catch up after a stall
+
+		/* Run as many fixed ticks as the elapsed time covers */
+		while(acc >= dt) {
+			unsigned input;
+			acc -= dt;
+			if(play_path)
+			{
+				if(replay.pos >= replay.inputs.size())
+				{
+					if(!replay_done)
+						printf("%s: OK %u ticks, hash %016llx\n", play_path, (unsigned)replay.inputs.size(), (unsigned long long)replay.final_hash);
+					replay_done = 1;
+					break;
+				}
+				input = replay.inputs[replay.pos];
+			}
+			else
+				input = readInput(window);
 
-		if(farsh_m_y >= 2.0f && farsh_up_fl == 1)
-			farsh_up_fl = 0;
+			setFacing(input);
+			if(rewindStep(rewind_buf, &sim, &course, input) & SIM_EV_FINISHED)
+			{
+				printf("Course finished in %.2f s\n", (double)sim.finish_tick / SIM_HZ);
+				if(!play_path && !record_path)
+					want_next = 1;
+			}
+
+			if(play_path && !replayCheck(&replay, &sim))
+			{
+				printf("%s: DIVERGED at tick %u\n", play_path, replay.pos);
+				quit(window);
+			}
+			if(record_path)
+				replayRecord(&replay, input, &sim);
+
+			/* Into the far chunk: move the window on, and the player
+			   back by a chunk so they stay where they are */
+			if(stream && sim.z_cuboid + 0.5f < CHUNK_D)
+			{
+				streamWindow(stream, ++stream_base, &course);
+				sim.z_cuboid += CHUNK_D;
+				if(rewind_buf)
+					rewindReset(rewind_buf, &sim);
+				hintInit();
+			}
+		}
+		if(stream)
+			streamUpdate(stream, stream_base, STREAM_UPLOADS);
+		if(remesh)
+			remeshUpdate(remesh, REMESH_UPLOADS);
+		poolDefrag(&pool, POOL_DEFRAG_BUDGET);
 
-		if(farsh_m_y > -4.0f && farsh_up_fl == 0)
-			farsh_m_y	 -= 0.005f;
-			
-		if(farsh_m_y <= -4.0f && farsh_up_fl == 0)
-			farsh_up_fl = 1;
+		x_cuboid = sim.x_cuboid;
+		y_cuboid = sim.y_cuboid;
+		z_cuboid = sim.z_cuboid;
+		farsh_m_y = movingFloorHeight(sim.tick);
 
 		// OpenGL Draw commands
 		if(follow_flag == 1)
@@ -1323,88 +2021,66 @@ int main (int argc, char** argv)
 			enableTowercam();
 		else
 			tower_fl = 0;
-/*
-		for(i=0; i < 17; i++)
-			for(k=0; k < 20; k++)
-			{
-				if(checkIfFloor(farsh_y + 1.0f))
-				{
-					cout << "ping\n";
-					if(jump_fl == 1 && y_cuboid < farsh_y + 2.0f)
-					{
-						cout << "ping1\n";
-						if(dir_up == 1)
-	 						y_cuboid += 0.1f;
-	 					else
-	 					{
-	 						y_cuboid -= 0.1f;
-	 						if(y_cuboid < farsh_y + 1)
-	 							jump_fl = 0;
-	 					}
-	 				}
-	 				else if(jump_fl == 1 && y_cuboid >= farsh_y + 2.0f)
-	 					dir_up = 0;
-	 			}
-
-
- 				if(checkIfMovableFloor((float)x[i],(float)z[k]))
- 				{
-					cout << "ping\n";
-
- 					y_cuboid = farsh_m_y;
- 					if(jump_fl == 1 && y_cuboid < farsh_m_y + 2.0f)
- 						if(dir_up == 1)
-	 						y_cuboid += 0.1f;
-	 					else
-	 					{
-	 						y_cuboid -= 0.1f;
-	 						if(y_cuboid < farsh_m_y + 1)
-	 							jump_fl = 0;
-	 					}
-	 				else if(jump_fl == 1 && y_cuboid >= farsh_m_y + 2.0f)
-	 					dir_up = 0;
-				}
-				if(checkIfObs((float)x[i],(float)z[k]))
-				{
-					x_cuboid = 0;
-					z_cuboid = 19.0f;
-				}
-*/	
-		if(jump_fl == 1 || (in_air == 0 && on_gr == 1))
-
-
-		if(x_cuboid < -1.0f || x_cuboid > 18.0f || z_cuboid < -1.0f || z_cuboid > 20.0f)
-			{
-				x_cuboid = 0;
-				z_cuboid = 19;
-			}
 
 		drawCuboid();	
 
-		for(i=0; i < 17; i++)
-			for(k=0; k < 20; k++)
+		/* Streamed chunks come as one mesh each, only the moving tiles
+		   are drawn a tile at a time. Only this thread sets a chunk's gpu. */
+		if(stream)
+		{
+			std::map<int, struct Chunk *>::iterator it;
+			for(it=stream->chunks.begin(); it != stream->chunks.end(); ++it)
+				if(it->second->gpu)
+					drawChunk((struct VAO *)it->second->gpu, (float)(stream_base + 1 - it->first) * CHUNK_D);
+		}
+		if(level)
+		{
+			static std::vector<struct VAO *> near;
+			size_t b, m;
+			near.clear();
+			for(b=0; b < level_bands.size(); b++)
+				if(level_bands[b] && fabsf((b + 0.5f) * LEVEL_BAND - z_cuboid) < 2 * LEVEL_BAND)
+					near.push_back(level_bands[b]);
+			drawChunks(near);
+			for(m=0; m < level->n_movers; m++)
+				if(fabsf(level->movers[m].z - z_cuboid) < 2 * LEVEL_BAND)
+					drawFloor(level->movers[m].x, farsh_m_y, level->movers[m].z);
+		}
+		if(remesh)
+		{
+			static std::vector<struct VAO *> chunks;
+			size_t n;
+			chunks.clear();
+			for(n=0; n < remesh->chunks.size(); n++)
+				if(remesh->chunks[n].gpu)
+					chunks.push_back((struct VAO *)remesh->chunks[n].gpu);
+			drawChunks(chunks);
+		}
+		for(i=0; i < course.w && !level; i++)
+			for(k=0; k < course.d; k++)
 			{
-				if(i != x[i] && k != z[i])
+				if(courseTile(&course, i, k) == TILE_FLOOR && !stream && !remesh)
 					drawFloor(i,farsh_y,k);
-				else
+				else if(courseTile(&course, i, k) == TILE_MOVING)
 					drawFloor(i,farsh_m_y,k);
-
-				if(checkIfObs((float)x[i],(float)z[k]))
-				{
-					x_cuboid = 0;
-					z_cuboid = 19.0f;
-				}
 			}
 
 		for(i=-20;i<40;i++)
 			for(k=-20; k<40; k++)
-				drawPaani(i,-3.0f,k);
+				drawPaani(i + (level ? (int)x_cuboid - 20 : 0),-3.0f,k + (stream || level ? (int)z_cuboid - 20 : 0));
 
 		
 
-		for(o=0; o<17; o++)
+		for(o=0; o<(int)course.obs.size() && !stream && !remesh; o++)
 		{
-			drawObs(obsx[o], obsz[o]);
+			drawObs(course.obs[o].x, course.obs[o].z);
+		}
+
+		if(hint_fl && hint_ok)
+		{
+			updateHint();
+			for(o=0; o<(int)hint.size(); o++)
+				drawRaasta(hint[o].x, hint[o].z);
 		}
 		
 
@@ -1413,15 +2089,6 @@ int main (int argc, char** argv)
 
 		// Poll for Keyboard and mouse events
 		glfwPollEvents();
-
-		// Control based on time (Time based transformation like 5 degrees rotation every 0.5s)
-		current_time = glfwGetTime(); // Time in seconds
-		if ((current_time - last_update_time) >= 0.5) { // atleast 0.5s elapsed since last frame
-			// do something every 0.5 seconds ..
-			last_update_time = current_time;
-		}
 	}
-	glfwTerminate();
-	exit(EXIT_SUCCESS);
-
+	quit(window);
 }
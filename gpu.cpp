@@ -0,0 +1,89 @@
+#include <algorithm>
+
+#include "gpu.h"
+
+static const char *kind_names[GPU_KINDS] = { "vertex arrays", "buffers", "programs" };
+
+void gpuInit(struct GpuRegistry *reg, size_t budget, GpuDelete del, void *ctx)
+{
+	reg->budget = budget;
+	reg->bytes = reg->peak_bytes = 0;
+	reg->refused = 0;
+	std::fill(reg->kinds, reg->kinds + GPU_KINDS, GpuKindStats());
+	reg->live.clear();
+	reg->del = del;
+	reg->ctx = ctx;
+}
+
+void gpuRelease(struct GpuObject *o)
+{
+	struct GpuRegistry *reg = o->reg;
+
+	if(!reg)
+		return;
+	if(reg->del)
+		reg->del(o->kind, o->name, reg->ctx);
+	reg->kinds[o->kind].live--;
+	reg->kinds[o->kind].bytes -= o->bytes;
+	reg->bytes -= o->bytes;
+	reg->live.erase(o);
+	o->reg = NULL;
+	o->name = 0;
+	o->bytes = 0;
+}
+
+void gpuAdopt(struct GpuRegistry *reg, struct GpuObject *o, int kind, unsigned name, const char *what)
+{
+	struct GpuKindStats *k = &reg->kinds[kind];
+
+	gpuRelease(o);
+	o->reg = reg;
+	o->kind = kind;
+	o->name = name;
+	o->bytes = 0;
+	o->what = what;
+	reg->live.insert(o);
+	k->live++;
+	k->made++;
+	k->peak = std::max(k->peak, k->live);
+}
+
+bool gpuResize(struct GpuObject *o, size_t bytes)
+{
+	struct GpuRegistry *reg = o->reg;
+	struct GpuKindStats *k = &reg->kinds[o->kind];
+
+	if(bytes > o->bytes && reg->budget && reg->bytes + bytes - o->bytes > reg->budget)
+	{
+		/* Once, rather than every frame something doesn't fit */
+		if(!reg->refused++)
+			fprintf(stderr, "GPU memory budget of %zu MB reached, %s not given %zu KB\n",
+					reg->budget >> 20, o->what, bytes >> 10);
+		return false;
+	}
+	reg->bytes += bytes - o->bytes;
+	k->bytes += bytes - o->bytes;
+	o->bytes = bytes;
+	reg->peak_bytes = std::max(reg->peak_bytes, reg->bytes);
+	k->peak_bytes = std::max(k->peak_bytes, k->bytes);
+	return true;
+}
+
+size_t gpuReport(const struct GpuRegistry *reg, FILE *out)
+{
+	std::set<struct GpuObject *>::const_iterator it;
+	int kind;
+
+	fprintf(out, "GPU memory %zu KB, peak %zu KB, budget %zu KB; %zu refused\n",
+			reg->bytes >> 10, reg->peak_bytes >> 10, reg->budget >> 10, reg->refused);
+	for(kind=0; kind < GPU_KINDS; kind++)
+	{
+		const struct GpuKindStats *k = &reg->kinds[kind];
+		fprintf(out, "  %-14s %6zu alive (peak %zu, %zu made), %zu KB (peak %zu KB)\n", kind_names[kind],
+				k->live, k->peak, k->made, k->bytes >> 10, k->peak_bytes >> 10);
+	}
+	for(it=reg->live.begin(); it != reg->live.end(); ++it)
+		fprintf(out, "  leaked: %s (%s, name %u), %zu KB\n", (*it)->what ? (*it)->what : "?",
+				kind_names[(*it)->kind], (*it)->name, (*it)->bytes >> 10);
+	return reg->live.size();
+}
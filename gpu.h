@@ -0,0 +1,84 @@
+#ifndef GPU_H
+#define GPU_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <set>
+
+/* GPU objects the game holds, owned and counted.
+ *
+ * Every vertex array, buffer and shader program is a GpuObject. Dropping
+ * one, or the struct it is in, deletes the object on the GPU through the
+ * registry's callback, so an object can't be forgotten without its count
+ * showing it. The registry keeps, by kind, how many are alive and the
+ * bytes they hold, and the peaks of both.
+ *
+ * Bytes are counted as objects are given storage, and storage that would
+ * take them all past the budget is refused: the caller does without, and
+ * the refusal is counted. A kiosk left running for days then holds no
+ * more than the budget however its courses come and go. At shutdown,
+ * once everything should be gone, gpuReport lists what is still alive.
+ *
+ * The registry knows nothing of GL: what a name means and how to delete
+ * it is up to the callback.
+ */
+enum {
+	GPU_VAO,
+	GPU_BUFFER,
+	GPU_PROGRAM,
+	GPU_KINDS
+};
+
+struct GpuKindStats {
+	size_t live, peak;         // objects
+	size_t bytes, peak_bytes;
+	size_t made;
+};
+
+/* Delete GPU object 'name' of kind GPU_* */
+typedef void (*GpuDelete)(int kind, unsigned name, void *ctx);
+
+struct GpuObject;
+
+struct GpuRegistry {
+	size_t budget;             // bytes all objects may hold, 0 for no limit
+	size_t bytes, peak_bytes;
+	size_t refused;            // storage not given for the budget
+	struct GpuKindStats kinds[GPU_KINDS];
+	std::set<struct GpuObject *> live;
+	GpuDelete del;
+	void *ctx;
+};
+
+void gpuInit(struct GpuRegistry *reg, size_t budget, GpuDelete del, void *ctx);
+
+void gpuRelease(struct GpuObject *o);
+
+/* Owns one GPU object. Not copyable: there is one owner, and when it goes
+   the object does. */
+struct GpuObject {
+	struct GpuRegistry *reg;   // NULL while it holds nothing
+	int kind;
+	unsigned name;
+	size_t bytes;
+	const char *what;          // for the leak report
+
+	GpuObject() : reg(NULL), kind(0), name(0), bytes(0), what(NULL) {}
+	~GpuObject() { gpuRelease(this); }
+	GpuObject(const GpuObject &) = delete;
+	GpuObject &operator=(const GpuObject &) = delete;
+};
+
+/* o takes on 'name', of kind GPU_*, letting go of what it held before */
+void gpuAdopt(struct GpuRegistry *reg, struct GpuObject *o, int kind, unsigned name, const char *what);
+
+/* o's storage becomes 'bytes'. Returns false, leaving it as it was, if the
+   budget has no room for the difference. */
+bool gpuResize(struct GpuObject *o, size_t bytes);
+
+/* Live, peak and bytes by kind, and every object still alive with what
+   made it. Returns how many are alive. */
+size_t gpuReport(const struct GpuRegistry *reg, FILE *out);
+
+#endif
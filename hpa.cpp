@@ -0,0 +1,507 @@
+#include <algorithm>
+
+#include "hpa.h"
+
+static const int dx8[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+static const int dz8[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+
+static inline int clusterOf(const struct Hpa *h, int x, int z)
+{
+	return (z / HPA_CLUSTER) * h->cw + x / HPA_CLUSTER;
+}
+
+/* Cell bounds of a cluster, clipped to the grid */
+static void clusterBox(const struct Hpa *h, const struct Grid *g, int c, int *x0, int *z0, int *x1, int *z1)
+{
+	*x0 = (c % h->cw) * HPA_CLUSTER;
+	*z0 = (c / h->cw) * HPA_CLUSTER;
+	*x1 = std::min(*x0 + HPA_CLUSTER, g->w);
+	*z1 = std::min(*z0 + HPA_CLUSTER, g->d);
+}
+
+static bool openLess(const struct PathOpen &a, const struct PathOpen &b)
+{
+	return a.key > b.key;
+}
+
+/* Dijkstra from (sx, sz) without leaving its cluster, into local_dist and
+   local_from indexed by position in the cluster. Stops once (tx, tz) is
+   settled, if that is inside the cluster. Steps cost less than
+   HPA_BUCKETS, so a ring of buckets by distance does for the queue. */
+static void localSearch(struct Hpa *h, const struct Grid *g, int c, int sx, int sz, int tx, int tz)
+{
+	int x0, z0, x1, z1, j;
+	int cw;
+	uint32_t target, d, pending = 1;
+	uint8_t *open = h->local_open;
+
+	clusterBox(h, g, c, &x0, &z0, &x1, &z1);
+	cw = x1 - x0;
+	target = (tx >= x0 && tx < x1 && tz >= z0 && tz < z1) ? (tz - z0) * cw + (tx - x0) : UINT32_MAX;
+	std::fill(h->local_dist.begin(), h->local_dist.end(), UINT32_MAX);
+	for(j=0; j < HPA_BUCKETS; j++)
+		h->local_bucket[j].clear();
+
+	/* Free cells of the cluster with a blocked rim, so neighbours need no
+	   bounds checks. Kept while the searches stay in one cluster. */
+	if(h->local_c != c)
+	{
+		for(int z=z0-1; z <= z1; z++)
+			for(int x=x0-1; x <= x1; x++)
+				*open++ = x >= x0 && x < x1 && z >= z0 && z < z1 && gridFree(g, x, z);
+		h->local_c = c;
+	}
+	open = h->local_open + (cw + 2) + 1;
+
+	h->local_dist[(sz - z0) * cw + (sx - x0)] = 0;
+	h->local_from[(sz - z0) * cw + (sx - x0)] = (sz - z0) * cw + (sx - x0);
+	h->local_bucket[0].push_back((sz - z0) * cw + (sx - x0));
+	for(d=0; pending; d++)
+	{
+		std::vector<uint16_t> &bucket = h->local_bucket[d % HPA_BUCKETS];
+		size_t k;
+
+		for(k=0; k < bucket.size(); k++)
+		{
+			uint32_t l = bucket[k];
+			int x = l % cw, z = l / cw, o = z * (cw + 2) + x;
+
+			pending--;
+			if(d > h->local_dist[l])
+				continue;
+			if(l == target)
+				return;
+			for(j=0; j < 8; j++)
+			{
+				int no = o + dz8[j] * (cw + 2) + dx8[j];
+				uint32_t nl, nd;
+				if(!open[no] || (j >= 4 && (!open[o + dx8[j]] || !open[o + dz8[j] * (cw + 2)])))
+					continue;
+				nl = l + dz8[j] * cw + dx8[j];
+				nd = d + (j < 4 ? PATH_STRAIGHT : PATH_DIAGONAL);
+				if(nd < h->local_dist[nl])
+				{
+					h->local_dist[nl] = nd;
+					h->local_from[nl] = l;
+					h->local_bucket[nd % HPA_BUCKETS].push_back(nl);
+					pending++;
+				}
+			}
+		}
+		bucket.clear();
+	}
+}
+
+/* Node on cell (x, z), which must be in cluster c. Made if there is none. */
+static uint32_t nodeOn(struct Hpa *h, const struct Grid *g, int c, int x, int z)
+{
+	uint32_t cell = (uint32_t)z * g->w + x, id;
+	size_t i;
+
+	for(i=0; i < h->members[c].size(); i++)
+		if(h->nodes[h->members[c][i]].cell == cell)
+			return h->members[c][i];
+	if(!h->free_nodes.empty())
+	{
+		id = h->free_nodes.back();
+		h->free_nodes.pop_back();
+	}
+	else
+	{
+		id = h->nodes.size();
+		h->nodes.push_back(HpaNode());
+	}
+	h->nodes[id].cell = cell;
+	h->nodes[id].cluster = c;
+	h->nodes[id].edges.clear();
+	h->members[c].push_back(id);
+	return id;
+}
+
+static void link(struct Hpa *h, uint32_t a, uint32_t b, uint32_t cost, uint32_t inter)
+{
+	struct HpaEdge e;
+
+	e.to = b;
+	e.cost = cost;
+	e.inter = inter;
+	h->nodes[a].edges.push_back(e);
+	e.to = a;
+	h->nodes[b].edges.push_back(e);
+}
+
+/* Forget the transitions between clusters a and b, and free nodes that
+   no longer lead out of their cluster. Edges go first, on both sides,
+   since freeing a node changes its cluster. */
+static void clearBorder(struct Hpa *h, int a, int b)
+{
+	int side, c, o;
+	size_t i, j;
+
+	for(side=0; side < 2; side++)
+	{
+		c = side ? b : a;
+		o = side ? a : b;
+		for(i=0; i < h->members[c].size(); i++)
+		{
+			std::vector<struct HpaEdge> &e = h->nodes[h->members[c][i]].edges;
+			for(j=0; j < e.size(); j++)
+				if(e[j].inter && h->nodes[e[j].to].cluster == (uint32_t)o)
+					e.erase(e.begin() + j--);
+		}
+	}
+	for(side=0; side < 2; side++)
+	{
+		c = side ? b : a;
+		for(i=0; i < h->members[c].size(); i++)
+		{
+			struct HpaNode *n = &h->nodes[h->members[c][i]];
+			for(j=0; j < n->edges.size() && !n->edges[j].inter; j++)
+				;
+			if(j == n->edges.size())
+			{
+				n->cluster = HPA_FREE;
+				n->edges.clear();
+				h->free_nodes.push_back(h->members[c][i]);
+				h->members[c].erase(h->members[c].begin() + i--);
+			}
+		}
+	}
+}
+
+/* Transitions across the east (dir 0) or south (dir 1) side of cluster c */
+static void buildBorder(struct Hpa *h, const struct Grid *g, int c, int dir)
+{
+	int x0, z0, x1, z1, o, len, t, run, i;
+
+	clusterBox(h, g, c, &x0, &z0, &x1, &z1);
+	o = dir ? c + h->cw : c + 1;
+	clearBorder(h, c, o);
+
+	/* Walk along the border; position t, this side (ax, az), other side +1 */
+	len = dir ? x1 - x0 : z1 - z0;
+	for(t=0; t < len; t = i)
+	{
+		for(i=t; i < len; i++)
+		{
+			int ax = dir ? x0 + i : x1 - 1, az = dir ? z1 - 1 : z0 + i;
+			if(!gridFree(g, ax, az) || !gridFree(g, ax + !dir, az + dir))
+				break;
+		}
+		run = i - t;
+		if(run == 0)
+		{
+			i++;
+			continue;
+		}
+		int ends[2] = { t + run / 2, -1 };
+		if(run >= HPA_WIDE_ENTRANCE)
+		{
+			ends[0] = t;
+			ends[1] = t + run - 1;
+		}
+		for(int e=0; e < 2 && ends[e] >= 0; e++)
+		{
+			int ax = dir ? x0 + ends[e] : x1 - 1, az = dir ? z1 - 1 : z0 + ends[e];
+			uint32_t a = nodeOn(h, g, c, ax, az);
+			uint32_t b = nodeOn(h, g, o, ax + !dir, az + dir);
+			link(h, a, b, PATH_STRAIGHT, 1);
+		}
+	}
+}
+
+/* Redo the edges between the nodes of cluster c */
+static void buildIntra(struct Hpa *h, const struct Grid *g, int c)
+{
+	std::vector<uint32_t> &m = h->members[c];
+	int x0, z0, x1, z1;
+	size_t i, j, k;
+
+	clusterBox(h, g, c, &x0, &z0, &x1, &z1);
+	for(i=0; i < m.size(); i++)
+	{
+		std::vector<struct HpaEdge> &e = h->nodes[m[i]].edges;
+		for(j=k=0; j < e.size(); j++)
+			if(e[j].inter)
+				e[k++] = e[j];
+		e.resize(k);
+		e.reserve(k + m.size() - 1);
+	}
+	for(i=0; i + 1 < m.size(); i++)
+	{
+		uint32_t cell = h->nodes[m[i]].cell;
+		localSearch(h, g, c, cell % g->w, cell / g->w, -1, -1);
+		for(j=i+1; j < m.size(); j++)
+		{
+			uint32_t other = h->nodes[m[j]].cell;
+			uint32_t d = h->local_dist[(other / g->w - z0) * (x1 - x0) + (other % g->w - x0)];
+			if(d != UINT32_MAX)
+				link(h, m[i], m[j], d, 0);
+		}
+	}
+}
+
+void hpaBuild(struct Hpa *h, const struct Grid *g)
+{
+	int c;
+
+	h->cw = (g->w + HPA_CLUSTER - 1) / HPA_CLUSTER;
+	h->cd = (g->d + HPA_CLUSTER - 1) / HPA_CLUSTER;
+	h->nodes.clear();
+	h->free_nodes.clear();
+	h->members.assign((size_t)h->cw * h->cd, std::vector<uint32_t>());
+	h->local_dist.resize(HPA_CLUSTER * HPA_CLUSTER);
+	h->local_from.resize(HPA_CLUSTER * HPA_CLUSTER);
+	h->gen = 0;
+	h->local_c = -1;
+
+	for(c=0; c < h->cw * h->cd; c++)
+	{
+		if(c % h->cw + 1 < h->cw)
+			buildBorder(h, g, c, 0);
+		if(c / h->cw + 1 < h->cd)
+			buildBorder(h, g, c, 1);
+	}
+	for(c=0; c < h->cw * h->cd; c++)
+		buildIntra(h, g, c);
+}
+
+void hpaSave(const struct Hpa *h, std::vector<struct HpaSavedNode> *nodes, std::vector<struct HpaEdge> *edges)
+{
+	size_t i;
+
+	nodes->clear();
+	edges->clear();
+	for(i=0; i < h->nodes.size(); i++)
+	{
+		const struct HpaNode *n = &h->nodes[i];
+		struct HpaSavedNode s = { n->cell, n->cluster, (uint32_t)edges->size(), (uint32_t)n->edges.size() };
+		nodes->push_back(s);
+		edges->insert(edges->end(), n->edges.begin(), n->edges.end());
+	}
+}
+
+void hpaLoad(struct Hpa *h, const struct Grid *g, const struct HpaSavedNode *nodes, size_t n_nodes,
+		const struct HpaEdge *edges)
+{
+	size_t i;
+
+	h->cw = (g->w + HPA_CLUSTER - 1) / HPA_CLUSTER;
+	h->cd = (g->d + HPA_CLUSTER - 1) / HPA_CLUSTER;
+	h->nodes.resize(n_nodes);
+	h->free_nodes.clear();
+	h->members.assign((size_t)h->cw * h->cd, std::vector<uint32_t>());
+	h->local_dist.resize(HPA_CLUSTER * HPA_CLUSTER);
+	h->local_from.resize(HPA_CLUSTER * HPA_CLUSTER);
+	h->gen = 0;
+	h->local_c = -1;
+	for(i=0; i < n_nodes; i++)
+	{
+		struct HpaNode *n = &h->nodes[i];
+		n->cell = nodes[i].cell;
+		n->cluster = nodes[i].cluster;
+		n->edges.assign(edges + nodes[i].first, edges + nodes[i].first + nodes[i].count);
+		if(n->cluster == HPA_FREE)
+			h->free_nodes.push_back(i);
+		else
+			h->members[n->cluster].push_back(i);
+	}
+}
+
+void hpaUpdate(struct Hpa *h, const struct Grid *g, int x, int z)
+{
+	int c = clusterOf(h, x, z), cx = c % h->cw, cz = c / h->cw;
+	int redo[5], n = 0, i;
+
+	h->local_c = -1;
+	redo[n++] = c;
+	if(x % HPA_CLUSTER == HPA_CLUSTER - 1 && cx + 1 < h->cw)
+	{
+		buildBorder(h, g, c, 0);
+		redo[n++] = c + 1;
+	}
+	if(x % HPA_CLUSTER == 0 && cx > 0)
+	{
+		buildBorder(h, g, c - 1, 0);
+		redo[n++] = c - 1;
+	}
+	if(z % HPA_CLUSTER == HPA_CLUSTER - 1 && cz + 1 < h->cd)
+	{
+		buildBorder(h, g, c, 1);
+		redo[n++] = c + h->cw;
+	}
+	if(z % HPA_CLUSTER == 0 && cz > 0)
+	{
+		buildBorder(h, g, c - h->cw, 1);
+		redo[n++] = c - h->cw;
+	}
+	for(i=0; i < n; i++)
+		buildIntra(h, g, redo[i]);
+}
+
+long hpaFindPath(struct Hpa *h, const struct Grid *g, struct PathPoint from, struct PathPoint to,
+		std::vector<struct PathPoint> *way)
+{
+	uint32_t n = h->nodes.size(), start = n, goal = n + 1, u;
+	int sc, gc, x0, z0, x1, z1;
+	size_t i;
+
+	way->clear();
+	h->expanded = 0;
+	h->local_c = -1;
+	if(!gridFree(g, from.x, from.z) || !gridFree(g, to.x, to.z))
+		return -1;
+	if(h->g.size() < n + 2)
+	{
+		h->g.resize(n + 2);
+		h->parent.resize(n + 2);
+		h->seen.assign(n + 2, 0);
+		h->goal_seen.assign(n + 2, 0);
+		h->goal_cost.resize(n + 2);
+	}
+	if(++h->gen == 0)
+	{
+		std::fill(h->seen.begin(), h->seen.end(), 0);
+		std::fill(h->goal_seen.begin(), h->goal_seen.end(), 0);
+		h->gen = 1;
+	}
+
+	/* Hook the start and the goal into their clusters for this query */
+	sc = clusterOf(h, from.x, from.z);
+	gc = clusterOf(h, to.x, to.z);
+	h->start_edges.clear();
+	clusterBox(h, g, sc, &x0, &z0, &x1, &z1);
+	localSearch(h, g, sc, from.x, from.z, -1, -1);
+	for(i=0; i < h->members[sc].size(); i++)
+	{
+		uint32_t cell = h->nodes[h->members[sc][i]].cell;
+		uint32_t d = h->local_dist[(cell / g->w - z0) * (x1 - x0) + (cell % g->w - x0)];
+		struct HpaEdge e = { h->members[sc][i], d, 0 };
+		if(d != UINT32_MAX)
+			h->start_edges.push_back(e);
+	}
+	if(sc == gc)
+	{
+		uint32_t d = h->local_dist[(to.z - z0) * (x1 - x0) + (to.x - x0)];
+		struct HpaEdge e = { goal, d, 0 };
+		if(d != UINT32_MAX)
+			h->start_edges.push_back(e);
+	}
+	clusterBox(h, g, gc, &x0, &z0, &x1, &z1);
+	localSearch(h, g, gc, to.x, to.z, -1, -1);
+	for(i=0; i < h->members[gc].size(); i++)
+	{
+		uint32_t id = h->members[gc][i], cell = h->nodes[id].cell;
+		uint32_t d = h->local_dist[(cell / g->w - z0) * (x1 - x0) + (cell % g->w - x0)];
+		if(d != UINT32_MAX)
+		{
+			h->goal_seen[id] = h->gen;
+			h->goal_cost[id] = d;
+		}
+	}
+
+	/* A* over the nodes. A node is reached this query if seen is gen, and
+	   closed once the top bit of its parent is set. */
+	h->open.clear();
+	h->seen[start] = h->gen;
+	h->g[start] = 0;
+	h->parent[start] = start;
+	{
+		struct PathOpen o = { (uint64_t)octile(from.x, from.z, to.x, to.z) << 32, start };
+		h->open.push_back(o);
+	}
+	while(!h->open.empty())
+	{
+		const std::vector<struct HpaEdge> *edges;
+		uint32_t gu;
+		int ux, uz;
+
+		u = h->open.front().cell;
+		std::pop_heap(h->open.begin(), h->open.end(), openLess);
+		h->open.pop_back();
+		if(h->parent[u] & 0x80000000u)
+			continue;
+		h->parent[u] |= 0x80000000u;
+		h->expanded++;
+		if(u == goal)
+			break;
+		gu = h->g[u];
+		edges = u == start ? &h->start_edges : &h->nodes[u].edges;
+
+		for(i=0; i <= edges->size(); i++)
+		{
+			uint32_t v, gv;
+			if(i < edges->size())
+			{
+				v = (*edges)[i].to;
+				gv = gu + (*edges)[i].cost;
+			}
+			else if(u != start && h->goal_seen[u] == h->gen)
+			{
+				v = goal;
+				gv = gu + h->goal_cost[u];
+			}
+			else
+				break;
+			if(h->seen[v] == h->gen && ((h->parent[v] & 0x80000000u) || gv >= h->g[v]))
+				continue;
+			h->seen[v] = h->gen;
+			h->g[v] = gv;
+			h->parent[v] = u;
+			if(v == goal)
+				ux = to.x, uz = to.z;
+			else
+				ux = h->nodes[v].cell % g->w, uz = h->nodes[v].cell / g->w;
+			struct PathOpen o = { (uint64_t)(gv + octile(ux, uz, to.x, to.z)) << 32 | (UINT32_MAX - gv), v };
+			h->open.push_back(o);
+			std::push_heap(h->open.begin(), h->open.end(), openLess);
+		}
+	}
+	if(h->seen[goal] != h->gen || !(h->parent[goal] & 0x80000000u))
+		return -1;
+
+	for(u = goal; ; u = h->parent[u] & 0x7fffffffu)
+	{
+		struct PathPoint p = to;
+		if(u == start)
+			p = from;
+		else if(u != goal)
+		{
+			p.x = h->nodes[u].cell % g->w;
+			p.z = h->nodes[u].cell / g->w;
+		}
+		if(way->empty() || way->back().x != p.x || way->back().z != p.z)
+			way->push_back(p);
+		if(u == start)
+			break;
+	}
+	std::reverse(way->begin(), way->end());
+	return h->g[goal];
+}
+
+void hpaRefine(struct Hpa *h, const struct Grid *g, const std::vector<struct PathPoint> &way, size_t seg,
+		std::vector<struct PathPoint> *cells)
+{
+	struct PathPoint a = way[seg], b = way[seg + 1];
+	int c = clusterOf(h, a.x, a.z), x0, z0, x1, z1, cw;
+	size_t mark = cells->size();
+	uint32_t l, first;
+
+	if(c != clusterOf(h, b.x, b.z))
+	{
+		cells->push_back(b);  // a transition, one straight step
+		return;
+	}
+	clusterBox(h, g, c, &x0, &z0, &x1, &z1);
+	cw = x1 - x0;
+	localSearch(h, g, c, a.x, a.z, b.x, b.z);
+	if(h->local_dist[(b.z - z0) * cw + (b.x - x0)] == UINT32_MAX)
+		return;  // the grid changed since the query
+	first = (a.z - z0) * cw + (a.x - x0);
+	for(l = (b.z - z0) * cw + (b.x - x0); l != first; l = h->local_from[l])
+	{
+		struct PathPoint p = { x0 + (int)(l % cw), z0 + (int)(l / cw) };
+		cells->push_back(p);
+	}
+	std::reverse(cells->begin() + mark, cells->end());
+}
@@ -0,0 +1,94 @@
+#ifndef HPA_H
+#define HPA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "path.h"
+
+/* Hierarchical path finding (HPA*, Botea et al.) over a Grid.
+ *
+ * The grid is cut into HPA_CLUSTER square clusters. Wherever two clusters
+ * touch, each run of cells that is open on both sides becomes one or two
+ * transitions: a node on each side joined by a single straight step. Nodes
+ * of the same cluster are joined by the cost of their shortest path inside
+ * the cluster. A query searches that small graph, and the path is turned
+ * back into cells one segment at a time, only when asked for.
+ *
+ * Paths only change cluster with straight steps, so they can be a little
+ * longer than the true shortest path, never shorter.
+ */
+#define HPA_CLUSTER 16
+
+/* Runs of open border at least this long get a transition at both ends */
+#define HPA_WIDE_ENTRANCE 6
+
+struct HpaEdge {
+	uint32_t to;
+	uint32_t cost;
+	uint32_t inter;   // crosses into another cluster
+};
+
+struct HpaNode {
+	uint32_t cell;
+	uint32_t cluster; // HPA_FREE while the node is unused
+	std::vector<struct HpaEdge> edges;
+};
+
+#define HPA_FREE UINT32_MAX
+
+/* More than the cost of one step, see localSearch */
+#define HPA_BUCKETS 16
+
+struct Hpa {
+	int cw, cd;                                  // clusters across and down
+	std::vector<struct HpaNode> nodes;
+	std::vector<uint32_t> free_nodes;
+	std::vector<std::vector<uint32_t> > members; // node ids of each cluster
+
+	/* Query scratch, reused */
+	std::vector<uint32_t> g, parent, seen, goal_seen, goal_cost;
+	uint32_t gen;
+	std::vector<struct PathOpen> open;
+	std::vector<struct HpaEdge> start_edges;
+	std::vector<uint32_t> local_dist;
+	std::vector<uint16_t> local_from;
+	std::vector<uint16_t> local_bucket[HPA_BUCKETS];
+	uint8_t local_open[(HPA_CLUSTER + 2) * (HPA_CLUSTER + 2)];
+	int local_c;      // cluster local_open was filled for, -1 for none
+	size_t expanded;  // abstract nodes expanded by the last query
+};
+
+/* Build the abstraction of g from scratch */
+void hpaBuild(struct Hpa *h, const struct Grid *g);
+
+/* Call after cell (x, z) of g was blocked or cleared. Only the borders the
+   cell lies on and the clusters around it are redone. */
+void hpaUpdate(struct Hpa *h, const struct Grid *g, int x, int z);
+
+/* The abstraction flattened for a file: node i's edges are
+   edges[first .. first+count-1]. Free nodes are kept, so ids don't change. */
+struct HpaSavedNode {
+	uint32_t cell, cluster;
+	uint32_t first, count;
+};
+
+void hpaSave(const struct Hpa *h, std::vector<struct HpaSavedNode> *nodes, std::vector<struct HpaEdge> *edges);
+
+/* Take an abstraction hpaSave made for g, instead of building it */
+void hpaLoad(struct Hpa *h, const struct Grid *g, const struct HpaSavedNode *nodes, size_t n_nodes,
+		const struct HpaEdge *edges);
+
+/* Search the abstract graph. Returns the path cost in PATH_STRAIGHT units
+   and fills 'way' with its waypoints, first 'from' and last 'to', or
+   returns -1 if 'to' can't be reached. */
+long hpaFindPath(struct Hpa *h, const struct Grid *g, struct PathPoint from, struct PathPoint to,
+		std::vector<struct PathPoint> *way);
+
+/* Append the cells from way[seg] (excluded) to way[seg+1] (included).
+   Appends nothing if the grid changed and they are no longer connected. */
+void hpaRefine(struct Hpa *h, const struct Grid *g, const std::vector<struct PathPoint> &way, size_t seg,
+		std::vector<struct PathPoint> *cells);
+
+#endif
@@ -0,0 +1,506 @@
+#include <fcntl.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+
+#include "level.h"
+
+/* Levels bigger than this each way are refused before anything is sized */
+#define LEVEL_MAX_SIDE (1 << 20)
+
+static size_t alignUp(size_t n)
+{
+	return (n + LEVEL_ALIGN - 1) & ~(size_t)(LEVEL_ALIGN - 1);
+}
+
+static size_t bandCount(int d)
+{
+	return (d + LEVEL_BAND - 1) / LEVEL_BAND;
+}
+
+static size_t gridWords(int w, int d)
+{
+	return (size_t)(w + 63) / 64 * d;
+}
+
+void bakeMovers(struct LevelBake *b, const struct Course *course)
+{
+	int i, k;
+
+	b->movers.clear();
+	for(k=0; k < course->d; k++)
+		for(i=0; i < course->w; i++)
+			if(courseTile(course, i, k) == TILE_MOVING)
+			{
+				struct LevelMover m = { i, k, FARSH_M_LOW, FARSH_M_HIGH, FARSH_M_LEG, 0 };
+				b->movers.push_back(m);
+			}
+}
+
+void bakeGrid(struct LevelBake *b, const struct Course *course)
+{
+	gridFromCourse(&b->grid, course);
+}
+
+void bakeReach(struct LevelBake *b, const struct Course *course)
+{
+	struct Bitboard walk;
+	struct Reach r;
+
+	boardWalkable(&walk, course, true);
+	reachFill(&r, &walk, course->spawn_x, course->spawn_z, REACH_SWEEP);
+	b->reach = r.seen;
+}
+
+void bakeHpa(struct LevelBake *b)
+{
+	struct Hpa *h = new struct Hpa;
+
+	hpaBuild(h, &b->grid);
+	hpaSave(h, &b->hpa_nodes, &b->hpa_edges);
+	delete h;
+}
+
+/* Bands first, first + step, ... of the course into out[band] */
+static void meshBands(const struct Course *course, size_t first, size_t step, std::vector<struct Mesh> *out)
+{
+	size_t n;
+
+	for(n=first; n < out->size(); n += step)
+	{
+		int k = n * LEVEL_BAND;
+		meshCourseGreedy(&(*out)[n], course, k, k + LEVEL_BAND < course->d ? k + LEVEL_BAND : course->d);
+	}
+}
+
+void bakeMesh(struct LevelBake *b, const struct Course *course, int threads)
+{
+	std::vector<struct Mesh> bands(bandCount(course->d));
+	std::vector<std::thread> workers;
+	size_t n;
+	int t;
+
+	if(threads < 1)
+		threads = 1;
+	for(t=1; t < threads; t++)
+		workers.push_back(std::thread(meshBands, course, t, threads, &bands));
+	meshBands(course, 0, threads, &bands);
+	for(n=0; n < workers.size(); n++)
+		workers[n].join();
+
+	b->bands.clear();
+	b->mesh.pos.clear();
+	b->mesh.color.clear();
+	for(n=0; n < bands.size(); n++)
+	{
+		struct LevelBand band = { (uint32_t)meshVertices(&b->mesh), (uint32_t)meshVertices(&bands[n]) };
+		b->bands.push_back(band);
+		b->mesh.pos.insert(b->mesh.pos.end(), bands[n].pos.begin(), bands[n].pos.end());
+		b->mesh.color.insert(b->mesh.color.end(), bands[n].color.begin(), bands[n].color.end());
+	}
+}
+
+void levelBake(struct LevelBake *b, const struct Course *course)
+{
+	bakeMovers(b, course);
+	bakeGrid(b, course);
+	bakeReach(b, course);
+	bakeHpa(b);
+	bakeMesh(b, course, 1);
+}
+
+bool levelWrite(const char *path, const struct Course *course, const struct LevelBake *b)
+{
+	struct LevelHeader hdr;
+	const void *data[LEVEL_SECTIONS];
+	static const char zero[LEVEL_ALIGN] = { 0 };
+	size_t at;
+	int s;
+	FILE *f;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, LEVEL_MAGIC, 4);
+	hdr.version = LEVEL_VERSION;
+	hdr.seed = course->seed;
+	hdr.w = course->w;
+	hdr.d = course->d;
+	hdr.spawn_x = course->spawn_x;
+	hdr.spawn_z = course->spawn_z;
+	hdr.band = LEVEL_BAND;
+	hdr.sec[LEVEL_TILES].bytes = course->tiles.size();
+	hdr.sec[LEVEL_OBSTACLES].bytes = course->obs.size() * sizeof(struct Obstacle);
+	hdr.sec[LEVEL_MOVING].bytes = b->movers.size() * sizeof(struct LevelMover);
+	hdr.sec[LEVEL_COLLISION].bytes = (size_t)course->index.stride * (course->d + 2);
+	hdr.sec[LEVEL_GRID].bytes = b->grid.bits.size() * sizeof(uint64_t);
+	hdr.sec[LEVEL_REACH].bytes = b->reach.bits.size() * sizeof(uint64_t);
+	hdr.sec[LEVEL_HPA_NODES].bytes = b->hpa_nodes.size() * sizeof(struct HpaSavedNode);
+	hdr.sec[LEVEL_HPA_EDGES].bytes = b->hpa_edges.size() * sizeof(struct HpaEdge);
+	hdr.sec[LEVEL_BANDS].bytes = b->bands.size() * sizeof(struct LevelBand);
+	hdr.sec[LEVEL_POS].bytes = b->mesh.pos.size() * sizeof(float);
+	hdr.sec[LEVEL_COLOR].bytes = b->mesh.color.size() * sizeof(float);
+	data[LEVEL_TILES] = course->tiles.data();
+	data[LEVEL_OBSTACLES] = course->obs.data();
+	data[LEVEL_MOVING] = b->movers.data();
+	data[LEVEL_COLLISION] = course->index.cells;
+	data[LEVEL_GRID] = b->grid.bits.data();
+	data[LEVEL_REACH] = b->reach.bits.data();
+	data[LEVEL_HPA_NODES] = b->hpa_nodes.data();
+	data[LEVEL_HPA_EDGES] = b->hpa_edges.data();
+	data[LEVEL_BANDS] = b->bands.data();
+	data[LEVEL_POS] = b->mesh.pos.data();
+	data[LEVEL_COLOR] = b->mesh.color.data();
+	at = alignUp(sizeof(hdr));
+	for(s=0; s < LEVEL_SECTIONS; s++)
+	{
+		hdr.sec[s].offset = at;
+		at = alignUp(at + hdr.sec[s].bytes);
+	}
+	hdr.size = at;
+
+	f = fopen(path, "wb");
+	if(!f)
+	{
+		fprintf(stderr, "Cannot write level %s\n", path);
+		return false;
+	}
+	at = fwrite(&hdr, sizeof(hdr), 1, f) == 1 ? sizeof(hdr) : 0;
+	for(s=0; s < LEVEL_SECTIONS && at; s++)
+	{
+		if(fwrite(zero, 1, hdr.sec[s].offset - at, f) != hdr.sec[s].offset - at ||
+				fwrite(data[s], 1, hdr.sec[s].bytes, f) != hdr.sec[s].bytes)
+			at = 0;
+		else
+			at = hdr.sec[s].offset + hdr.sec[s].bytes;
+	}
+	if(at && fwrite(zero, 1, hdr.size - at, f) != hdr.size - at)
+		at = 0;
+	if(fclose(f) != 0 || !at)
+	{
+		fprintf(stderr, "Error writing level %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+/* Size a section must have, or 0 with *each set for a list of those */
+static size_t sectionBytes(const struct LevelHeader *hdr, int s, size_t *each)
+{
+	*each = 0;
+	switch(s)
+	{
+	case LEVEL_TILES:
+		return (size_t)hdr->w * hdr->d;
+	case LEVEL_OBSTACLES:
+		*each = sizeof(struct Obstacle);
+		return 0;
+	case LEVEL_MOVING:
+		*each = sizeof(struct LevelMover);
+		return 0;
+	case LEVEL_COLLISION:
+		return (size_t)(hdr->w + 2) * (hdr->d + 2);
+	case LEVEL_GRID:
+	case LEVEL_REACH:
+		return gridWords(hdr->w, hdr->d) * sizeof(uint64_t);
+	case LEVEL_HPA_NODES:
+		*each = sizeof(struct HpaSavedNode);
+		return 0;
+	case LEVEL_HPA_EDGES:
+		*each = sizeof(struct HpaEdge);
+		return 0;
+	case LEVEL_BANDS:
+		return bandCount(hdr->d) * sizeof(struct LevelBand);
+	default:
+		*each = 3 * sizeof(float);
+		return 0;
+	}
+}
+
+static bool checkHeader(const struct Level *lv)
+{
+	const struct LevelHeader *hdr = lv->hdr;
+	int s;
+
+	if(memcmp(hdr->magic, LEVEL_MAGIC, 4) != 0)
+	{
+		fprintf(stderr, "%s is not a level\n", lv->path);
+		return false;
+	}
+	if(hdr->version != LEVEL_VERSION)
+	{
+		fprintf(stderr, "%s: unsupported level version %u\n", lv->path, hdr->version);
+		return false;
+	}
+	if(hdr->size != lv->size)
+	{
+		fprintf(stderr, "%s: %zu bytes, header says %llu\n", lv->path, lv->size, (unsigned long long)hdr->size);
+		return false;
+	}
+	if(hdr->w < 1 || hdr->d < 1 || hdr->w > LEVEL_MAX_SIDE || hdr->d > LEVEL_MAX_SIDE || hdr->band != LEVEL_BAND)
+	{
+		fprintf(stderr, "%s: bad size %d x %d, band %d\n", lv->path, hdr->w, hdr->d, hdr->band);
+		return false;
+	}
+	for(s=0; s < LEVEL_SECTIONS; s++)
+	{
+		const struct LevelSection *sec = &hdr->sec[s];
+		size_t each, want = sectionBytes(hdr, s, &each);
+		if(sec->offset % LEVEL_ALIGN || sec->offset < sizeof(*hdr) || sec->offset > lv->size ||
+				sec->bytes > lv->size - sec->offset)
+		{
+			fprintf(stderr, "%s: section %d out of place\n", lv->path, s);
+			return false;
+		}
+		if(each ? sec->bytes % each != 0 : sec->bytes != want)
+		{
+			fprintf(stderr, "%s: section %d is %llu bytes\n", lv->path, s, (unsigned long long)sec->bytes);
+			return false;
+		}
+	}
+	if(hdr->sec[LEVEL_POS].bytes != hdr->sec[LEVEL_COLOR].bytes)
+	{
+		fprintf(stderr, "%s: %llu bytes of positions, %llu of colours\n", lv->path,
+				(unsigned long long)hdr->sec[LEVEL_POS].bytes, (unsigned long long)hdr->sec[LEVEL_COLOR].bytes);
+		return false;
+	}
+	return true;
+}
+
+bool levelOpen(struct Level *lv, const char *path)
+{
+	const char *base;
+	struct stat st;
+	int fd;
+
+	memset(lv, 0, sizeof(*lv));
+	lv->path = path;
+	fd = open(path, O_RDONLY);
+	if(fd < 0)
+	{
+		fprintf(stderr, "Cannot open level %s\n", path);
+		return false;
+	}
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct LevelHeader))
+	{
+		fprintf(stderr, "%s is not a level\n", path);
+		close(fd);
+		return false;
+	}
+	lv->size = st.st_size;
+	lv->map = mmap(NULL, lv->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(lv->map == MAP_FAILED)
+	{
+		fprintf(stderr, "Cannot map level %s\n", path);
+		lv->map = NULL;
+		return false;
+	}
+	lv->hdr = (const struct LevelHeader *)lv->map;
+	if(!checkHeader(lv))
+	{
+		levelClose(lv);
+		return false;
+	}
+
+	base = (const char *)lv->map;
+	lv->tiles = (const uint8_t *)(base + lv->hdr->sec[LEVEL_TILES].offset);
+	lv->obs = (const struct Obstacle *)(base + lv->hdr->sec[LEVEL_OBSTACLES].offset);
+	lv->n_obs = lv->hdr->sec[LEVEL_OBSTACLES].bytes / sizeof(struct Obstacle);
+	lv->movers = (const struct LevelMover *)(base + lv->hdr->sec[LEVEL_MOVING].offset);
+	lv->n_movers = lv->hdr->sec[LEVEL_MOVING].bytes / sizeof(struct LevelMover);
+	lv->cells = (const uint8_t *)(base + lv->hdr->sec[LEVEL_COLLISION].offset);
+	lv->grid = (const uint64_t *)(base + lv->hdr->sec[LEVEL_GRID].offset);
+	lv->reach = (const uint64_t *)(base + lv->hdr->sec[LEVEL_REACH].offset);
+	lv->hpa_nodes = (const struct HpaSavedNode *)(base + lv->hdr->sec[LEVEL_HPA_NODES].offset);
+	lv->n_hpa_nodes = lv->hdr->sec[LEVEL_HPA_NODES].bytes / sizeof(struct HpaSavedNode);
+	lv->hpa_edges = (const struct HpaEdge *)(base + lv->hdr->sec[LEVEL_HPA_EDGES].offset);
+	lv->n_hpa_edges = lv->hdr->sec[LEVEL_HPA_EDGES].bytes / sizeof(struct HpaEdge);
+	lv->bands = (const struct LevelBand *)(base + lv->hdr->sec[LEVEL_BANDS].offset);
+	lv->n_bands = bandCount(lv->hdr->d);
+	lv->pos = (const float *)(base + lv->hdr->sec[LEVEL_POS].offset);
+	lv->color = (const float *)(base + lv->hdr->sec[LEVEL_COLOR].offset);
+	lv->vertices = lv->hdr->sec[LEVEL_POS].bytes / (3 * sizeof(float));
+	return true;
+}
+
+void levelClose(struct Level *lv)
+{
+	if(lv->map)
+		munmap(lv->map, lv->size);
+	lv->map = NULL;
+	lv->hdr = NULL;
+}
+
+/* Print a problem, the first few of them */
+static void problem(const struct Level *lv, int *n, const char *fmt, ...)
+{
+	va_list ap;
+
+	if((*n)++ >= 20)
+		return;
+	va_start(ap, fmt);
+	fprintf(stderr, "%s: ", lv->path);
+	vfprintf(stderr, fmt, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+}
+
+bool levelCheck(const struct Level *lv)
+{
+	const struct LevelHeader *hdr = lv->hdr;
+	std::vector<uint8_t> moved((size_t)hdr->w * hdr->d, 0), want((size_t)(hdr->w + 2) * (hdr->d + 2), 0);
+	struct Grid grid;
+	struct Bitboard walk;
+	struct Reach r;
+	int n = 0, i, k, stride = hdr->w + 2;
+	size_t m, v, moving = 0, first = 0;
+
+	for(m=0; m < (size_t)hdr->w * hdr->d; m++)
+	{
+		if(lv->tiles[m] > TILE_MOVING)
+			problem(lv, &n, "tile (%d, %d) is %d", (int)(m % hdr->w), (int)(m / hdr->w), lv->tiles[m]);
+		moving += lv->tiles[m] == TILE_MOVING;
+	}
+	if(hdr->spawn_x < 0 || hdr->spawn_z < 0 || hdr->spawn_x >= hdr->w || hdr->spawn_z >= hdr->d ||
+			lv->tiles[(size_t)hdr->spawn_z * hdr->w + hdr->spawn_x] != TILE_FLOOR)
+		problem(lv, &n, "spawn (%d, %d) is not on floor", hdr->spawn_x, hdr->spawn_z);
+
+	for(m=0; m < lv->n_obs; m++)
+	{
+		const struct Obstacle *o = &lv->obs[m];
+		if(o->x < 0 || o->z < 0 || o->x >= hdr->w || o->z >= hdr->d || lv->tiles[(size_t)o->z * hdr->w + o->x] != TILE_FLOOR)
+			problem(lv, &n, "obstacle %zu at (%d, %d) is not on floor", m, o->x, o->z);
+		else if(o->x == hdr->spawn_x && o->z == hdr->spawn_z)
+			problem(lv, &n, "obstacle %zu on the spawn", m);
+	}
+
+	if(lv->n_movers != moving)
+		problem(lv, &n, "%zu moving tiles but %zu schedules", moving, lv->n_movers);
+	for(m=0; m < lv->n_movers; m++)
+	{
+		const struct LevelMover *mv = &lv->movers[m];
+		if(mv->x < 0 || mv->z < 0 || mv->x >= hdr->w || mv->z >= hdr->d ||
+				lv->tiles[(size_t)mv->z * hdr->w + mv->x] != TILE_MOVING || moved[(size_t)mv->z * hdr->w + mv->x]++)
+			problem(lv, &n, "schedule %zu at (%d, %d) is not for a moving tile of its own", m, mv->x, mv->z);
+		else if(mv->low != FARSH_M_LOW || mv->high != FARSH_M_HIGH || mv->leg != FARSH_M_LEG || mv->phase != 0)
+			problem(lv, &n, "moving tile (%d, %d) has a schedule the game can't play", mv->x, mv->z);
+	}
+
+	for(k=0; k < hdr->d; k++)
+		for(i=0; i < hdr->w; i++)
+		{
+			int t = lv->tiles[(size_t)k * hdr->w + i];
+			want[(size_t)(k + 1) * stride + i + 1] = t == TILE_FLOOR ? COL_FLOOR : t == TILE_MOVING ? COL_MOVING : 0;
+		}
+	for(m=0; m < lv->n_obs; m++)
+		if(lv->obs[m].x >= 0 && lv->obs[m].z >= 0 && lv->obs[m].x < hdr->w && lv->obs[m].z < hdr->d)
+			want[(size_t)(lv->obs[m].z + 1) * stride + lv->obs[m].x + 1] |= COL_OBSTACLE;
+	for(m=0; m < want.size(); m++)
+		if(lv->cells[m] != want[m])
+			problem(lv, &n, "collision cell (%d, %d) is %d, the tiles make it %d",
+					(int)(m % stride) - 1, (int)(m / stride) - 1, lv->cells[m], want[m]);
+
+	/* The grid blocks what isn't floor or moving or holds an obstacle; the
+	   reachable cells are what a fill from the spawn over the rest gets */
+	gridInit(&grid, hdr->w, hdr->d);
+	boardInit(&walk, hdr->w, hdr->d);
+	for(k=0; k < hdr->d; k++)
+		for(i=0; i < hdr->w; i++)
+			if(want[(size_t)(k + 1) * stride + i + 1] & (COL_FLOOR | COL_MOVING) &&
+					!(want[(size_t)(k + 1) * stride + i + 1] & COL_OBSTACLE))
+				boardSet(&walk, i, k);
+			else
+				gridBlock(&grid, i, k);
+	if(memcmp(lv->grid, grid.bits.data(), grid.bits.size() * sizeof(uint64_t)) != 0)
+		problem(lv, &n, "path grid doesn't match the tiles");
+	reachFill(&r, &walk, hdr->spawn_x, hdr->spawn_z, REACH_SWEEP);
+	if(memcmp(lv->reach, r.seen.bits.data(), r.seen.bits.size() * sizeof(uint64_t)) != 0)
+		problem(lv, &n, "reachable cells aren't those the spawn reaches");
+
+	for(m=0; m < lv->n_hpa_nodes; m++)
+	{
+		const struct HpaSavedNode *h = &lv->hpa_nodes[m];
+		int cw = (hdr->w + HPA_CLUSTER - 1) / HPA_CLUSTER;
+		if(h->first > lv->n_hpa_edges || h->count > lv->n_hpa_edges - h->first)
+			problem(lv, &n, "HPA* node %zu has edges %u + %u of %zu", m, h->first, h->count, lv->n_hpa_edges);
+		else if(h->cluster != HPA_FREE && (h->cell >= (uint32_t)hdr->w * hdr->d ||
+				!gridFree(&grid, h->cell % hdr->w, h->cell / hdr->w) ||
+				h->cluster != (h->cell / hdr->w / HPA_CLUSTER) * cw + h->cell % hdr->w / HPA_CLUSTER))
+			problem(lv, &n, "HPA* node %zu is not on an open cell of its cluster", m);
+		else
+			for(v=h->first; v < (size_t)h->first + h->count; v++)
+				if(lv->hpa_edges[v].to >= lv->n_hpa_nodes || lv->hpa_nodes[lv->hpa_edges[v].to].cluster == HPA_FREE)
+				{
+					problem(lv, &n, "HPA* node %zu has an edge to nowhere", m);
+					break;
+				}
+	}
+
+	for(m=0; m < lv->n_bands; m++)
+	{
+		const struct LevelBand *b = &lv->bands[m];
+		float k0 = m * LEVEL_BAND, k1 = k0 + LEVEL_BAND;
+		if(b->first != first || b->count > lv->vertices - first)
+		{
+			problem(lv, &n, "band %zu is vertices %u + %u, expected to start at %zu", m, b->first, b->count, first);
+			break;
+		}
+		for(v=b->first; v < (size_t)b->first + b->count; v++)
+		{
+			const float *p = &lv->pos[3 * v], *c = &lv->color[3 * v];
+			if(!(p[0] >= 0 && p[0] <= hdr->w && p[1] >= FARSH_Y && p[1] <= FARSH_Y + 2 && p[2] >= k0 && p[2] <= k1) ||
+					!isfinite(c[0]) || !isfinite(c[1]) || !isfinite(c[2]))
+			{
+				problem(lv, &n, "vertex %zu of band %zu is out of its band", v, m);
+				break;
+			}
+		}
+		first += b->count;
+	}
+	if(first != lv->vertices)
+		problem(lv, &n, "bands cover %zu of %zu vertices", first, lv->vertices);
+
+	if(n > 20)
+		fprintf(stderr, "%s: and %d more problems\n", lv->path, n - 20);
+	return n == 0;
+}
+
+void levelCourse(const struct Level *lv, struct Course *course)
+{
+	course->seed = lv->hdr->seed;
+	course->maze = 0;
+	course->w = lv->hdr->w;
+	course->d = lv->hdr->d;
+	course->spawn_x = lv->hdr->spawn_x;
+	course->spawn_z = lv->hdr->spawn_z;
+	course->tiles.clear();
+	course->obs.clear();
+	course->index.w = lv->hdr->w;
+	course->index.d = lv->hdr->d;
+	course->index.stride = lv->hdr->w + 2;
+	course->index.cells = lv->cells;
+	course->index.own.clear();
+}
+
+void levelGrid(const struct Level *lv, struct Grid *g)
+{
+	gridInit(g, lv->hdr->w, lv->hdr->d);
+	memcpy(g->bits.data(), lv->grid, g->bits.size() * sizeof(uint64_t));
+}
+
+void levelReach(const struct Level *lv, struct Bitboard *b)
+{
+	boardInit(b, lv->hdr->w, lv->hdr->d);
+	memcpy(b->bits.data(), lv->reach, b->bits.size() * sizeof(uint64_t));
+}
+
+void levelHpa(const struct Level *lv, const struct Grid *g, struct Hpa *h)
+{
+	hpaLoad(h, g, lv->hpa_nodes, lv->n_hpa_nodes, lv->hpa_edges);
+}
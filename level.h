@@ -0,0 +1,148 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "course.h"
+#include "hpa.h"
+#include "mesh.h"
+#include "path.h"
+#include "reach.h"
+
+/* Binary level files, mapped and used where they lie.
+ *
+ * A header, then sections each starting on a page boundary: the tiles, the
+ * obstacles, the moving tiles with their schedules, the collision index
+ * exactly as colBuild lays it out, the path grid, the cells reachable from
+ * the spawn, the HPA* abstraction of the grid, and the static geometry
+ * greedy meshed in bands of LEVEL_BAND rows with a table of where each
+ * band's vertices are. Everything is little-endian and in the layout the
+ * code uses, so levelOpen only checks the header and points into the
+ * mapping: nothing is parsed or copied, and pages come in as they are
+ * first read.
+ * levelCheck goes through all of it for the validator.
+ */
+#define LEVEL_MAGIC "MZLV"
+#define LEVEL_VERSION 2
+#define LEVEL_ALIGN 4096
+#define LEVEL_BAND 32
+
+enum {
+	LEVEL_TILES,      // w*d tile bytes, row k at k*w
+	LEVEL_OBSTACLES,  // struct Obstacle
+	LEVEL_MOVING,     // struct LevelMover, one per TILE_MOVING cell
+	LEVEL_COLLISION,  // (w+2)*(d+2) cell flags, see collide.h
+	LEVEL_GRID,       // path grid words, see path.h
+	LEVEL_REACH,      // bitboard words of the cells reachable from the spawn, see reach.h
+	LEVEL_HPA_NODES,  // struct HpaSavedNode, see hpa.h
+	LEVEL_HPA_EDGES,  // struct HpaEdge
+	LEVEL_BANDS,      // struct LevelBand, (d + LEVEL_BAND-1) / LEVEL_BAND of them
+	LEVEL_POS,        // three floats a vertex
+	LEVEL_COLOR,      // three floats a vertex
+	LEVEL_SECTIONS
+};
+
+struct LevelSection {
+	uint64_t offset, bytes;
+};
+
+struct LevelHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t size;     // of the whole file
+	uint32_t seed;
+	int32_t w, d;
+	int32_t spawn_x, spawn_z;
+	int32_t band;      // LEVEL_BAND when written
+	struct LevelSection sec[LEVEL_SECTIONS];
+};
+
+/* A moving tile rises and sinks between low and high, one leg every leg
+   ticks, starting phase ticks in. The simulation has one schedule for all
+   of them, movingFloorHeight's, and levelCheck rejects any other. */
+struct LevelMover {
+	int32_t x, z;
+	float low, high;
+	uint32_t leg, phase;
+};
+
+/* Rows [k, k + LEVEL_BAND) of the mesh are vertices first .. first+count-1 */
+struct LevelBand {
+	uint32_t first, count;
+};
+
+struct Level {
+	const char *path;
+	void *map;
+	size_t size;
+	const struct LevelHeader *hdr;
+	const uint8_t *tiles;
+	const struct Obstacle *obs;
+	size_t n_obs;
+	const struct LevelMover *movers;
+	size_t n_movers;
+	const uint8_t *cells;
+	const uint64_t *grid, *reach;  // d rows of (w+63)/64 words each
+	const struct HpaSavedNode *hpa_nodes;
+	size_t n_hpa_nodes;
+	const struct HpaEdge *hpa_edges;
+	size_t n_hpa_edges;
+	const struct LevelBand *bands;
+	size_t n_bands;
+	const float *pos, *color;
+	size_t vertices;
+};
+
+/* Everything baked from a course besides what it holds already. The
+   stages fill their own parts, so they can run side by side; hpa needs the
+   grid first. */
+struct LevelBake {
+	std::vector<struct LevelMover> movers;
+	std::vector<struct LevelBand> bands;
+	struct Mesh mesh;
+	struct Grid grid;
+	struct Bitboard reach;
+	std::vector<struct HpaSavedNode> hpa_nodes;
+	std::vector<struct HpaEdge> hpa_edges;
+};
+
+void bakeMovers(struct LevelBake *b, const struct Course *course);
+void bakeGrid(struct LevelBake *b, const struct Course *course);
+void bakeReach(struct LevelBake *b, const struct Course *course);
+void bakeHpa(struct LevelBake *b);
+
+/* Greedy mesh the bands, spread over 'threads' threads */
+void bakeMesh(struct LevelBake *b, const struct Course *course, int threads);
+
+/* All the stages, one after another */
+void levelBake(struct LevelBake *b, const struct Course *course);
+
+/* Write a course and what was baked from it as a level file */
+bool levelWrite(const char *path, const struct Course *course, const struct LevelBake *b);
+
+/* Map a level and check its header and section table, without reading any
+   further. Prints what is wrong and returns false if it won't do. */
+bool levelOpen(struct Level *lv, const char *path);
+
+/* Read the whole level and check it is one the game can play: tiles,
+   obstacles on floor, the moving tiles and their schedules, the collision
+   index, grid, reachable cells, HPA* nodes and the mesh bands all
+   agreeing. Prints every problem found. */
+bool levelCheck(const struct Level *lv);
+
+void levelClose(struct Level *lv);
+
+/* A course playing the level in place. Only what the simulation reads is
+   set: the size, spawn and a collision index whose cells are the mapped
+   ones. tiles and obs stay empty, read them from the level. The course is
+   good until levelClose. */
+void levelCourse(const struct Level *lv, struct Course *course);
+
+/* The baked path grid, reachable cells and HPA* abstraction. These are
+   copied out, as the types own their memory, but nothing is worked out. */
+void levelGrid(const struct Level *lv, struct Grid *g);
+void levelReach(const struct Level *lv, struct Bitboard *b);
+void levelHpa(const struct Level *lv, const struct Grid *g, struct Hpa *h);
+
+#endif
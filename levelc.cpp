@@ -0,0 +1,177 @@
+/* Level compiler: a text maze in, a level file out (see level.h).
+ *
+ *   ./levelc [-j threads] maze.txt maze.lvl
+ *
+ * The maze is a grid of characters, row 0 at the top, which is the finish:
+ *   .  floor
+ *   #  obstacle, standing on floor
+ *   M  moving tile
+ *   S  the spawn, on floor, exactly one
+ *   ~  water; so is a space, and anything past the end of a short line
+ *
+ * Everything the game would otherwise work out at load time is baked in:
+ * the collision index, the path grid, the cells reachable from the spawn,
+ * the HPA* abstraction and the greedy meshed geometry. Once the text is
+ * read the stages run side by side, the mesh split over the threads left,
+ * and each stage's time is printed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <string>
+#include <thread>
+
+#include "level.h"
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+enum { ST_PARSE, ST_INDEX, ST_MESH, ST_MOVERS, ST_GRID, ST_HPA, ST_REACH, ST_WRITE, STAGES };
+
+static const char *stage_name[STAGES] = { "parse", "index", "mesh", "movers", "grid", "hpa", "reach", "write" };
+static double stage_time[STAGES];
+
+static bool parse(const char *path, struct Course *course)
+{
+	std::vector<std::string> rows;
+	char line[1 << 16];
+	int i, k, spawns = 0;
+	size_t n;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if(!f)
+	{
+		fprintf(stderr, "Cannot open maze %s\n", path);
+		return false;
+	}
+	course->w = 0;
+	while(fgets(line, sizeof(line), f))
+	{
+		n = strcspn(line, "\r\n");
+		if(line[n] == 0 && !feof(f))
+		{
+			fprintf(stderr, "%s:%zu: line too long\n", path, rows.size() + 1);
+			fclose(f);
+			return false;
+		}
+		rows.push_back(std::string(line, n));
+		if((int)n > course->w)
+			course->w = n;
+	}
+	fclose(f);
+	while(!rows.empty() && rows.back().find_first_not_of(" ~") == std::string::npos)
+		rows.pop_back();
+	if(rows.empty() || course->w == 0)
+	{
+		fprintf(stderr, "%s: no maze in it\n", path);
+		return false;
+	}
+
+	course->seed = 0;
+	course->maze = 0;
+	course->d = rows.size();
+	course->tiles.assign((size_t)course->w * course->d, TILE_PIT);
+	course->obs.clear();
+	for(k=0; k < course->d; k++)
+		for(i=0; i < (int)rows[k].size(); i++)
+		{
+			uint8_t *t = &course->tiles[(size_t)k * course->w + i];
+			switch(rows[k][i])
+			{
+			case 'S':
+				course->spawn_x = i;
+				course->spawn_z = k;
+				spawns++;
+				/* fall through */
+			case '.':
+				*t = TILE_FLOOR;
+				break;
+			case '#':
+			{
+				struct Obstacle o = { i, k };
+				*t = TILE_FLOOR;
+				course->obs.push_back(o);
+				break;
+			}
+			case 'M':
+				*t = TILE_MOVING;
+				break;
+			case '~':
+			case ' ':
+				break;
+			default:
+				fprintf(stderr, "%s:%d:%d: '%c' is not a tile\n", path, k + 1, i + 1, rows[k][i]);
+				return false;
+			}
+		}
+	if(spawns != 1)
+	{
+		fprintf(stderr, "%s: %d spawns, there must be one\n", path, spawns);
+		return false;
+	}
+	return true;
+}
+
+/* A stage, timed */
+#define STAGE(s, call) do { double t0_ = now(); call; stage_time[s] = now() - t0_; } while(0)
+
+static void gridAndHpa(struct LevelBake *b, const struct Course *course)
+{
+	STAGE(ST_GRID, bakeGrid(b, course));
+	STAGE(ST_HPA, bakeHpa(b));
+}
+
+int main(int argc, char **argv)
+{
+	int threads = std::thread::hardware_concurrency(), a = 1, s;
+	struct Course *course = new struct Course;
+	struct LevelBake *b = new struct LevelBake;
+	std::thread grid, reach, movers;
+	double t0, sum = 0;
+
+	if(argc > 2 && !strcmp(argv[1], "-j"))
+	{
+		threads = atoi(argv[2]);
+		a = 3;
+	}
+	if(argc - a != 2 || threads < 1)
+	{
+		fprintf(stderr, "usage: %s [-j threads] maze.txt maze.lvl\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	t0 = now();
+	STAGE(ST_PARSE, if(!parse(argv[a], course)) return EXIT_FAILURE);
+
+	/* The mesh reads the collision index, the rest only the tiles */
+	grid = std::thread(gridAndHpa, b, course);
+	reach = std::thread([b, course]() { STAGE(ST_REACH, bakeReach(b, course)); });
+	movers = std::thread([b, course]() { STAGE(ST_MOVERS, bakeMovers(b, course)); });
+	STAGE(ST_INDEX, colBuild(&course->index, course));
+	STAGE(ST_MESH, bakeMesh(b, course, threads > 3 ? threads - 3 : 1));
+	grid.join();
+	reach.join();
+	movers.join();
+
+	STAGE(ST_WRITE, if(!levelWrite(argv[a + 1], course, b)) return EXIT_FAILURE);
+
+	printf("%s: %d x %d, %zu obstacles, %zu moving tiles -> %s\n", argv[a], course->w, course->d,
+			course->obs.size(), b->movers.size(), argv[a + 1]);
+	for(s=0; s < STAGES; s++)
+	{
+		printf("  %-7s %9.2f ms\n", stage_name[s], stage_time[s] * 1e3);
+		sum += stage_time[s];
+	}
+	printf("  %zu vertices in %zu bands, %zu HPA* nodes, %.2f ms of stages in %.2f ms on %d threads\n",
+			meshVertices(&b->mesh), b->bands.size(), b->hpa_nodes.size(), sum * 1e3, (now() - t0) * 1e3, threads);
+	delete b;
+	delete course;
+	return EXIT_SUCCESS;
+}
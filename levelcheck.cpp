@@ -0,0 +1,45 @@
+/* Level file validator.
+ *
+ * Maps each level given and checks all of it the way the game relies on
+ * it: header and section table, tiles, obstacles, moving tile schedules,
+ * the baked collision index against the tiles, and the mesh bands.
+ *
+ *   ./levelcheck level.lvl...
+ *
+ * Prints "name OK" with what the level holds, or every problem found.
+ * Exits non-zero if any level failed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "level.h"
+
+int main(int argc, char **argv)
+{
+	int a, failed = 0;
+
+	if(argc < 2)
+	{
+		fprintf(stderr, "usage: %s level.lvl...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	for(a=1; a < argc; a++)
+	{
+		struct Level lv;
+		if(!levelOpen(&lv, argv[a]))
+		{
+			failed++;
+			continue;
+		}
+		if(levelCheck(&lv))
+			printf("%s OK %d x %d, %zu obstacles, %zu moving tiles, %zu bands, %zu vertices, %.1f MB\n", argv[a],
+					lv.hdr->w, lv.hdr->d, lv.n_obs, lv.n_movers, lv.n_bands, lv.vertices, lv.size / 1e6);
+		else
+		{
+			printf("%s FAIL\n", argv[a]);
+			failed++;
+		}
+		levelClose(&lv);
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,26 @@
+#ifndef DEFAULT_LEVEL_H
+#define DEFAULT_LEVEL_H
+
+#include "../embed.h"
+
+/* The course the game starts on, levels/demo.txt built in */
+static constexpr char default_level_text[] = R"(
+.................
+.#.#.#.#.#.#.#.#.
+.................
+~~~..~~~~~..~~~~~
+.......M.........
+.#####...#####...
+.....#...#.......
+..M..#...#..MM...
+.....#...........
+~~~~~~...~~~~~~..
+.................
+...#.....#....#..
+.......~.........
+S................
+)";
+
+EMBED_LEVEL(default_level, default_level_text);
+
+#endif
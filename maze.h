@@ -0,0 +1,69 @@
+#ifndef MAZE_H
+#define MAZE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "course.h"
+
+/* A perfect maze of w x h cells: exactly one route between any two cells.
+ * Every cell keeps two bits, whether the passage to its east and to its
+ * south is open, 32 cells to a 64 bit word. West and north are the east and
+ * south bits of the neighbour, and the outer wall is always closed, so a
+ * 10k x 10k maze is 25 MB.
+ */
+enum { MAZE_E, MAZE_S, MAZE_W, MAZE_N };  // direction d, opposite is d ^ 2
+
+struct Maze {
+	int w, h;
+	std::vector<uint64_t> bits;
+};
+
+/* Generators. They differ in texture and in what they need besides the maze:
+ *   Kruskal     random edge order a band of rows at a time, union-find
+ *               over cells, 5 bytes per cell
+ *   backtrack   depth first with an explicit stack, 3 bits per cell
+ *   Wilson      loop-erased random walks, uniform over all mazes, 3 bits
+ *               per cell but slow to start on big grids
+ *   Eller       one row at a time, scratch memory grows with w only
+ */
+enum {
+	MAZE_KRUSKAL,
+	MAZE_BACKTRACK,
+	MAZE_WILSON,
+	MAZE_ELLER,
+	MAZE_ALGOS
+};
+
+const char *mazeAlgoName(int algo);
+
+/* Carve a new maze. w and h must be at least 1 and w*h below 2^31.
+   Returns the bytes of scratch memory the generator needed on top of the
+   maze itself. */
+size_t generateMaze(struct Maze *m, int w, int h, uint32_t seed, int algo);
+
+static inline bool mazeOpen(const struct Maze *m, int x, int y, int d)
+{
+	size_t n;
+
+	if(d == MAZE_W)
+		x--, d = MAZE_E;
+	else if(d == MAZE_N)
+		y--, d = MAZE_S;
+	if(x < 0 || y < 0 || x >= m->w || y >= m->h)
+		return false;
+	n = (size_t)y * m->w + x;
+	return (m->bits[n >> 5] >> ((n & 31) * 2 + d)) & 1;
+}
+
+/* Lay a maze out as a course of (2w-1) x (2h-1) tiles: maze cell (x, y) is
+   course cell (2x, 2y), closed walls and the posts between them are
+   obstacles. Row 0 of the maze is the finish, the spawn is its bottom left. */
+void mazeToCourse(const struct Maze *m, struct Course *course);
+
+/* Seeded maze course for the game and replays. w and d are course sizes
+   and must be odd; the maze has (w+1)/2 x (d+1)/2 cells. */
+void generateMazeCourse(struct Course *course, uint32_t seed, int w, int d);
+
+#endif
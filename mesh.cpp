@@ -0,0 +1,157 @@
+#include <string.h>
+
+#include "mesh.h"
+
+/* Cube faces, two triangles each, in the game's vertex order */
+enum { FACE_BACK, FACE_LEFT, FACE_FRONT, FACE_RIGHT, FACE_TOP, FACES };
+
+static const float corners[FACES][6][3] = {
+	{ {0,0,0}, {1,0,0}, {1,1,0}, {1,1,0}, {0,1,0}, {0,0,0} },  // z = 0
+	{ {0,0,0}, {0,1,0}, {0,1,1}, {0,1,1}, {0,0,1}, {0,0,0} },  // x = 0
+	{ {0,0,1}, {0,1,1}, {1,1,1}, {1,1,1}, {1,0,1}, {0,0,1} },  // z = 1
+	{ {1,0,1}, {1,1,1}, {1,1,0}, {1,1,0}, {1,0,0}, {1,0,1} },  // x = 1
+	{ {0,1,0}, {0,1,1}, {1,1,1}, {1,1,1}, {1,1,0}, {0,1,0} },  // y = 1
+};
+
+/* Neighbour across each side face */
+static const int side[4][2] = { { 0, -1 }, { -1, 0 }, { 0, 1 }, { 1, 0 } };
+
+static const float floorSide[3] = { 0.6f, 0.2f, 0 };
+static const float floorTop[6][3] = { {0,0.5f,0}, {0.5f,0.5f,0}, {0,0.5f,0}, {0,0.5f,0}, {0.5f,0.5f,0}, {0,0.5f,0} };
+static const float obsFace[FACES][3] = { {0.2f,0.06f,0}, {0.3f,0.09f,0}, {0.2f,0.06f,0}, {0.3f,0.09f,0}, {0.4f,0.12f,0} };
+
+/* Face f of a box sx wide and sz deep with its corner at (x, y, z) */
+static void quad(struct Mesh *m, int f, float x, float y, float z, float sx, float sz, const float (*color)[3], bool per_vertex)
+{
+	int v;
+
+	for(v=0; v < 6; v++)
+	{
+		const float *c = per_vertex ? color[v] : color[0];
+		m->pos.push_back(x + corners[f][v][0] * sx);
+		m->pos.push_back(y + corners[f][v][1]);
+		m->pos.push_back(z + corners[f][v][2] * sz);
+		m->color.push_back(c[0]);
+		m->color.push_back(c[1]);
+		m->color.push_back(c[2]);
+	}
+}
+
+static void face(struct Mesh *m, int f, float x, float y, float z, const float (*color)[3], bool per_vertex)
+{
+	quad(m, f, x, y, z, 1, 1, color, per_vertex);
+}
+
+void meshCourse(struct Mesh *m, const struct Course *course, int k0, int k1)
+{
+	int i, k, f;
+	size_t n;
+
+	m->pos.clear();
+	m->color.clear();
+	for(k=k0; k < k1; k++)
+		for(i=0; i < course->w; i++)
+		{
+			if(courseTile(course, i, k) != TILE_FLOOR)
+				continue;
+			for(f=0; f < 4; f++)
+				if(courseTile(course, i + side[f][0], k + side[f][1]) != TILE_FLOOR)
+					face(m, f, i, FARSH_Y, k, &floorSide, false);
+			face(m, FACE_TOP, i, FARSH_Y, k, floorTop, true);
+		}
+	for(n=0; n < course->obs.size(); n++)
+	{
+		const struct Obstacle *o = &course->obs[n];
+		if(o->z < k0 || o->z >= k1)
+			continue;
+		for(f=0; f < FACES; f++)
+			face(m, f, o->x, FARSH_Y + 1, o->z, &obsFace[f], false);
+	}
+}
+
+/* Whether cell (i, k) holds the kind of cube being meshed, COL_FLOOR or
+   COL_OBSTACLE */
+static inline bool solid(const struct Course *course, int i, int k, unsigned kind)
+{
+	return colCell(&course->index, i, k) & kind;
+}
+
+/* One kind of cube, its faces merged, at height y, over cells [i0, i1) x
+   [k0, k1) */
+static void greedy(struct Mesh *m, const struct Course *course, int i0, int k0, int i1, int k1, unsigned kind, float y,
+		std::vector<uint8_t> *used)
+{
+	int w = i1 - i0, i, k, f, n, h, j;
+
+	/* Tops: widest run first, then as many rows down as it fits */
+	used->assign((size_t)w * (k1 - k0), 0);
+	for(k=k0; k < k1; k++)
+		for(i=i0; i < i1; i++)
+		{
+			if((*used)[(size_t)(k - k0) * w + i - i0] || !solid(course, i, k, kind))
+				continue;
+			for(n=1; i + n < i1 && !(*used)[(size_t)(k - k0) * w + i - i0 + n] && solid(course, i + n, k, kind); n++)
+				;
+			for(h=1; k + h < k1; h++)
+			{
+				for(j=0; j < n; j++)
+					if((*used)[(size_t)(k + h - k0) * w + i - i0 + j] || !solid(course, i + j, k + h, kind))
+						break;
+				if(j < n)
+					break;
+			}
+			for(j=0; j < h; j++)
+				memset(&(*used)[(size_t)(k + j - k0) * w + i - i0], 1, n);
+			if(kind == COL_OBSTACLE)
+				quad(m, FACE_TOP, i, y, k, n, h, &obsFace[FACE_TOP], false);
+			else
+				quad(m, FACE_TOP, i, y, k, n, h, floorTop, true);
+		}
+
+	/* Sides: runs of cells whose neighbour across the face is open */
+	for(f=0; f < 4; f++)
+	{
+		const float (*color)[3] = kind == COL_OBSTACLE ? &obsFace[f] : &floorSide;
+		if(side[f][0] == 0)
+		{
+			for(k=k0; k < k1; k++)
+				for(i=i0; i < i1; i += n)
+				{
+					for(n=0; i + n < i1 && solid(course, i + n, k, kind) && !solid(course, i + n, k + side[f][1], kind); n++)
+						;
+					if(n)
+						quad(m, f, i, y, k, n, 1, color, false);
+					else
+						n = 1;
+				}
+		}
+		else
+		{
+			for(i=i0; i < i1; i++)
+				for(k=k0; k < k1; k += n)
+				{
+					for(n=0; k + n < k1 && solid(course, i, k + n, kind) && !solid(course, i + side[f][0], k + n, kind); n++)
+						;
+					if(n)
+						quad(m, f, i, y, k, 1, n, color, false);
+					else
+						n = 1;
+				}
+		}
+	}
+}
+
+void meshCourseGreedy(struct Mesh *m, const struct Course *course, int k0, int k1)
+{
+	meshRegionGreedy(m, course, 0, k0, course->w, k1);
+}
+
+void meshRegionGreedy(struct Mesh *m, const struct Course *course, int i0, int k0, int i1, int k1)
+{
+	std::vector<uint8_t> used;
+
+	m->pos.clear();
+	m->color.clear();
+	greedy(m, course, i0, k0, i1, k1, COL_FLOOR, FARSH_Y, &used);
+	greedy(m, course, i0, k0, i1, k1, COL_OBSTACLE, FARSH_Y + 1, &used);
+}
@@ -0,0 +1,48 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "course.h"
+
+/* Course geometry baked into triangle lists on the CPU, ready to be put in
+ * a vertex buffer in one go: three floats of position and three of colour
+ * per vertex, the layout create3DObject takes. Floor cells are the game's
+ * floor cubes and obstacles its obstacle cubes, in the same colours.
+ */
+struct Mesh {
+	std::vector<float> pos;
+	std::vector<float> color;
+};
+
+static inline size_t meshVertices(const struct Mesh *m)
+{
+	return m->pos.size() / 3;
+}
+
+/* Bytes the mesh takes in a vertex buffer */
+static inline size_t meshBytes(const struct Mesh *m)
+{
+	return (m->pos.size() + m->color.size()) * sizeof(float);
+}
+
+/* Replace m with the static geometry of rows [k0, k1) of a course: floor
+   cells and obstacles. Moving tiles are left out, they are drawn at their
+   height every frame. Faces that can't be seen, floor against floor and
+   the bottoms, are not emitted. */
+void meshCourse(struct Mesh *m, const struct Course *course, int k0, int k1);
+
+/* The same geometry greedy meshed: each face direction's visible faces
+   merged into as few rectangles as it takes, floor tops and obstacle tops
+   in two dimensions and the sides along their runs. Faces between
+   neighbouring obstacles are left out too. Far fewer vertices for open
+   floor and long walls, for baking levels ahead of time. Reads the
+   course's collision index. */
+void meshCourseGreedy(struct Mesh *m, const struct Course *course, int k0, int k1);
+
+/* Greedy mesh the cells [i0, i1) x [k0, k1) only, for patching part of a
+   course. Faces on the region's edge still look at the cells outside it. */
+void meshRegionGreedy(struct Mesh *m, const struct Course *course, int i0, int k0, int i1, int k1);
+
+#endif
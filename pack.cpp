@@ -0,0 +1,419 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pack.h"
+
+#define FNV_SEED 0x811c9dc5u
+#define FNV_PRIME 0x01000193u
+
+/* Bits out, least significant first, to the sink a block at a time */
+struct PackWriter {
+	PackSink sink;
+	void *ctx;
+	uint64_t bits;
+	int nbits;
+	uint32_t check;
+	size_t bytes;
+	size_t n;
+	bool ok;
+	uint8_t buf[PACK_BLOCK];
+};
+
+static void writeByte(struct PackWriter *w, uint8_t b)
+{
+	w->check = (w->check ^ b) * FNV_PRIME;
+	w->buf[w->n++] = b;
+	if(w->n == PACK_BLOCK)
+	{
+		w->ok = w->ok && w->sink(w->ctx, w->buf, w->n);
+		w->bytes += w->n;
+		w->n = 0;
+	}
+}
+
+/* v must fit in n bits, n at most 32 */
+static inline void putBits(struct PackWriter *w, uint32_t v, int n)
+{
+	w->bits |= (uint64_t)v << w->nbits;
+	w->nbits += n;
+	while(w->nbits >= 8)
+	{
+		writeByte(w, w->bits & 0xff);
+		w->bits >>= 8;
+		w->nbits -= 8;
+	}
+}
+
+static void putAlign(struct PackWriter *w)
+{
+	if(w->nbits)
+		putBits(w, 0, 8 - w->nbits);
+}
+
+static void putVarint(struct PackWriter *w, uint32_t v)
+{
+	while(v >= 0x80)
+	{
+		putBits(w, (v & 0x7f) | 0x80, 8);
+		v >>= 7;
+	}
+	putBits(w, v, 8);
+}
+
+/* A number 3 bits at a time, low first, each followed by a bit set if
+   more follow */
+static void putGroups(struct PackWriter *w, uint32_t v)
+{
+	while(v >= 8)
+	{
+		putBits(w, (v & 7) | 8, 4);
+		v >>= 3;
+	}
+	putBits(w, v, 4);
+}
+
+/* r cells of tile t: a run token if it saves anything, else one by one */
+static void putRun(struct PackWriter *w, int t, uint32_t r)
+{
+	if(r < PACK_RUN_MIN)
+	{
+		while(r--)
+			putBits(w, t, 2);
+		return;
+	}
+	putBits(w, PACK_RUN | t << 2, 4);
+	putGroups(w, r - PACK_RUN_MIN);
+}
+
+static inline int cellTile(unsigned flags)
+{
+	return flags & COL_FLOOR ? TILE_FLOOR : flags & COL_MOVING ? TILE_MOVING : TILE_PIT;
+}
+
+size_t packWrite(const struct Course *course, PackSink sink, void *ctx)
+{
+	const struct CollisionIndex *ci = &course->index;
+	struct PackWriter *w = new struct PackWriter;
+	const uint8_t *row;
+	uint32_t r = 0, gap = 0, check;
+	int i, k, t = TILE_PIT;
+	size_t bytes;
+
+	w->sink = sink;
+	w->ctx = ctx;
+	w->bits = 0;
+	w->nbits = 0;
+	w->check = FNV_SEED;
+	w->bytes = 0;
+	w->n = 0;
+	w->ok = true;
+
+	for(i=0; i < 4; i++)
+		putBits(w, PACK_MAGIC[i], 8);
+	putVarint(w, PACK_VERSION);
+	putVarint(w, course->w);
+	putVarint(w, course->d);
+	putVarint(w, course->spawn_x);
+	putVarint(w, course->spawn_z);
+	putVarint(w, course->seed);
+	putVarint(w, course->maze);
+
+	for(k=0; k < ci->d; k++)
+	{
+		row = ci->cells + (size_t)(k + 1) * ci->stride + 1;
+		for(i=0; i < ci->w; i++)
+		{
+			int c = cellTile(row[i]);
+			if(c == t)
+				r++;
+			else
+			{
+				putRun(w, t, r);
+				t = c;
+				r = 1;
+			}
+		}
+	}
+	putRun(w, t, r);
+
+	for(k=0; k < ci->d; k++)
+	{
+		row = ci->cells + (size_t)(k + 1) * ci->stride + 1;
+		for(i=0; i < ci->w; i++)
+		{
+			if(row[i] & COL_OBSTACLE)
+			{
+				putGroups(w, gap + 1);
+				gap = 0;
+			}
+			else
+				gap++;
+		}
+	}
+	putGroups(w, 0);
+	putAlign(w);
+
+	check = w->check;
+	for(i=0; i < 4; i++)
+		putBits(w, check >> (8 * i) & 0xff, 8);
+	if(w->n)
+	{
+		w->ok = w->ok && w->sink(w->ctx, w->buf, w->n);
+		w->bytes += w->n;
+	}
+	bytes = w->ok ? w->bytes : 0;
+	delete w;
+	return bytes;
+}
+
+/* Bits in, a byte at a time as they are asked for, so after a read fewer
+   than 8 are left over and aligning is dropping them */
+struct PackReader {
+	PackSource src;
+	void *ctx;
+	uint64_t bits;
+	int nbits;
+	uint32_t check;
+	size_t pos, n;
+	bool ok;
+	uint8_t buf[PACK_BLOCK];
+};
+
+static inline uint8_t readByte(struct PackReader *rd)
+{
+	uint8_t b;
+
+	if(rd->pos == rd->n)
+	{
+		rd->pos = 0;
+		rd->n = rd->ok ? rd->src(rd->ctx, rd->buf, PACK_BLOCK) : 0;
+		if(rd->n == 0)
+		{
+			rd->ok = false;
+			return 0;
+		}
+	}
+	b = rd->buf[rd->pos++];
+	rd->check = (rd->check ^ b) * FNV_PRIME;
+	return b;
+}
+
+static inline uint32_t getBits(struct PackReader *rd, int n)
+{
+	uint32_t v;
+
+	while(rd->nbits < n)
+	{
+		rd->bits |= (uint64_t)readByte(rd) << rd->nbits;
+		rd->nbits += 8;
+	}
+	v = rd->bits & ((1ull << n) - 1);
+	rd->bits >>= n;
+	rd->nbits -= n;
+	return v;
+}
+
+static uint32_t getVarint(struct PackReader *rd)
+{
+	uint32_t v = 0, b;
+	int shift = 0;
+
+	do
+	{
+		b = getBits(rd, 8);
+		if(shift < 32)
+			v |= (b & 0x7f) << shift;
+		shift += 7;
+	} while(b & 0x80 && rd->ok);
+	return v;
+}
+
+/* putGroups' number, or more than PACK_MAX_CELLS if it runs on too long */
+static uint32_t getGroups(struct PackReader *rd)
+{
+	uint32_t v = 0, g;
+	int shift = 0;
+
+	do
+	{
+		g = getBits(rd, 4);
+		v |= (g & 7) << shift;
+		shift += 3;
+	} while(g & 8 && shift < 30);
+	return g & 8 ? PACK_MAX_CELLS + 1 : v;
+}
+
+static bool unpack(struct Course *course, struct PackReader *rd)
+{
+	uint32_t version, r, gap, check;
+	size_t cells, p;
+	uint8_t *tiles;
+	int i, t;
+
+	for(i=0; i < 4; i++)
+		if(getBits(rd, 8) != (uint8_t)PACK_MAGIC[i])
+		{
+			fprintf(stderr, "Not a packed course\n");
+			return false;
+		}
+	version = getVarint(rd);
+	if(version != PACK_VERSION)
+	{
+		fprintf(stderr, "Packed course version %u, expected %d\n", version, PACK_VERSION);
+		return false;
+	}
+	course->w = getVarint(rd);
+	course->d = getVarint(rd);
+	course->spawn_x = getVarint(rd);
+	course->spawn_z = getVarint(rd);
+	course->seed = getVarint(rd);
+	course->maze = getVarint(rd);
+	if(!rd->ok)
+		goto truncated;
+	if(course->w < 1 || course->d < 1 || course->w > PACK_MAX_SIDE || course->d > PACK_MAX_SIDE ||
+			(size_t)course->w * course->d > PACK_MAX_CELLS)
+	{
+		fprintf(stderr, "Packed course is %d x %d\n", course->w, course->d);
+		return false;
+	}
+	if(course->spawn_x < 0 || course->spawn_z < 0 || course->spawn_x >= course->w || course->spawn_z >= course->d)
+	{
+		fprintf(stderr, "Packed course spawns off the course, at (%d, %d)\n", course->spawn_x, course->spawn_z);
+		return false;
+	}
+
+	cells = (size_t)course->w * course->d;
+	course->tiles.resize(cells);
+	tiles = course->tiles.data();
+	for(p=0; p < cells && rd->ok; )
+	{
+		t = getBits(rd, 2);
+		if(t != PACK_RUN)
+		{
+			tiles[p++] = t;
+			continue;
+		}
+		t = getBits(rd, 2);
+		r = getGroups(rd);
+		if(t == PACK_RUN || (size_t)r + PACK_RUN_MIN > cells - p)
+		{
+			fprintf(stderr, "Packed course has a bad run at cell %zu\n", p);
+			return false;
+		}
+		memset(tiles + p, t, r + PACK_RUN_MIN);
+		p += r + PACK_RUN_MIN;
+	}
+	if(!rd->ok)
+		goto truncated;
+	if(tiles[(size_t)course->spawn_z * course->w + course->spawn_x] != TILE_FLOOR)
+	{
+		fprintf(stderr, "Packed course spawns off the floor\n");
+		return false;
+	}
+
+	course->obs.clear();
+	for(p = (size_t)-1; (gap = getGroups(rd)) != 0 && rd->ok; )
+	{
+		struct Obstacle o;
+		if(gap > cells - 1 - p)
+		{
+			fprintf(stderr, "Packed course has an obstacle past the end\n");
+			return false;
+		}
+		p += gap;
+		o.x = p % course->w;
+		o.z = p / course->w;
+		if(tiles[p] != TILE_FLOOR || (o.x == course->spawn_x && o.z == course->spawn_z))
+		{
+			fprintf(stderr, "Packed course has an obstacle at (%d, %d) that is not on plain floor\n", o.x, o.z);
+			return false;
+		}
+		course->obs.push_back(o);
+	}
+	rd->bits = 0;
+	rd->nbits = 0;
+	if(!rd->ok)
+		goto truncated;
+
+	check = rd->check;
+	r = 0;
+	for(i=0; i < 4; i++)
+		r |= getBits(rd, 8) << (8 * i);
+	if(!rd->ok)
+		goto truncated;
+	if(r != check)
+	{
+		fprintf(stderr, "Packed course fails its check\n");
+		return false;
+	}
+	colBuild(&course->index, course);
+	return true;
+
+truncated:
+	fprintf(stderr, "Packed course is cut short\n");
+	return false;
+}
+
+bool packRead(struct Course *course, PackSource src, void *ctx)
+{
+	struct PackReader *rd = new struct PackReader;
+	bool ok;
+
+	rd->src = src;
+	rd->ctx = ctx;
+	rd->bits = 0;
+	rd->nbits = 0;
+	rd->check = FNV_SEED;
+	rd->pos = 0;
+	rd->n = 0;
+	rd->ok = true;
+	ok = unpack(course, rd);
+	delete rd;
+	return ok;
+}
+
+static bool fileSink(void *ctx, const uint8_t *p, size_t n)
+{
+	return fwrite(p, 1, n, (FILE *)ctx) == n;
+}
+
+static size_t fileSource(void *ctx, uint8_t *p, size_t n)
+{
+	return fread(p, 1, n, (FILE *)ctx);
+}
+
+bool packSave(const char *path, const struct Course *course)
+{
+	FILE *f = fopen(path, "wb");
+	bool ok;
+
+	if(!f)
+	{
+		fprintf(stderr, "Cannot write course %s\n", path);
+		return false;
+	}
+	ok = packWrite(course, fileSink, f) != 0;
+	if(fclose(f) != 0 || !ok)
+	{
+		fprintf(stderr, "Error writing course %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+bool packLoad(const char *path, struct Course *course)
+{
+	FILE *f = fopen(path, "rb");
+	bool ok;
+
+	if(!f)
+	{
+		fprintf(stderr, "Cannot open course %s\n", path);
+		return false;
+	}
+	ok = packRead(course, fileSource, f);
+	fclose(f);
+	if(!ok)
+		fprintf(stderr, "in %s\n", path);
+	return ok;
+}
@@ -0,0 +1,65 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "course.h"
+
+/* Packed courses, small enough to save and to send between kiosks.
+ *
+ *   "MZPK"            magic
+ *   varint version    PACK_VERSION
+ *   varint w, d, spawn_x, spawn_z, seed, maze
+ *   then bit packed, least significant bit first:
+ *   tiles             row major, each token
+ *                       2 bits  a tile, TILE_PIT, TILE_FLOOR or TILE_MOVING
+ *                       2 bits  PACK_RUN, then 2 bits a tile and a group
+ *                               varint of the run length less PACK_RUN_MIN
+ *   obstacles         row major, a group varint each of one more than the
+ *                     cells between it and the one before; a 0 ends them
+ *                     zero bits up to a whole byte
+ *   u32 check         FNV-1a of every byte before it, little endian
+ *
+ * Runs carry on from one row to the next. Varints are 7 bits a byte, low
+ * first, the top bit set if more follow; group varints are the same 3 bits
+ * at a time, each group 4 bits. A maze's obstacles are a cell or two apart,
+ * so most take one group.
+ *
+ * Both ends stream: packWrite reads the course's collision index cell by
+ * cell and hands the bytes to a sink in small blocks, packRead pulls them
+ * from a source and writes straight into the course. Nothing in between is
+ * held whole. Obstacles come back in row major order, one per cell; the
+ * list a generator made may have them in any order and twice over, which
+ * the index, and so the game, never sees.
+ */
+#define PACK_MAGIC "MZPK"
+#define PACK_VERSION 1
+#define PACK_RUN 3
+#define PACK_RUN_MIN 4
+#define PACK_BLOCK 4096    // bytes handed to a sink or asked of a source at a time
+#define PACK_MAX_SIDE 65536
+#define PACK_MAX_CELLS (1u << 30)
+
+/* Take n bytes; false stops the packing */
+typedef bool (*PackSink)(void *ctx, const uint8_t *p, size_t n);
+
+/* Fill up to n bytes, returning how many; 0 is the end */
+typedef size_t (*PackSource)(void *ctx, uint8_t *p, size_t n);
+
+/* Pack a course from its size, spawn, seed and collision index, so a
+   course playing a mapped level packs too. Returns the bytes written, 0 if
+   the sink gave up. */
+size_t packWrite(const struct Course *course, PackSink sink, void *ctx);
+
+/* Unpack a course and index it. Checks it is one the game can play, as
+   levelCheck does: the spawn and every obstacle on floor, no obstacle on
+   the spawn. Prints what is wrong and returns false if it isn't, or if the
+   bytes run out or fail the check. */
+bool packRead(struct Course *course, PackSource src, void *ctx);
+
+/* The same, to and from a file */
+bool packSave(const char *path, const struct Course *course);
+bool packLoad(const char *path, struct Course *course);
+
+#endif
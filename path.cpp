@@ -0,0 +1,319 @@
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "path.h"
+
+static const int dx8[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+static const int dz8[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+
+void gridInit(struct Grid *g, int w, int d)
+{
+	g->w = w;
+	g->d = d;
+	g->stride = (w + 63) / 64;
+	g->bits.assign((size_t)g->stride * d, 0);
+}
+
+void gridFromCourse(struct Grid *g, const struct Course *course)
+{
+	int i, k;
+	size_t n;
+
+	gridInit(g, course->w, course->d);
+	for(k=0; k < course->d; k++)
+		for(i=0; i < course->w; i++)
+			if(courseTile(course, i, k) == TILE_PIT)
+				gridBlock(g, i, k);
+	for(n=0; n < course->obs.size(); n++)
+		gridBlock(g, course->obs[n].x, course->obs[n].z);
+}
+
+static inline bool canStep(const struct Grid *g, int x, int z, int dx, int dz)
+{
+	if(!gridFree(g, x + dx, z + dz))
+		return false;
+	return !(dx && dz) || (gridFree(g, x + dx, z) && gridFree(g, x, z + dz));
+}
+
+void pathInit(struct PathFinder *pf, size_t cells)
+{
+	pf->dir_w = pf->dir_d = 0;
+	pf->dir_gen.clear();
+	pf->dir_page.clear();
+	pf->pool.resize((cells + PATH_PAGE * PATH_PAGE - 1) / (PATH_PAGE * PATH_PAGE) * PATH_PAGE * PATH_PAGE);
+	pf->pool_used = 0;
+	pf->open.reserve(cells);
+	pf->gen = 0;
+	pf->expanded = 0;
+	pf->grows = 0;
+}
+
+/* Start a query on g: a fresh gen, and a directory that fits the grid */
+static void pathBegin(struct PathFinder *pf, const struct Grid *g)
+{
+	int dw = (g->w + PATH_PAGE - 1) >> PATH_PAGE_BITS, dd = (g->d + PATH_PAGE - 1) >> PATH_PAGE_BITS;
+
+	if(dw != pf->dir_w || dd != pf->dir_d)
+	{
+		if((size_t)dw * dd > pf->dir_gen.capacity())
+			pf->grows++;
+		pf->dir_w = dw;
+		pf->dir_d = dd;
+		pf->dir_gen.assign((size_t)dw * dd, 0);
+		pf->dir_page.resize((size_t)dw * dd);
+		pf->gen = 0;
+	}
+	if(++pf->gen == 0)
+	{
+		pf->dir_gen.assign(pf->dir_gen.size(), 0);
+		pf->gen = 1;
+	}
+	pf->pool_used = 0;
+	pf->open.clear();
+	pf->expanded = 0;
+}
+
+/* Search state for (x, z). Pointers stay good until the next call. */
+static struct PathNode *nodeAt(struct PathFinder *pf, int x, int z)
+{
+	size_t p = (size_t)(z >> PATH_PAGE_BITS) * pf->dir_w + (x >> PATH_PAGE_BITS);
+	size_t i;
+
+	if(pf->dir_gen[p] != pf->gen)
+	{
+		if(pf->pool_used == pf->pool.size())
+		{
+			pf->pool.resize(pf->pool.size() + PATH_PAGE * PATH_PAGE);
+			pf->grows++;
+		}
+		pf->dir_gen[p] = pf->gen;
+		pf->dir_page[p] = pf->pool_used;
+		for(i=0; i < PATH_PAGE * PATH_PAGE; i++)
+		{
+			pf->pool[pf->pool_used + i].g = UINT32_MAX;
+			pf->pool[pf->pool_used + i].closed = 0;
+		}
+		pf->pool_used += PATH_PAGE * PATH_PAGE;
+	}
+	return &pf->pool[pf->dir_page[p] + ((z & (PATH_PAGE - 1)) << PATH_PAGE_BITS) + (x & (PATH_PAGE - 1))];
+}
+
+static bool openLess(const struct PathOpen &a, const struct PathOpen &b)
+{
+	return a.key > b.key;  // std heaps are max heaps, this makes a min heap
+}
+
+static void pushOpen(struct PathFinder *pf, uint32_t cell, uint32_t g, uint32_t h)
+{
+	struct PathOpen o;
+
+	if(pf->open.size() == pf->open.capacity())
+		pf->grows++;
+	o.key = (uint64_t)(g + h) << 32 | (UINT32_MAX - g);
+	o.cell = cell;
+	pf->open.push_back(o);
+	std::push_heap(pf->open.begin(), pf->open.end(), openLess);
+}
+
+/* Relax the edge from 'parent', reached at cost gp, to (x, z) */
+static void relax(struct PathFinder *pf, const struct Grid *g, uint32_t parent, uint32_t gp, int x, int z, struct PathPoint to)
+{
+	struct PathNode *n = nodeAt(pf, x, z);
+
+	if(n->closed || gp >= n->g)
+		return;
+	n->g = gp;
+	n->parent = parent;
+	pushOpen(pf, (uint32_t)z * g->w + x, gp, octile(x, z, to.x, to.z));
+}
+
+/* Jump from (x, z), reached by stepping (dx, dz), until a cell that has to
+   be expanded: the goal, or one with a forced neighbour. Without corner
+   cutting only straight moves have forced neighbours; a diagonal stops
+   where either of its straight jumps finds something. */
+static bool jump(const struct Grid *g, int x, int z, int dx, int dz, struct PathPoint to, int *ox, int *oz)
+{
+	int jx, jz;
+
+	for(;;)
+	{
+		if(!gridFree(g, x, z))
+			return false;
+		if(x == to.x && z == to.z)
+			break;
+		if(dx && dz)
+		{
+			if(jump(g, x + dx, z, dx, 0, to, &jx, &jz) || jump(g, x, z + dz, 0, dz, to, &jx, &jz))
+				break;
+			if(!gridFree(g, x + dx, z) || !gridFree(g, x, z + dz))
+				return false;
+		}
+		else if(dx)
+		{
+			if((gridFree(g, x, z - 1) && !gridFree(g, x - dx, z - 1)) ||
+					(gridFree(g, x, z + 1) && !gridFree(g, x - dx, z + 1)))
+				break;
+		}
+		else
+		{
+			if((gridFree(g, x - 1, z) && !gridFree(g, x - 1, z - dz)) ||
+					(gridFree(g, x + 1, z) && !gridFree(g, x + 1, z - dz)))
+				break;
+		}
+		x += dx;
+		z += dz;
+	}
+	*ox = x;
+	*oz = z;
+	return true;
+}
+
+/* Directions worth searching from a node entered by stepping (dx, dz).
+   The start, with no direction, gets all 8. */
+static int pruned(const struct Grid *g, int x, int z, int dx, int dz, int dirs[8][2])
+{
+	int n = 0, j;
+
+	if(!dx && !dz)
+	{
+		for(j=0; j < 8; j++)
+			if(canStep(g, x, z, dx8[j], dz8[j]))
+			{
+				dirs[n][0] = dx8[j];
+				dirs[n++][1] = dz8[j];
+			}
+		return n;
+	}
+	if(dx && dz)
+	{
+		bool sx = gridFree(g, x + dx, z), sz = gridFree(g, x, z + dz);
+		if(sz)
+			dirs[n][0] = 0, dirs[n++][1] = dz;
+		if(sx)
+			dirs[n][0] = dx, dirs[n++][1] = 0;
+		if(sx && sz)
+			dirs[n][0] = dx, dirs[n++][1] = dz;
+	}
+	else if(dx)
+	{
+		bool ahead = gridFree(g, x + dx, z), lo = gridFree(g, x, z - 1), hi = gridFree(g, x, z + 1);
+		if(ahead)
+		{
+			dirs[n][0] = dx, dirs[n++][1] = 0;
+			if(lo)
+				dirs[n][0] = dx, dirs[n++][1] = -1;
+			if(hi)
+				dirs[n][0] = dx, dirs[n++][1] = 1;
+		}
+		if(lo)
+			dirs[n][0] = 0, dirs[n++][1] = -1;
+		if(hi)
+			dirs[n][0] = 0, dirs[n++][1] = 1;
+	}
+	else
+	{
+		bool ahead = gridFree(g, x, z + dz), lo = gridFree(g, x - 1, z), hi = gridFree(g, x + 1, z);
+		if(ahead)
+		{
+			dirs[n][0] = 0, dirs[n++][1] = dz;
+			if(lo)
+				dirs[n][0] = -1, dirs[n++][1] = dz;
+			if(hi)
+				dirs[n][0] = 1, dirs[n++][1] = dz;
+		}
+		if(lo)
+			dirs[n][0] = -1, dirs[n++][1] = 0;
+		if(hi)
+			dirs[n][0] = 1, dirs[n++][1] = 0;
+	}
+	return n;
+}
+
+static inline int sign(int v)
+{
+	return (v > 0) - (v < 0);
+}
+
+/* Walk the parents back from the goal. Jump point paths are straight or
+   diagonal between nodes, so the cells in between are filled in. */
+static void buildPath(struct PathFinder *pf, const struct Grid *g, struct PathPoint to, std::vector<struct PathPoint> *path)
+{
+	struct PathPoint p = to;
+	uint32_t cell = (uint32_t)p.z * g->w + p.x, from;
+
+	path->clear();
+	path->push_back(p);
+	while((from = nodeAt(pf, p.x, p.z)->parent) != cell)
+	{
+		int px = from % g->w, pz = from / g->w;
+		int sx = sign(px - p.x), sz = sign(pz - p.z);
+		while(p.x != px || p.z != pz)
+		{
+			if(p.x != px)
+				p.x += sx;
+			if(p.z != pz)
+				p.z += sz;
+			path->push_back(p);
+		}
+		cell = from;
+	}
+	std::reverse(path->begin(), path->end());
+}
+
+long findPath(struct PathFinder *pf, const struct Grid *g, struct PathPoint from, struct PathPoint to,
+		int algo, std::vector<struct PathPoint> *path)
+{
+	struct PathNode *n;
+	int j;
+
+	if(path)
+		path->clear();
+	if(!gridFree(g, from.x, from.z) || !gridFree(g, to.x, to.z))
+		return -1;
+	pathBegin(pf, g);
+
+	n = nodeAt(pf, from.x, from.z);
+	n->g = 0;
+	n->parent = (uint32_t)from.z * g->w + from.x;
+	pushOpen(pf, n->parent, 0, octile(from.x, from.z, to.x, to.z));
+
+	while(!pf->open.empty())
+	{
+		uint32_t cell = pf->open.front().cell, gn, parent;
+		int x = cell % g->w, z = cell / g->w;
+
+		std::pop_heap(pf->open.begin(), pf->open.end(), openLess);
+		pf->open.pop_back();
+		n = nodeAt(pf, x, z);
+		if(n->closed)
+			continue;
+		n->closed = 1;
+		gn = n->g;
+		parent = n->parent;
+		pf->expanded++;
+		if(x == to.x && z == to.z)
+		{
+			if(path)
+				buildPath(pf, g, to, path);
+			return gn;
+		}
+
+		if(algo == PATH_JPS)
+		{
+			int dirs[8][2], cnt, jx, jz;
+
+			cnt = pruned(g, x, z, sign(x - (int)(parent % g->w)), sign(z - (int)(parent / g->w)), dirs);
+			for(j=0; j < cnt; j++)
+				if(jump(g, x + dirs[j][0], z + dirs[j][1], dirs[j][0], dirs[j][1], to, &jx, &jz))
+					relax(pf, g, cell, gn + octile(x, z, jx, jz), jx, jz, to);
+		}
+		else
+		{
+			for(j=0; j < 8; j++)
+				if(canStep(g, x, z, dx8[j], dz8[j]))
+					relax(pf, g, cell, gn + (j < 4 ? PATH_STRAIGHT : PATH_DIAGONAL), x + dx8[j], z + dz8[j], to);
+		}
+	}
+	return -1;
+}
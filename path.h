@@ -0,0 +1,109 @@
+#ifndef PATH_H
+#define PATH_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+
+#include "course.h"
+
+/* Occupancy grid for path queries, one bit per cell, set if blocked.
+   Rows are padded to whole 64 bit words. Outside the grid is blocked. */
+struct Grid {
+	int w, d;
+	int stride;                  // words per row
+	std::vector<uint64_t> bits;
+};
+
+void gridInit(struct Grid *g, int w, int d);
+
+/* Pits and obstacles are blocked. Moving tiles count as floor, their
+   timing is the player's problem. */
+void gridFromCourse(struct Grid *g, const struct Course *course);
+
+static inline bool gridFree(const struct Grid *g, int x, int z)
+{
+	if(x < 0 || z < 0 || x >= g->w || z >= g->d)
+		return false;
+	return !((g->bits[(size_t)z * g->stride + (x >> 6)] >> (x & 63)) & 1);
+}
+
+static inline void gridBlock(struct Grid *g, int x, int z)
+{
+	g->bits[(size_t)z * g->stride + (x >> 6)] |= 1ULL << (x & 63);
+}
+
+static inline void gridClear(struct Grid *g, int x, int z)
+{
+	g->bits[(size_t)z * g->stride + (x >> 6)] &= ~(1ULL << (x & 63));
+}
+
+struct PathPoint {
+	int x, z;
+};
+
+/* Moves are to the 8 neighbours, diagonals only when both cells beside
+   the diagonal are free, so a path never cuts the corner of a blocked cell. */
+#define PATH_STRAIGHT 10
+#define PATH_DIAGONAL 14
+
+/* Octile distance, exact on an empty grid so searches guided by it stay optimal */
+static inline uint32_t octile(int x0, int z0, int x1, int z1)
+{
+	uint32_t ax = abs(x1 - x0), az = abs(z1 - z0);
+
+	return ax > az ? PATH_STRAIGHT * ax + (PATH_DIAGONAL - PATH_STRAIGHT) * az
+		: PATH_STRAIGHT * az + (PATH_DIAGONAL - PATH_STRAIGHT) * ax;
+}
+
+enum {
+	PATH_ASTAR,
+	PATH_JPS      // Jump Point Search: same paths, far fewer nodes on open ground
+};
+
+/* Search state lives in pages of PATH_PAGE x PATH_PAGE cells, handed out
+   from a pool the first time a query touches that part of the grid, so
+   neighbours share cache lines and memory follows the area searched, not
+   the grid size. */
+#define PATH_PAGE_BITS 5
+#define PATH_PAGE (1 << PATH_PAGE_BITS)
+
+struct PathNode {
+	uint32_t g;       // UINT32_MAX until reached
+	uint32_t parent;  // cell the best route came from, the start is its own
+	uint32_t closed;
+};
+
+struct PathOpen {
+	uint64_t key;     // f in the high half, ties go to the larger g
+	uint32_t cell;
+};
+
+/* Scratch memory for queries: the page directory and pool and the open
+   list are kept between queries and only grow, so once warmed up a query
+   does no heap allocation at all. The directory is emptied by bumping gen
+   rather than clearing it. Not thread safe, keep one per thread. */
+struct PathFinder {
+	int dir_w, dir_d;                // pages across and down the grid
+	std::vector<uint32_t> dir_gen;   // page is unused unless this is gen
+	std::vector<uint32_t> dir_page;  // page's offset in pool
+	std::vector<struct PathNode> pool;
+	size_t pool_used;
+	std::vector<struct PathOpen> open;
+	uint32_t gen;
+	size_t expanded;  // nodes expanded by the last query
+	size_t grows;     // times a pool had to grow, since pathInit
+};
+
+/* Set up a finder, with pools sized for queries touching up to 'cells'
+   cells. They grow past that when they need to. */
+void pathInit(struct PathFinder *pf, size_t cells);
+
+/* Shortest path from 'from' to 'to'. Returns its cost in PATH_STRAIGHT
+   units and fills 'path' with every cell along it, both ends included,
+   or returns -1 if there is none. path may be NULL. */
+long findPath(struct PathFinder *pf, const struct Grid *g, struct PathPoint from, struct PathPoint to,
+		int algo, std::vector<struct PathPoint> *path);
+
+#endif
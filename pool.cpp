@@ -0,0 +1,287 @@
+#include <algorithm>
+
+#include "pool.h"
+
+void poolInit(struct Pool *p, PoolCreate create, PoolDestroy destroy, PoolCopy copy, void *ctx)
+{
+	p->create = create;
+	p->destroy = destroy;
+	p->copy = copy;
+	p->ctx = ctx;
+	p->buffers.clear();
+	p->by_size.clear();
+	p->defrag = -1;
+	p->slack = 0;
+	p->stats = PoolStats();
+}
+
+static void destroyBuffer(struct Pool *p, int b)
+{
+	struct PoolBuffer *buf = p->buffers[b];
+	std::map<size_t, size_t>::iterator f;
+	std::map<size_t, struct PoolAlloc *>::iterator l;
+
+	for(f=buf->free.begin(); f != buf->free.end(); ++f)
+		p->by_size.erase(std::make_pair(f->second, std::make_pair(b, f->first)));
+	for(l=buf->live.begin(); l != buf->live.end(); ++l)
+		delete l->second;
+	if(p->destroy)
+		p->destroy(buf->gpu, p->ctx);
+	delete buf;
+	p->buffers[b] = NULL;
+	p->stats.destroyed++;
+}
+
+void poolClear(struct Pool *p)
+{
+	size_t b;
+
+	for(b=0; b < p->buffers.size(); b++)
+		if(p->buffers[b])
+			destroyBuffer(p, b);
+	p->buffers.clear();
+}
+
+static void addFree(struct Pool *p, int b, size_t offset, size_t length)
+{
+	p->buffers[b]->free[offset] = length;
+	p->by_size.insert(std::make_pair(length, std::make_pair(b, offset)));
+}
+
+static void removeFree(struct Pool *p, int b, std::map<size_t, size_t>::iterator f)
+{
+	p->by_size.erase(std::make_pair(f->second, std::make_pair(b, f->first)));
+	p->buffers[b]->free.erase(f);
+}
+
+static int newBuffer(struct Pool *p, size_t size)
+{
+	struct PoolBuffer *buf;
+	void *gpu = p->create ? p->create(size, p->ctx) : NULL;
+	int b;
+
+	if(p->create && !gpu)
+		return -1;
+	buf = new struct PoolBuffer;
+	buf->gpu = gpu;
+	buf->size = size;
+	buf->used = 0;
+	/* Reuse a destroyed buffer's slot, so indices stay small */
+	for(b=0; b < (int)p->buffers.size() && p->buffers[b]; b++)
+		;
+	if(b == (int)p->buffers.size())
+		p->buffers.push_back(buf);
+	else
+		p->buffers[b] = buf;
+	addFree(p, b, 0, size);
+	p->stats.created++;
+	return b;
+}
+
+/* Take 'size' vertices from the front of free range (b, offset) */
+static struct PoolAlloc *take(struct Pool *p, int b, size_t offset, size_t size)
+{
+	struct PoolBuffer *buf = p->buffers[b];
+	std::map<size_t, size_t>::iterator f = buf->free.find(offset);
+	struct PoolAlloc *a = new struct PoolAlloc;
+	size_t length = f->second;
+
+	removeFree(p, b, f);
+	if(length > size)
+		addFree(p, b, offset + size, length - size);
+	a->buffer = b;
+	a->offset = offset;
+	a->size = size;
+	a->count = 0;
+	buf->live[offset] = a;
+	buf->used += size;
+	return a;
+}
+
+/* Smallest free range of at least 'size', not in buffer 'skip'. Returns
+   false if there is none. */
+static bool bestFit(const struct Pool *p, size_t size, int skip, int *b, size_t *offset)
+{
+	std::set<std::pair<size_t, std::pair<int, size_t> > >::const_iterator it;
+
+	for(it=p->by_size.lower_bound(std::make_pair(size, std::make_pair(-1, (size_t)0))); it != p->by_size.end(); ++it)
+		if(it->second.first != skip)
+		{
+			*b = it->second.first;
+			*offset = it->second.second;
+			return true;
+		}
+	return false;
+}
+
+struct PoolAlloc *poolAlloc(struct Pool *p, size_t size)
+{
+	size_t offset;
+	int b;
+
+	if(size == 0)
+		size = 1;
+	if(!bestFit(p, size, -1, &b, &offset))
+	{
+		b = newBuffer(p, std::max(size, (size_t)POOL_BLOCK));
+		if(b < 0)
+			return NULL;
+		offset = 0;
+	}
+	p->stats.allocs++;
+	return take(p, b, offset, size);
+}
+
+/* Give range [offset, offset + length) of buffer b back, merged with the
+   free ranges either side */
+static void release(struct Pool *p, int b, size_t offset, size_t length)
+{
+	struct PoolBuffer *buf = p->buffers[b];
+	std::map<size_t, size_t>::iterator next = buf->free.lower_bound(offset), prev;
+
+	if(next != buf->free.end() && offset + length == next->first)
+	{
+		length += next->second;
+		removeFree(p, b, next);
+		next = buf->free.lower_bound(offset);
+	}
+	if(next != buf->free.begin())
+	{
+		prev = next;
+		--prev;
+		if(prev->first + prev->second == offset)
+		{
+			offset = prev->first;
+			length += prev->second;
+			removeFree(p, b, prev);
+		}
+	}
+	addFree(p, b, offset, length);
+}
+
+void poolFree(struct Pool *p, struct PoolAlloc *a)
+{
+	struct PoolBuffer *buf = p->buffers[a->buffer];
+
+	buf->live.erase(a->offset);
+	buf->used -= a->size;
+	release(p, a->buffer, a->offset, a->size);
+	p->stats.frees++;
+	delete a;
+}
+
+/* Free space in every buffer but 'skip' */
+static size_t freeOutside(const struct Pool *p, int skip)
+{
+	size_t n = 0;
+	int b;
+
+	for(b=0; b < (int)p->buffers.size(); b++)
+		if(p->buffers[b] && b != skip)
+			n += p->buffers[b]->size - p->buffers[b]->used;
+	return n;
+}
+
+size_t poolDefrag(struct Pool *p, size_t budget)
+{
+	struct PoolBuffer *buf;
+	size_t moved = 0, n = 0, reserved = 0, used = 0, offset;
+	int b, to, from = p->defrag;
+
+	if(from < 0 || !p->buffers[from])
+	{
+		/* Start on a buffer only once a good share of what is reserved
+		   has been free for a while, then see it through even as that
+		   drops: free space the next frames fill again, or a pool just
+		   over the line, isn't worth moving anything for */
+		p->defrag = from = -1;
+		for(b=0; b < (int)p->buffers.size(); b++)
+		{
+			if(!p->buffers[b])
+				continue;
+			n++;
+			reserved += p->buffers[b]->size;
+			used += p->buffers[b]->used;
+			if(from < 0 || p->buffers[b]->used * p->buffers[from]->size < p->buffers[from]->used * p->buffers[b]->size)
+				from = b;
+		}
+		if(n < 2 || reserved - used < reserved * POOL_DEFRAG_FREE)
+		{
+			p->slack = 0;
+			return 0;
+		}
+		if(++p->slack < POOL_DEFRAG_WAIT)
+			return 0;
+		buf = p->buffers[from];
+		if(buf->used >= buf->size * POOL_DEFRAG_BELOW)
+			return 0;
+		/* Only if the rest keep a buffer's worth free after taking it all
+		   in, or the next few allocations make a new buffer straight away */
+		if(freeOutside(p, from) < buf->used + POOL_BLOCK)
+			return 0;
+		p->defrag = from;
+	}
+	buf = p->buffers[from];
+
+	while(!buf->live.empty() && moved < budget)
+	{
+		struct PoolAlloc *a = buf->live.begin()->second, *dst;
+		if(!bestFit(p, a->size, from, &to, &offset))
+		{
+			/* The others filled up meanwhile: leave it for now */
+			p->defrag = -1;
+			return moved;
+		}
+		dst = take(p, to, offset, a->size);
+		if(p->copy && a->count)
+			p->copy(buf->gpu, a->offset, p->buffers[to]->gpu, offset, a->count, p->ctx);
+		/* The owner's pointer stays good: a takes over dst's range */
+		p->buffers[to]->live[offset] = a;
+		buf->live.erase(a->offset);
+		buf->used -= a->size;
+		release(p, from, a->offset, a->size);
+		a->buffer = to;
+		a->offset = offset;
+		delete dst;
+		moved += a->size;
+		p->stats.moves++;
+		p->stats.moved += a->size;
+	}
+	if(buf->live.empty())
+	{
+		p->defrag = -1;
+		/* Kept, for the allocations to come, unless the rest have room
+		   for a big mesh in one piece */
+		if(bestFit(p, POOL_BLOCK / 2, from, &to, &offset))
+			destroyBuffer(p, from);
+	}
+	return moved;
+}
+
+void poolStats(const struct Pool *p, struct PoolStats *out)
+{
+	size_t b, sum = 0;
+
+	*out = p->stats;
+	out->buffers = out->reserved = out->used = out->free = out->largest = 0;
+	for(b=0; b < p->buffers.size(); b++)
+		if(p->buffers[b])
+		{
+			out->buffers++;
+			out->reserved += p->buffers[b]->size;
+			out->used += p->buffers[b]->used;
+		}
+	out->free = out->reserved - out->used;
+	if(!p->by_size.empty())
+		out->largest = p->by_size.rbegin()->first;
+	for(b=0; b < p->buffers.size(); b++)
+		if(p->buffers[b])
+		{
+			std::map<size_t, size_t>::const_iterator f;
+			size_t largest = 0;
+			for(f=p->buffers[b]->free.begin(); f != p->buffers[b]->free.end(); ++f)
+				largest = std::max(largest, f->second);
+			sum += largest;
+		}
+	out->fragmentation = out->free ? 1 - (double)sum / out->free : 0;
+}
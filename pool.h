@@ -0,0 +1,109 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+/* Vertex ranges carved out of a few large buffers.
+ *
+ * Meshes share big vertex buffers instead of each having its own: an
+ * allocation is a range of vertices in one of the pool's buffers, and a
+ * draw is (buffer, first vertex, count), so everything in a buffer can go
+ * in one multi-draw. Sizes are in vertices, the unit the draws count in.
+ *
+ * Free space is kept per buffer by offset, to merge a freed range with
+ * its neighbours, and across buffers by size, for the smallest range that
+ * fits. A new buffer of POOL_BLOCK vertices is made when nothing does; a
+ * mesh bigger than that gets a buffer its own size.
+ *
+ * poolDefrag empties the least used buffer into the free space of the
+ * others, a few ranges a call, and destroys it once it is empty. It
+ * starts only when a good share of the pool has been free for a while,
+ * keeps at one buffer until it is done, and keeps an emptied buffer while
+ * the rest have no room for a big mesh, so the next allocations don't
+ * just make another. Ranges move between buffers only, never within one,
+ * so a copy never overlaps itself. Allocations are the pool's, and it
+ * updates them as they move: hold on to the pointer, and read buffer and
+ * offset at draw time.
+ *
+ * What a buffer is on the GPU is up to the callbacks.
+ */
+#define POOL_BLOCK (1 << 18)       // vertices in a pooled buffer, 6 MB of position and colour
+#define POOL_DEFRAG_BELOW 0.5      // a buffer less used than this is emptied into the others
+#define POOL_DEFRAG_FREE 0.3       // once this much of the pool is free ...
+#define POOL_DEFRAG_WAIT 240       // ... for this many poolDefrag calls in a row
+
+struct PoolAlloc {
+	int buffer;        // index into the pool's buffers
+	size_t offset;     // first vertex
+	size_t size;       // vertices reserved
+	size_t count;      // of those, how many the owner has filled and draws
+};
+
+struct PoolBuffer {
+	void *gpu;                                // what the create callback returned
+	size_t size, used;                        // vertices
+	std::map<size_t, size_t> free;            // offset -> length
+	std::map<size_t, struct PoolAlloc *> live;  // offset -> allocation
+};
+
+/* create makes a buffer of 'size' vertices and returns its handle,
+   destroy frees one, copy moves 'count' vertices from one buffer to
+   another, contents and all */
+typedef void *(*PoolCreate)(size_t size, void *ctx);
+typedef void (*PoolDestroy)(void *gpu, void *ctx);
+typedef void (*PoolCopy)(void *from, size_t from_offset, void *to, size_t to_offset, size_t count, void *ctx);
+
+struct PoolStats {
+	size_t buffers;
+	size_t reserved;       // vertices in all buffers
+	size_t used;           // vertices allocated
+	size_t free, largest;  // free vertices and the largest free range
+	size_t allocs, frees, moves, moved;  // moved: vertices copied by poolDefrag
+	size_t created, destroyed;           // buffers
+	double fragmentation;  // 1 - sum of each buffer's largest free range / free, 0 with each buffer's free space in one range
+};
+
+struct Pool {
+	PoolCreate create;
+	PoolDestroy destroy;
+	PoolCopy copy;
+	void *ctx;
+	std::vector<struct PoolBuffer *> buffers;     // NULL where one was destroyed
+	std::set<std::pair<size_t, std::pair<int, size_t> > > by_size;  // (length, (buffer, offset))
+	int defrag;                                   // buffer being emptied, or -1
+	int slack;                                    // calls in a row with POOL_DEFRAG_FREE free
+	struct PoolStats stats;
+};
+
+void poolInit(struct Pool *p, PoolCreate create, PoolDestroy destroy, PoolCopy copy, void *ctx);
+
+/* Free every buffer. Allocations still held are gone with them. */
+void poolClear(struct Pool *p);
+
+/* A range of at least 'size' vertices, count 0. Returns NULL only if a
+   buffer can't be made. */
+struct PoolAlloc *poolAlloc(struct Pool *p, size_t size);
+
+void poolFree(struct Pool *p, struct PoolAlloc *a);
+
+/* Move at most 'budget' vertices out of the buffer being emptied. One is
+   started on when POOL_DEFRAG_FREE of the pool has been free for
+   POOL_DEFRAG_WAIT calls, if the least used buffer is used below
+   POOL_DEFRAG_BELOW and the others have room for it and a POOL_BLOCK
+   more. Returns the vertices moved. */
+size_t poolDefrag(struct Pool *p, size_t budget);
+
+static inline void *poolGpu(const struct Pool *p, const struct PoolAlloc *a)
+{
+	return p->buffers[a->buffer]->gpu;
+}
+
+/* Stats, with the free space and fragmentation worked out now */
+void poolStats(const struct Pool *p, struct PoolStats *out);
+
+#endif
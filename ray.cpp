@@ -0,0 +1,216 @@
+#include <math.h>
+#include <immintrin.h>
+
+#include "ray.h"
+
+void rayGrid(struct Grid *g, const struct Course *course)
+{
+	size_t n;
+
+	gridInit(g, course->w, course->d);
+	for(n=0; n < course->obs.size(); n++)
+		gridBlock(g, course->obs[n].x, course->obs[n].z);
+}
+
+const char *rayImplName(int impl)
+{
+	static const char *names[RAY_IMPLS] = { "scalar", "avx2" };
+	return names[impl];
+}
+
+/* Where a ray's walk has got to. tx and tz are the ray fractions at which
+   it crosses into the next column and row; once the walk reaches the end
+   column (row) tx (tz) is infinite, so the walk ends in the end cell
+   whatever rounding does to the order of the steps. */
+struct RayWalk {
+	int x, z, ex, ez, sx, sz;
+	float tx, tz, ddx, ddz, t;
+};
+
+static inline void rayBegin(const struct Ray *r, struct RayWalk *w)
+{
+	float dx = r->x1 - r->x0, dz = r->z1 - r->z0;
+
+	w->x = (int)floorf(r->x0);
+	w->z = (int)floorf(r->z0);
+	w->ex = (int)floorf(r->x1);
+	w->ez = (int)floorf(r->z1);
+	w->sx = dx > 0 ? 1 : -1;
+	w->sz = dz > 0 ? 1 : -1;
+	w->ddx = dx != 0 ? 1 / fabsf(dx) : INFINITY;
+	w->ddz = dz != 0 ? 1 / fabsf(dz) : INFINITY;
+	w->tx = w->x == w->ex ? INFINITY : dx > 0 ? (w->x + 1 - r->x0) / dx : (r->x0 - w->x) / -dx;
+	w->tz = w->z == w->ez ? INFINITY : dz > 0 ? (w->z + 1 - r->z0) / dz : (r->z0 - w->z) / -dz;
+	w->t = 0;
+}
+
+static inline void rayEnd(const struct RayWalk *w, bool hit, struct RayHit *out)
+{
+	out->t = hit ? w->t : 1;
+	out->x = w->x;
+	out->z = w->z;
+	out->hit = hit;
+}
+
+static size_t castScalar(const struct Grid *g, const struct Ray *rays, size_t n, struct RayHit *out)
+{
+	size_t i, hits = 0;
+
+	for(i=0; i < n; i++)
+	{
+		struct RayWalk w;
+
+		rayBegin(&rays[i], &w);
+		for(;;)
+		{
+			if(!gridFree(g, w.x, w.z))
+			{
+				hits++;
+				rayEnd(&w, true, &out[i]);
+				break;
+			}
+			if(w.tx == INFINITY && w.tz == INFINITY)
+			{
+				rayEnd(&w, false, &out[i]);
+				break;
+			}
+			if(w.tx <= w.tz)
+			{
+				w.t = w.tx;
+				w.x += w.sx;
+				w.tx = w.x == w.ex ? INFINITY : w.tx + w.ddx;
+			}
+			else
+			{
+				w.t = w.tz;
+				w.z += w.sz;
+				w.tz = w.z == w.ez ? INFINITY : w.tz + w.ddz;
+			}
+		}
+	}
+	return hits;
+}
+
+/* Eight walks in the lanes of these, as structure of arrays so a lane can
+   be refilled from scalar code */
+struct RayLanes {
+	alignas(32) int x[8], z[8], ex[8], ez[8], sx[8], sz[8], id[8];
+	alignas(32) float tx[8], tz[8], ddx[8], ddz[8], t[8];
+};
+
+static inline void laneSet(struct RayLanes *l, int j, const struct RayWalk *w, int id)
+{
+	l->x[j] = w->x;
+	l->z[j] = w->z;
+	l->ex[j] = w->ex;
+	l->ez[j] = w->ez;
+	l->sx[j] = w->sx;
+	l->sz[j] = w->sz;
+	l->tx[j] = w->tx;
+	l->tz[j] = w->tz;
+	l->ddx[j] = w->ddx;
+	l->ddz[j] = w->ddz;
+	l->t[j] = w->t;
+	l->id[j] = id;
+}
+
+static inline void laneGet(const struct RayLanes *l, int j, struct RayWalk *w)
+{
+	w->x = l->x[j];
+	w->z = l->z[j];
+	w->t = l->t[j];
+}
+
+__attribute__((target("avx2")))
+static size_t castAvx2(const struct Grid *g, const struct Ray *rays, size_t n, struct RayHit *out)
+{
+	const int *bits = (const int *)g->bits.data();
+	const __m256i one = _mm256_set1_epi32(1), none = _mm256_set1_epi32(-1), zero = _mm256_setzero_si256();
+	const __m256i w = _mm256_set1_epi32(g->w), d = _mm256_set1_epi32(g->d), stride = _mm256_set1_epi32(g->stride * 2);
+	const __m256 inf = _mm256_set1_ps(INFINITY);
+	struct RayLanes l;
+	size_t next = 0, hits = 0;
+	unsigned active = 0;
+	int j;
+
+	/* An idle lane sits outside the grid, so it is never gathered from */
+	for(j=0; j < 8; j++)
+	{
+		struct RayWalk walk = { -1, -1, -1, -1, 1, 1, INFINITY, INFINITY, INFINITY, INFINITY, 0 };
+		if(next < n)
+		{
+			rayBegin(&rays[next], &walk);
+			active |= 1u << j;
+		}
+		laneSet(&l, j, &walk, (int)next++);
+	}
+
+	while(active)
+	{
+		__m256i x = _mm256_load_si256((const __m256i *)l.x), z = _mm256_load_si256((const __m256i *)l.z);
+		__m256i ex = _mm256_load_si256((const __m256i *)l.ex), ez = _mm256_load_si256((const __m256i *)l.ez);
+		__m256i sx = _mm256_load_si256((const __m256i *)l.sx), sz = _mm256_load_si256((const __m256i *)l.sz);
+		__m256 tx = _mm256_load_ps(l.tx), tz = _mm256_load_ps(l.tz), t = _mm256_load_ps(l.t);
+		__m256 ddx = _mm256_load_ps(l.ddx), ddz = _mm256_load_ps(l.ddz);
+		unsigned done;
+
+		/* Walk all eight until one of them has finished */
+		for(;;)
+		{
+			__m256i in = _mm256_and_si256(_mm256_and_si256(_mm256_cmpgt_epi32(x, none), _mm256_cmpgt_epi32(w, x)),
+					_mm256_and_si256(_mm256_cmpgt_epi32(z, none), _mm256_cmpgt_epi32(d, z)));
+			__m256i idx = _mm256_and_si256(_mm256_add_epi32(_mm256_mullo_epi32(z, stride), _mm256_srai_epi32(x, 5)), in);
+			__m256i word = _mm256_mask_i32gather_epi32(zero, bits, idx, in, 4);
+			__m256i blocked = _mm256_or_si256(_mm256_xor_si256(in, none),
+					_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_srlv_epi32(word, _mm256_and_si256(x, _mm256_set1_epi32(31))), one), one));
+			__m256 ended = _mm256_and_ps(_mm256_cmp_ps(tx, inf, _CMP_EQ_OQ), _mm256_cmp_ps(tz, inf, _CMP_EQ_OQ));
+			__m256 alongX, stepX, stepZ;
+
+			done = (_mm256_movemask_ps(_mm256_or_ps(_mm256_castsi256_ps(blocked), ended)) & active);
+			if(done)
+				break;
+
+			alongX = _mm256_cmp_ps(tx, tz, _CMP_LE_OQ);
+			t = _mm256_blendv_ps(tz, tx, alongX);
+			x = _mm256_add_epi32(x, _mm256_and_si256(sx, _mm256_castps_si256(alongX)));
+			z = _mm256_add_epi32(z, _mm256_andnot_si256(_mm256_castps_si256(alongX), sz));
+			stepX = _mm256_blendv_ps(tx, _mm256_add_ps(tx, ddx), alongX);
+			stepZ = _mm256_blendv_ps(_mm256_add_ps(tz, ddz), tz, alongX);
+			tx = _mm256_blendv_ps(stepX, inf, _mm256_castsi256_ps(_mm256_cmpeq_epi32(x, ex)));
+			tz = _mm256_blendv_ps(stepZ, inf, _mm256_castsi256_ps(_mm256_cmpeq_epi32(z, ez)));
+		}
+
+		_mm256_store_si256((__m256i *)l.x, x);
+		_mm256_store_si256((__m256i *)l.z, z);
+		_mm256_store_ps(l.tx, tx);
+		_mm256_store_ps(l.tz, tz);
+		_mm256_store_ps(l.t, t);
+		/* Finish the lanes that are done and start them on the next rays */
+		while(done)
+		{
+			struct RayWalk walk = { -1, -1, -1, -1, 1, 1, INFINITY, INFINITY, INFINITY, INFINITY, 0 };
+			bool hit;
+
+			j = __builtin_ctz(done);
+			done &= done - 1;
+			laneGet(&l, j, &walk);
+			hit = !gridFree(g, walk.x, walk.z);
+			hits += hit;
+			rayEnd(&walk, hit, &out[l.id[j]]);
+			walk.x = walk.z = -1;
+			if(next < n)
+				rayBegin(&rays[next], &walk);
+			else
+				active &= ~(1u << j);
+			laneSet(&l, j, &walk, (int)next++);
+		}
+	}
+	return hits;
+}
+
+size_t rayCast(const struct Grid *g, const struct Ray *rays, size_t n, int impl, struct RayHit *out)
+{
+	if(impl == RAY_AVX2 && __builtin_cpu_supports("avx2"))
+		return castAvx2(g, rays, n, out);
+	return castScalar(g, rays, n, out);
+}
@@ -0,0 +1,47 @@
+#ifndef RAY_H
+#define RAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "path.h"
+
+/* Line of sight over an occupancy grid (see path.h, set bits block), for
+ * NPC vision, camera occlusion and trap triggers.
+ *
+ * A ray runs from one point to another and walks the cells between with
+ * Amanatides and Woo's grid traversal, stopping at the first blocked
+ * cell. Rays come in batches. The AVX2 version walks eight at a time in
+ * lock step, and a lane whose ray ends or is blocked takes the next ray of
+ * the batch straight away, so a few long rays don't hold up the rest.
+ */
+struct Ray {
+	float x0, z0;  // from, in cells: cell (i, k) covers [i, i+1) x [k, k+1)
+	float x1, z1;  // to
+};
+
+struct RayHit {
+	float t;       // fraction of the way the blocked cell is entered at, 1 if clear
+	int x, z;      // the blocked cell, or the end cell if clear
+	int hit;
+};
+
+/* Cells that block sight on a course: obstacles. Pits and moving tiles
+   are seen over. */
+void rayGrid(struct Grid *g, const struct Course *course);
+
+enum {
+	RAY_SCALAR,
+	RAY_AVX2,     // falls back to scalar without AVX2
+	RAY_IMPLS
+};
+
+const char *rayImplName(int impl);
+
+/* Cast n rays, writing out[i] for rays[i], and return how many were
+   blocked. The start and end cells are tested too; outside the grid
+   blocks, as it does for paths. Both implementations give the same
+   results, bit for bit. */
+size_t rayCast(const struct Grid *g, const struct Ray *rays, size_t n, int impl, struct RayHit *out);
+
+#endif
@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <immintrin.h>
+
+#include "reach.h"
+
+void boardInit(struct Bitboard *b, int w, int d)
+{
+	b->w = w;
+	b->d = d;
+	b->stride = (w + 63) / 64;
+	b->bits.assign((size_t)b->stride * d, 0);
+}
+
+void boardWalkable(struct Bitboard *b, const struct Course *course, bool moving)
+{
+	int i, k;
+	size_t n;
+
+	boardInit(b, course->w, course->d);
+	for(k=0; k < course->d; k++)
+		for(i=0; i < course->w; i++)
+		{
+			int t = courseTile(course, i, k);
+			if(t == TILE_FLOOR || (moving && t == TILE_MOVING))
+				boardSet(b, i, k);
+		}
+	for(n=0; n < course->obs.size(); n++)
+	{
+		const struct Obstacle *o = &course->obs[n];
+		b->bits[(size_t)o->z * b->stride + (o->x >> 6)] &= ~(1ULL << (o->x & 63));
+	}
+}
+
+const char *reachImplName(int impl)
+{
+	static const char *names[REACH_IMPLS] = { "bfs", "sweep", "avx2" };
+	return names[impl];
+}
+
+/* Spread the bits of s along the runs of w they are in, both ways. Upward
+   an add does it: the carry out of a seed runs to the top of its run.
+   Downward there is no such trick, so shifts double the reach six times. */
+static inline uint64_t fillWord(uint64_t s, uint64_t w)
+{
+	uint64_t p = w;
+
+	s &= w;
+	s |= ((w + s) ^ w) & w;
+	s |= p & (s >> 1);
+	p &= p >> 1;
+	s |= p & (s >> 2);
+	p &= p >> 2;
+	s |= p & (s >> 4);
+	p &= p >> 4;
+	s |= p & (s >> 8);
+	p &= p >> 8;
+	s |= p & (s >> 16);
+	p &= p >> 16;
+	s |= p & (s >> 32);
+	return s;
+}
+
+/* Runs that go on into the next word: carry the fill across, up the row
+   and then back down it */
+static inline void carryRow(uint64_t *r, const uint64_t *w, int stride)
+{
+	int i;
+
+	for(i=1; i < stride; i++)
+		if((r[i - 1] >> 63) && (w[i] & 1) && !(r[i] & 1))
+			r[i] = fillWord(r[i] | 1, w[i]);
+	for(i=stride-2; i >= 0; i--)
+		if((r[i + 1] & 1) && (w[i] >> 63) && !(r[i] >> 63))
+			r[i] = fillWord(r[i] | 1ULL << 63, w[i]);
+}
+
+/* Grow row r from itself and the rows above (a) and below (b), either of
+   which may be NULL. Returns whether it grew. */
+static bool sweepRow(uint64_t *r, const uint64_t *a, const uint64_t *b, const uint64_t *w, int stride)
+{
+	uint64_t grew = 0;
+	int i;
+
+	for(i=0; i < stride; i++)
+	{
+		uint64_t s = r[i] | (a ? a[i] : 0) | (b ? b[i] : 0);
+		s = fillWord(s, w[i]);
+		grew |= s ^ r[i];
+		r[i] = s;
+	}
+	if(grew && stride > 1)
+		carryRow(r, w, stride);
+	return grew != 0;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i fillWord4(__m256i s, __m256i w)
+{
+	__m256i p = w;
+
+	s = _mm256_and_si256(s, w);
+	s = _mm256_or_si256(s, _mm256_and_si256(_mm256_xor_si256(_mm256_add_epi64(w, s), w), w));
+	s = _mm256_or_si256(s, _mm256_and_si256(p, _mm256_srli_epi64(s, 1)));
+	p = _mm256_and_si256(p, _mm256_srli_epi64(p, 1));
+	s = _mm256_or_si256(s, _mm256_and_si256(p, _mm256_srli_epi64(s, 2)));
+	p = _mm256_and_si256(p, _mm256_srli_epi64(p, 2));
+	s = _mm256_or_si256(s, _mm256_and_si256(p, _mm256_srli_epi64(s, 4)));
+	p = _mm256_and_si256(p, _mm256_srli_epi64(p, 4));
+	s = _mm256_or_si256(s, _mm256_and_si256(p, _mm256_srli_epi64(s, 8)));
+	p = _mm256_and_si256(p, _mm256_srli_epi64(p, 8));
+	s = _mm256_or_si256(s, _mm256_and_si256(p, _mm256_srli_epi64(s, 16)));
+	p = _mm256_and_si256(p, _mm256_srli_epi64(p, 16));
+	s = _mm256_or_si256(s, _mm256_and_si256(p, _mm256_srli_epi64(s, 32)));
+	return s;
+}
+
+/* sweepRow four words at a time, the last few words one at a time */
+__attribute__((target("avx2")))
+static bool sweepRowAvx2(uint64_t *r, const uint64_t *a, const uint64_t *b, const uint64_t *w, int stride)
+{
+	__m256i grew4 = _mm256_setzero_si256();
+	uint64_t grew = 0;
+	int i;
+
+	for(i=0; i + 4 <= stride; i += 4)
+	{
+		__m256i old = _mm256_loadu_si256((const __m256i *)(r + i)), s = old;
+		if(a)
+			s = _mm256_or_si256(s, _mm256_loadu_si256((const __m256i *)(a + i)));
+		if(b)
+			s = _mm256_or_si256(s, _mm256_loadu_si256((const __m256i *)(b + i)));
+		s = fillWord4(s, _mm256_loadu_si256((const __m256i *)(w + i)));
+		grew4 = _mm256_or_si256(grew4, _mm256_xor_si256(s, old));
+		_mm256_storeu_si256((__m256i *)(r + i), s);
+	}
+	for(; i < stride; i++)
+	{
+		uint64_t s = r[i] | (a ? a[i] : 0) | (b ? b[i] : 0);
+		s = fillWord(s, w[i]);
+		grew |= s ^ r[i];
+		r[i] = s;
+	}
+	grew |= !_mm256_testz_si256(grew4, grew4);
+	if(grew && stride > 1)
+		carryRow(r, w, stride);
+	return grew != 0;
+}
+
+static size_t sweepFill(struct Reach *r, const struct Bitboard *walk, int x, int z,
+		bool (*row)(uint64_t *, const uint64_t *, const uint64_t *, const uint64_t *, int))
+{
+	const int d = walk->d, stride = walk->stride;
+	uint64_t *seen = r->seen.bits.data();
+	const uint64_t *w = walk->bits.data();
+	uint32_t k = 1, *pass;
+	bool changed;
+	size_t n = 0;
+	int i;
+
+	r->pass.assign(d, 0);
+	pass = r->pass.data();
+	/* The seed row is grown on its own first. The seed counts as grown, so
+	   a run it starts that goes on into the next word gets carried too. */
+	boardSet(&r->seen, x, z);
+	row(seen + (size_t)z * stride, NULL, NULL, w + (size_t)z * stride, stride);
+	carryRow(seen + (size_t)z * stride, w + (size_t)z * stride, stride);
+	pass[z] = k;
+
+	/* Odd sweeps go down, even ones up. A row is redone when a neighbour
+	   changed since the row was last looked at. */
+	do {
+		int step = ++k & 1 ? 1 : -1;
+		changed = false;
+		for(i = step > 0 ? 0 : d - 1; i >= 0 && i < d; i += step)
+		{
+			if(!((i > 0 && pass[i - 1] + 1 >= k) || (i + 1 < d && pass[i + 1] + 1 >= k)))
+				continue;
+			if(row(seen + (size_t)i * stride, i > 0 ? seen + (size_t)(i - 1) * stride : NULL,
+					i + 1 < d ? seen + (size_t)(i + 1) * stride : NULL, w + (size_t)i * stride, stride))
+			{
+				pass[i] = k;
+				changed = true;
+			}
+		}
+	} while(changed);
+	r->sweeps = k - 1;
+
+	for(i=0; i < (int)r->seen.bits.size(); i++)
+		n += __builtin_popcountll(seen[i]);
+	return n;
+}
+
+static size_t bfsFill(struct Reach *r, const struct Bitboard *walk, int x, int z)
+{
+	static const int dx[4] = { 1, -1, 0, 0 }, dz[4] = { 0, 0, 1, -1 };
+	size_t head = 0;
+	int j;
+
+	r->queue.clear();
+	boardSet(&r->seen, x, z);
+	r->queue.push_back((uint32_t)z * walk->w + x);
+	while(head < r->queue.size())
+	{
+		uint32_t cell = r->queue[head++];
+		int cx = cell % walk->w, cz = cell / walk->w;
+		for(j=0; j < 4; j++)
+		{
+			int nx = cx + dx[j], nz = cz + dz[j];
+			if(!boardTest(walk, nx, nz) || boardTest(&r->seen, nx, nz))
+				continue;
+			boardSet(&r->seen, nx, nz);
+			r->queue.push_back((uint32_t)nz * walk->w + nx);
+		}
+	}
+	r->sweeps = 0;
+	return r->queue.size();
+}
+
+size_t reachFill(struct Reach *r, const struct Bitboard *walk, int x, int z, int impl)
+{
+	if(r->seen.w != walk->w || r->seen.d != walk->d || r->seen.bits.size() != walk->bits.size())
+		boardInit(&r->seen, walk->w, walk->d);
+	else
+		std::fill(r->seen.bits.begin(), r->seen.bits.end(), 0);
+	r->sweeps = 0;
+	if(!boardTest(walk, x, z))
+		return 0;
+
+	if(impl == REACH_BFS)
+		return bfsFill(r, walk, x, z);
+	if(impl == REACH_AVX2 && walk->stride >= 4 && __builtin_cpu_supports("avx2"))
+		return sweepFill(r, walk, x, z, sweepRowAvx2);
+	return sweepFill(r, walk, x, z, sweepRow);
+}
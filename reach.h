@@ -0,0 +1,67 @@
+#ifndef REACH_H
+#define REACH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "course.h"
+
+/* Which cells can be walked to from a starting cell, in the solver's
+ * 4-way model, for validating and scoring courses.
+ *
+ * Cells are kept as bitboards, one bit per cell and 64 cells to a word,
+ * rows padded to whole words. A flood fill grows the reached set a row at
+ * a time: whatever is reached in the rows above and below seeds the row,
+ * and shifts, adds and masks spread it along the open runs of all 64 cells
+ * of a word at once. Rows are swept down and up again until nothing
+ * changes; a sweep only touches rows next to one that changed.
+ */
+struct Bitboard {
+	int w, d;
+	int stride;                  // words per row
+	std::vector<uint64_t> bits;  // bits past w are always clear
+};
+
+void boardInit(struct Bitboard *b, int w, int d);
+
+static inline bool boardTest(const struct Bitboard *b, int x, int z)
+{
+	if(x < 0 || z < 0 || x >= b->w || z >= b->d)
+		return false;
+	return (b->bits[(size_t)z * b->stride + (x >> 6)] >> (x & 63)) & 1;
+}
+
+static inline void boardSet(struct Bitboard *b, int x, int z)
+{
+	b->bits[(size_t)z * b->stride + (x >> 6)] |= 1ULL << (x & 63);
+}
+
+/* Floor cells of the course that hold no obstacle, and the moving tiles
+   too if 'moving', whatever their height */
+void boardWalkable(struct Bitboard *b, const struct Course *course, bool moving);
+
+enum {
+	REACH_BFS,    // reference: a queue of single cells
+	REACH_SWEEP,  // bitboard sweeps, a word at a time
+	REACH_AVX2,   // bitboard sweeps, four words at a time on rows of 256 cells
+	              // or more where the CPU has AVX2
+	REACH_IMPLS
+};
+
+const char *reachImplName(int impl);
+
+/* Scratch for fills, kept between calls so they don't allocate once
+   warmed up. Not thread safe, keep one per thread. */
+struct Reach {
+	struct Bitboard seen;         // cells reached by the last fill
+	std::vector<uint32_t> pass;   // sweep that last changed each row
+	std::vector<uint32_t> queue;  // cells waiting, for REACH_BFS
+	size_t sweeps;                // sweeps the last fill took
+};
+
+/* Fill r->seen with the cells of 'walk' 4-connected to (x, z) and return
+   how many there are. Nothing is reached from a cell that isn't walkable. */
+size_t reachFill(struct Reach *r, const struct Bitboard *walk, int x, int z, int impl);
+
+#endif
@@ -0,0 +1,283 @@
+#include <string.h>
+#include <sys/time.h>
+
+#include <algorithm>
+
+#include "remesh.h"
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void latencyAdd(struct Latency *l, double t)
+{
+	l->n++;
+	l->sum += t;
+	l->max = std::max(l->max, t);
+}
+
+/* Under the lock: copy chunk n's cells and the ring around them into a
+   small course of its own, cell (i, k) of it being (i0-1+i, k0-1+k) */
+static void copyChunk(const struct Remesher *rm, int n, struct Course *sub, int *i0, int *k0)
+{
+	const struct CollisionIndex *ci = &rm->course->index;
+	int i, k;
+
+	*i0 = n % rm->cw * REMESH_CHUNK;
+	*k0 = n / rm->cw * REMESH_CHUNK;
+	sub->w = std::min(REMESH_CHUNK, ci->w - *i0) + 2;
+	sub->d = std::min(REMESH_CHUNK, ci->d - *k0) + 2;
+	sub->index.w = sub->w;
+	sub->index.d = sub->d;
+	sub->index.stride = sub->w + 2;
+	sub->index.own.assign((size_t)sub->index.stride * (sub->d + 2), 0);
+	for(k=0; k < sub->d; k++)
+		for(i=0; i < sub->w; i++)
+			sub->index.own[(size_t)(k + 1) * sub->index.stride + i + 1] = colCell(ci, *i0 - 1 + i, *k0 - 1 + k);
+	sub->index.cells = sub->index.own.data();
+}
+
+static void worker(struct Remesher *rm)
+{
+	std::unique_lock<std::mutex> hold(rm->lock);
+	struct Course *sub = new struct Course;
+
+	for(;;)
+	{
+		struct RemeshChunk *ch;
+		struct Mesh mesh;
+		double t0, t1;
+		int n, i0, k0;
+		size_t v;
+
+		rm->wake.wait(hold, [rm]() { return rm->quit || !rm->todo.empty(); });
+		if(rm->quit)
+			break;
+		n = rm->todo.front();
+		rm->todo.pop_front();
+		ch = &rm->chunks[n];
+		if(ch->state != REMESH_QUEUED)
+			continue;
+		ch->state = REMESH_BUSY;
+		copyChunk(rm, n, sub, &i0, &k0);
+		hold.unlock();
+
+		t0 = now();
+		meshRegionGreedy(&mesh, sub, 1, 1, sub->w - 1, sub->d - 1);
+		for(v=0; v < mesh.pos.size(); v += 3)
+		{
+			mesh.pos[v] += i0 - 1;
+			mesh.pos[v + 2] += k0 - 1;
+		}
+		t1 = now();
+
+		hold.lock();
+		latencyAdd(&rm->stats.mesh, t1 - t0);
+		rm->stats.meshed++;
+		if(ch->again)
+		{
+			ch->again = false;
+			ch->state = REMESH_QUEUED;
+			rm->todo.push_front(n);
+			continue;
+		}
+		std::swap(ch->mesh, mesh);
+		ch->state = REMESH_MESHED;
+		/* Edits are uploaded ahead of the first meshing of the course */
+		if(ch->t_edit)
+			rm->ready.push_front(n);
+		else
+			rm->ready.push_back(n);
+	}
+	delete sub;
+}
+
+void remeshStart(struct Remesher *rm, struct Course *course, int threads,
+		RemeshUpload upload, RemeshRelease release, void *ctx)
+{
+	struct CollisionIndex *ci = &course->index;
+	int n, t;
+
+	if(ci->cells != ci->own.data())
+	{
+		ci->own.assign(ci->cells, ci->cells + (size_t)ci->stride * (ci->d + 2));
+		ci->cells = ci->own.data();
+	}
+	rm->course = course;
+	rm->cw = (course->w + REMESH_CHUNK - 1) / REMESH_CHUNK;
+	rm->cd = (course->d + REMESH_CHUNK - 1) / REMESH_CHUNK;
+	rm->upload = upload;
+	rm->release = release;
+	rm->ctx = ctx;
+	rm->quit = false;
+	rm->stats = RemeshStats();
+	rm->chunks.assign((size_t)rm->cw * rm->cd, RemeshChunk());
+	rm->todo.clear();
+	rm->ready.clear();
+	for(n=0; n < (int)rm->chunks.size(); n++)
+	{
+		rm->chunks[n].state = REMESH_QUEUED;
+		rm->chunks[n].again = false;
+		rm->chunks[n].gpu = NULL;
+		rm->chunks[n].gpu_bytes = 0;
+		rm->chunks[n].t_edit = 0;
+		rm->todo.push_back(n);
+	}
+	rm->stats.pending = rm->chunks.size();
+	if(threads < 1)
+		threads = 1;
+	for(t=0; t < threads; t++)
+		rm->workers.push_back(std::thread(worker, rm));
+}
+
+void remeshStop(struct Remesher *rm)
+{
+	size_t n;
+
+	{
+		std::lock_guard<std::mutex> hold(rm->lock);
+		rm->quit = true;
+	}
+	rm->wake.notify_all();
+	for(n=0; n < rm->workers.size(); n++)
+		rm->workers[n].join();
+	rm->workers.clear();
+	for(n=0; n < rm->chunks.size(); n++)
+		if(rm->chunks[n].gpu && rm->release)
+			rm->release(rm->chunks[n].gpu, rm->ctx);
+	rm->chunks.clear();
+	rm->todo.clear();
+	rm->ready.clear();
+}
+
+/* Under the lock: the chunk holding cell (i, k) has to be meshed again */
+static void dirty(struct Remesher *rm, int i, int k, double t)
+{
+	struct RemeshChunk *ch;
+	int n;
+
+	if(i < 0 || k < 0 || i >= rm->course->w || k >= rm->course->d)
+		return;
+	n = k / REMESH_CHUNK * rm->cw + i / REMESH_CHUNK;
+	ch = &rm->chunks[n];
+	if(!ch->t_edit)
+		ch->t_edit = t;
+	switch(ch->state)
+	{
+	case REMESH_CLEAN:
+		rm->stats.pending++;
+		/* fall through */
+	case REMESH_MESHED:
+		ch->state = REMESH_QUEUED;
+		/* fall through */
+	case REMESH_QUEUED:
+		/* To the front, even if it is further back already: the worker
+		   passes over entries for chunks no longer queued */
+		rm->todo.push_front(n);
+		rm->wake.notify_one();
+		break;
+	case REMESH_BUSY:
+		ch->again = true;
+		break;
+	}
+}
+
+/* Under the lock: cell (i, k)'s index flags become 'flags' */
+static void edit(struct Remesher *rm, int i, int k, uint8_t flags)
+{
+	struct CollisionIndex *ci = &rm->course->index;
+	double t = now();
+
+	ci->own[(size_t)(k + 1) * ci->stride + i + 1] = flags;
+	rm->stats.edits++;
+	dirty(rm, i, k, t);
+	/* A neighbour in another chunk has a face against this cell */
+	if(i % REMESH_CHUNK == 0)
+		dirty(rm, i - 1, k, t);
+	if(i % REMESH_CHUNK == REMESH_CHUNK - 1)
+		dirty(rm, i + 1, k, t);
+	if(k % REMESH_CHUNK == 0)
+		dirty(rm, i, k - 1, t);
+	if(k % REMESH_CHUNK == REMESH_CHUNK - 1)
+		dirty(rm, i, k + 1, t);
+}
+
+bool remeshSetTile(struct Remesher *rm, int i, int k, int tile)
+{
+	std::lock_guard<std::mutex> hold(rm->lock);
+	struct Course *course = rm->course;
+	unsigned was, flags;
+
+	if(i < 0 || k < 0 || i >= course->w || k >= course->d || (i == course->spawn_x && k == course->spawn_z))
+		return false;
+	was = colCell(&course->index, i, k);
+	flags = tile == TILE_FLOOR ? COL_FLOOR | (was & COL_OBSTACLE) : tile == TILE_MOVING ? COL_MOVING : 0;
+	if(flags == was)
+		return false;
+	if(!course->tiles.empty())
+		course->tiles[(size_t)k * course->w + i] = tile;
+	edit(rm, i, k, flags);
+	return true;
+}
+
+bool remeshSetObstacle(struct Remesher *rm, int i, int k, bool on)
+{
+	std::lock_guard<std::mutex> hold(rm->lock);
+	struct Course *course = rm->course;
+	unsigned was;
+
+	if(i < 0 || k < 0 || i >= course->w || k >= course->d || (i == course->spawn_x && k == course->spawn_z))
+		return false;
+	was = colCell(&course->index, i, k);
+	if(!(was & COL_FLOOR) || (bool)(was & COL_OBSTACLE) == on)
+		return false;
+	edit(rm, i, k, on ? was | COL_OBSTACLE : was & ~COL_OBSTACLE);
+	return true;
+}
+
+void remeshUpdate(struct Remesher *rm, int max_uploads)
+{
+	std::lock_guard<std::mutex> hold(rm->lock);
+	int uploads = 0;
+
+	/* The lock stays held, as in streamUpdate: an edit during the upload
+	   must see the chunk's state as it is */
+	while(!rm->ready.empty() && uploads < max_uploads)
+	{
+		struct RemeshChunk *ch = &rm->chunks[rm->ready.front()];
+		struct Mesh empty;
+		void *gpu;
+
+		rm->ready.pop_front();
+		/* Edited again since, and queued afresh */
+		if(ch->state != REMESH_MESHED)
+			continue;
+		if(rm->upload)
+		{
+			gpu = rm->upload(ch->gpu, &ch->mesh, rm->ctx);
+			if(gpu && gpu == ch->gpu)
+				rm->stats.in_place++;
+			ch->gpu = gpu;
+		}
+		ch->gpu_bytes = meshBytes(&ch->mesh);
+		std::swap(ch->mesh, empty);
+		ch->state = REMESH_CLEAN;
+		if(ch->t_edit)
+		{
+			latencyAdd(&rm->stats.visible, now() - ch->t_edit);
+			ch->t_edit = 0;
+		}
+		rm->stats.uploaded++;
+		rm->stats.pending--;
+		uploads++;
+	}
+}
+
+void remeshStats(struct Remesher *rm, struct RemeshStats *out)
+{
+	std::lock_guard<std::mutex> hold(rm->lock);
+	*out = rm->stats;
+}
@@ -0,0 +1,107 @@
+#ifndef REMESH_H
+#define REMESH_H
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "course.h"
+#include "mesh.h"
+#include "stream.h"
+
+/* A course's static geometry as greedy meshes of REMESH_CHUNK x
+ * REMESH_CHUNK cells, kept up to date as tiles change under the player.
+ *
+ * remeshSetTile and remeshSetObstacle edit the course's tiles and
+ * collision index and mark dirty the chunks the edit can show in: the
+ * cell's own, and the chunk across any side of the cell on a chunk's edge,
+ * whose faces against it come or go. Dirty chunks go to the front of the
+ * worker queue. A worker copies the chunk's cells and the ring around them
+ * under the lock and meshes the copy, so nothing it does depends on the
+ * size of the course; an edit to a chunk being meshed queues it again.
+ * The thread that owns the GPU hands finished meshes to a callback in
+ * remeshUpdate, which writes them over the chunk's old geometry.
+ *
+ * Meshes are in course coordinates. Moving tiles are not in them, as with
+ * meshCourse. course->obs is left as it was built; the tiles and the index
+ * are what the edits keep.
+ */
+#define REMESH_CHUNK 32
+
+enum {
+	REMESH_CLEAN,    // on the GPU as it is
+	REMESH_QUEUED,   // waiting for a worker
+	REMESH_BUSY,     // being meshed
+	REMESH_MESHED    // mesh waiting to be uploaded
+};
+
+struct RemeshChunk {
+	int state;          // REMESH_*, under the lock
+	bool again;         // edited while busy, queue it again once meshed
+	struct Mesh mesh;
+	void *gpu;          // what the upload callback returned
+	size_t gpu_bytes;
+	double t_edit;      // first edit not uploaded yet, 0 if none
+};
+
+struct RemeshStats {
+	struct Latency mesh;     // meshing one chunk, on a worker
+	struct Latency visible;  // an edit to its chunks uploaded
+	size_t edits, meshed, uploaded;
+	size_t in_place;         // uploads the callback fitted in the chunk's old buffer
+	size_t pending;          // chunks not clean
+};
+
+/* Called on the thread that calls remeshUpdate. upload gets the chunk's
+   handle, NULL the first time, and returns its handle for the new mesh,
+   the same one if it wrote over the old geometry. release frees one. */
+typedef void *(*RemeshUpload)(void *gpu, const struct Mesh *mesh, void *ctx);
+typedef void (*RemeshRelease)(void *gpu, void *ctx);
+
+struct Remesher {
+	struct Course *course;
+	int cw, cd;                      // chunks across and down
+	RemeshUpload upload;
+	RemeshRelease release;
+	void *ctx;
+
+	std::mutex lock;
+	std::condition_variable wake;    // workers: something queued or quit
+	std::deque<int> todo;            // chunk cw*ck + ci
+	std::deque<int> ready;           // meshed, edited ones first
+	std::vector<struct RemeshChunk> chunks;
+	std::vector<std::thread> workers;
+	bool quit;
+	struct RemeshStats stats;
+};
+
+/* Queue every chunk of the course and start 'threads' workers. The course
+   must stay put until remeshStop; edit it only through the remesher. An
+   index that points at a level's cells is copied first, to be editable.
+   upload and release may be NULL for no GPU. */
+void remeshStart(struct Remesher *rm, struct Course *course, int threads,
+		RemeshUpload upload, RemeshRelease release, void *ctx);
+
+/* Stop the workers and release every chunk */
+void remeshStop(struct Remesher *rm);
+
+/* Set a cell's tile. An obstacle on it goes unless it stays floor.
+   Returns false if the cell is off the course, the spawn or already that. */
+bool remeshSetTile(struct Remesher *rm, int i, int k, int tile);
+
+/* Put an obstacle on a cell or take it off. Obstacles stand on plain
+   floor, never on the spawn. Returns false if the cell can't take one or
+   nothing changed. */
+bool remeshSetObstacle(struct Remesher *rm, int i, int k, bool on);
+
+/* Once a frame: upload at most max_uploads finished chunks */
+void remeshUpdate(struct Remesher *rm, int max_uploads);
+
+/* A copy of the stats, taken under the lock */
+void remeshStats(struct Remesher *rm, struct RemeshStats *out);
+
+#endif
@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "replay.h"
+#include "rewind.h"
+#include "maze.h"
+
+#define CHAIN_SEED 0xcbf29ce484222325ULL
+
+void replayBegin(struct Replay *r, const struct Course *course, uint16_t flags)
+{
+	r->seed = course->seed;
+	r->hz = SIM_HZ;
+	r->w = course->w;
+	r->d = course->d;
+	r->n_obs = course->obs.size();
+	r->interval = REPLAY_INTERVAL;
+	r->flags = flags | (course->maze ? REPLAY_MAZE : 0);
+	r->inputs.clear();
+	r->checks.clear();
+	r->chain = CHAIN_SEED;
+	r->final_hash = r->chain;
+	r->pos = 0;
+}
+
+void replayRecord(struct Replay *r, unsigned input, const struct SimState *s)
+{
+	r->inputs.push_back((uint8_t)input);
+	r->chain = hashChain(r->chain, simHash(s));
+	if(r->inputs.size() % r->interval == 0)
+		r->checks.push_back(r->chain);
+	r->final_hash = r->chain;
+}
+
+/* Little endian writers / readers */
+
+static void put16(std::vector<uint8_t> &out, uint16_t v)
+{
+	out.push_back(v & 0xff);
+	out.push_back(v >> 8);
+}
+
+static void put32(std::vector<uint8_t> &out, uint32_t v)
+{
+	put16(out, v & 0xffff);
+	put16(out, v >> 16);
+}
+
+static void put64(std::vector<uint8_t> &out, uint64_t v)
+{
+	put32(out, (uint32_t)v);
+	put32(out, (uint32_t)(v >> 32));
+}
+
+static void putVarint(std::vector<uint8_t> &out, uint32_t v)
+{
+	while(v >= 0x80)
+	{
+		out.push_back((v & 0x7f) | 0x80);
+		v >>= 7;
+	}
+	out.push_back(v);
+}
+
+struct Reader {
+	const uint8_t *p;
+	const uint8_t *end;
+	bool ok;
+};
+
+static uint8_t get8(struct Reader *rd)
+{
+	if(rd->p >= rd->end)
+	{
+		rd->ok = false;
+		return 0;
+	}
+	return *rd->p++;
+}
+
+static uint16_t get16(struct Reader *rd)
+{
+	uint16_t lo = get8(rd);
+	return lo | (get8(rd) << 8);
+}
+
+static uint32_t get32(struct Reader *rd)
+{
+	uint32_t lo = get16(rd);
+	return lo | ((uint32_t)get16(rd) << 16);
+}
+
+static uint64_t get64(struct Reader *rd)
+{
+	uint64_t lo = get32(rd);
+	return lo | ((uint64_t)get32(rd) << 32);
+}
+
+static uint32_t getVarint(struct Reader *rd)
+{
+	uint32_t v = 0;
+	int shift = 0;
+	uint8_t c;
+
+	do {
+		c = get8(rd);
+		if(shift > 28)
+		{
+			rd->ok = false;
+			return 0;
+		}
+		v |= (uint32_t)(c & 0x7f) << shift;
+		shift += 7;
+	} while(rd->ok && (c & 0x80));
+	return v;
+}
+
+bool replaySave(const struct Replay *r, const char *path)
+{
+	std::vector<uint8_t> out;
+	std::vector<uint8_t> runs;
+	uint32_t nruns = 0;
+	size_t i, j;
+	FILE *f;
+
+	out.insert(out.end(), REPLAY_MAGIC, REPLAY_MAGIC + 4);
+	put16(out, REPLAY_VERSION);
+	put16(out, r->hz);
+	put32(out, r->seed);
+	put16(out, r->w);
+	put16(out, r->d);
+	put16(out, r->n_obs);
+	put16(out, r->interval);
+	put16(out, r->flags);
+	put32(out, (uint32_t)r->inputs.size());
+
+	for(i=0; i < r->inputs.size(); i = j)
+	{
+		for(j=i; j < r->inputs.size() && r->inputs[j] == r->inputs[i]; j++)
+			;
+		runs.push_back(r->inputs[i]);
+		putVarint(runs, (uint32_t)(j - i));
+		nruns++;
+	}
+	put32(out, nruns);
+	out.insert(out.end(), runs.begin(), runs.end());
+
+	put32(out, (uint32_t)r->checks.size());
+	for(i=0; i < r->checks.size(); i++)
+		put64(out, r->checks[i]);
+	put64(out, r->final_hash);
+
+	f = fopen(path, "wb");
+	if(!f)
+	{
+		fprintf(stderr, "Cannot write replay %s\n", path);
+		return false;
+	}
+	if(fwrite(&out[0], 1, out.size(), f) != out.size())
+	{
+		fprintf(stderr, "Short write on replay %s\n", path);
+		fclose(f);
+		return false;
+	}
+	fclose(f);
+	return true;
+}
+
+bool replayLoad(struct Replay *r, const char *path, uint32_t max_ticks)
+{
+	std::vector<uint8_t> data;
+	struct Reader rd;
+	uint32_t ticks, nruns, nchecks, i;
+	uint16_t version;
+	uint8_t buf[4096];
+	size_t n;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if(!f)
+	{
+		fprintf(stderr, "Cannot open replay %s\n", path);
+		return false;
+	}
+	while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		data.insert(data.end(), buf, buf + n);
+	fclose(f);
+
+	if(data.size() < 4 || memcmp(&data[0], REPLAY_MAGIC, 4) != 0)
+	{
+		fprintf(stderr, "%s is not a replay\n", path);
+		return false;
+	}
+	rd.p = &data[4];
+	rd.end = &data[0] + data.size();
+	rd.ok = true;
+
+	version = get16(&rd);
+	if(version != REPLAY_VERSION)
+	{
+		fprintf(stderr, "%s: unsupported replay version %d\n", path, version);
+		return false;
+	}
+	r->hz = get16(&rd);
+	r->seed = get32(&rd);
+	r->w = get16(&rd);
+	r->d = get16(&rd);
+	r->n_obs = get16(&rd);
+	r->interval = get16(&rd);
+	r->flags = get16(&rd);
+	ticks = get32(&rd);
+	r->ticks = ticks;
+	if(r->hz != SIM_HZ || r->interval == 0)
+	{
+		fprintf(stderr, "%s: recorded at %d Hz, interval %d\n", path, r->hz, r->interval);
+		return false;
+	}
+	if(ticks > max_ticks)
+	{
+		fprintf(stderr, "%s: %u ticks, more than the %u allowed\n", path, ticks, max_ticks);
+		return false;
+	}
+
+	r->inputs.clear();
+	nruns = get32(&rd);
+	if(nruns > ticks)
+		rd.ok = false;
+	else
+		r->inputs.reserve(ticks);
+	for(i=0; i < nruns && rd.ok; i++)
+	{
+		uint8_t mask = get8(&rd);
+		uint32_t len = getVarint(&rd);
+		if(len > ticks - r->inputs.size())
+			rd.ok = false;
+		else
+			r->inputs.insert(r->inputs.end(), len, mask);
+	}
+
+	r->checks.clear();
+	nchecks = get32(&rd);
+	if(nchecks != ticks / r->interval)
+		rd.ok = false;
+	for(i=0; i < nchecks && rd.ok; i++)
+		r->checks.push_back(get64(&rd));
+	r->final_hash = get64(&rd);
+
+	if(!rd.ok || r->inputs.size() != ticks)
+	{
+		fprintf(stderr, "%s: truncated or corrupt replay\n", path);
+		return false;
+	}
+	return true;
+}
+
+void replayCourse(const struct Replay *r, struct Course *course)
+{
+	if(r->flags & REPLAY_MAZE)
+		generateMazeCourse(course, r->seed, r->w, r->d);
+	else
+		generateCourse(course, r->seed, r->w, r->d);
+}
+
+void replayStart(struct Replay *r, struct Course *course, struct SimState *s)
+{
+	replayCourse(r, course);
+	simReset(s, course);
+	r->chain = CHAIN_SEED;
+	r->pos = 0;
+}
+
+bool replayCheck(struct Replay *r, const struct SimState *s)
+{
+	uint32_t n = ++r->pos;
+
+	r->chain = hashChain(r->chain, simHash(s));
+	if(n % r->interval == 0 && r->checks[n / r->interval - 1] != r->chain)
+		return false;
+	if(n == r->inputs.size() && r->final_hash != r->chain)
+		return false;
+	return true;
+}
+
+long replayRun(struct Replay *r, struct Course *course, struct SimState *s)
+{
+	struct Rewind *rw = NULL;
+	long bad = -1;
+
+	replayStart(r, course, s);
+	if(r->flags & REPLAY_REWIND)
+	{
+		rw = new struct Rewind;
+		rewindReset(rw, s);
+	}
+	while(r->pos < r->inputs.size())
+	{
+		rewindStep(rw, s, course, r->inputs[r->pos]);
+		if(!replayCheck(r, s))
+		{
+			bad = (long)r->pos;
+			break;
+		}
+	}
+	delete rw;
+	return bad;
+}
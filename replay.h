@@ -0,0 +1,71 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "sim.h"
+
+/* Replay file layout (little endian):
+ *
+ *   "MZRP"            magic
+ *   u16 version       REPLAY_VERSION
+ *   u16 hz            simulation rate the run was recorded at
+ *   u32 seed          course seed
+ *   u16 w, d, n_obs   course size and obstacle count
+ *   u16 interval      ticks between hash checkpoints
+ *   u16 flags         REPLAY_REWIND if dying rewound instead of respawning,
+ *                     REPLAY_MAZE if the course is a maze
+ *   u32 ticks         number of recorded ticks
+ *   u32 nruns         followed by nruns x (u8 input mask, varint run length)
+ *   u32 nchecks       followed by nchecks x u64 chained state hash
+ *   u64 final         chained state hash after the last tick
+ *
+ * The state hash is chained every tick, so a checkpoint catches any
+ * divergence in the ticks before it.
+ */
+#define REPLAY_MAGIC "MZRP"
+#define REPLAY_VERSION 8
+#define REPLAY_INTERVAL 60
+#define REPLAY_MAX_TICKS (24 * 3600 * SIM_HZ)  // a day of play, the most the game loads
+
+/* Replay flags */
+#define REPLAY_REWIND 1
+#define REPLAY_MAZE 2
+
+struct Replay {
+	uint32_t seed;
+	uint16_t hz;
+	uint16_t w, d, n_obs;
+	uint16_t interval;
+	uint32_t ticks;                // as the header gives them, kept if that is too many
+	uint16_t flags;
+	std::vector<uint8_t> inputs;   // one mask per tick, expanded in memory
+	std::vector<uint64_t> checks;  // chain value every interval ticks
+	uint64_t final_hash;
+	uint64_t chain;                // running chain while recording / playing
+	uint32_t pos;                  // playback cursor, ticks consumed so far
+};
+
+void replayBegin(struct Replay *r, const struct Course *course, uint16_t flags);
+void replayRecord(struct Replay *r, unsigned input, const struct SimState *s);
+bool replaySave(const struct Replay *r, const char *path);
+/* Fails on anything malformed, and on more than max_ticks before any
+   input is expanded, so a small file can't claim gigabytes */
+bool replayLoad(struct Replay *r, const char *path, uint32_t max_ticks);
+
+/* Rebuild the course the replay was recorded on from its header */
+void replayCourse(const struct Replay *r, struct Course *course);
+
+/* Playback. replayStart resets the course and state from the replay header.
+   Feed r->inputs[r->pos] to simStep, then call replayCheck, which advances
+   the cursor and returns false as soon as the chained hash disagrees with a
+   recorded checkpoint. */
+void replayStart(struct Replay *r, struct Course *course, struct SimState *s);
+bool replayCheck(struct Replay *r, const struct SimState *s);
+
+/* Run a whole replay without rendering. Returns the tick at which a
+   divergence was detected, or -1 if it matched all the way through. */
+long replayRun(struct Replay *r, struct Course *course, struct SimState *s);
+
+#endif
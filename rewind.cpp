@@ -0,0 +1,134 @@
+#include <string.h>
+
+#include "rewind.h"
+
+static_assert(sizeof(struct SimState) % 4 == 0, "SimState must be whole words");
+static_assert(REWIND_WORDS <= 32, "delta mask is 32 bits");
+static_assert(REWIND_TICKS % REWIND_KEY_EVERY == 0, "keyframes must tile the history");
+
+static uint32_t deltaSize(const uint8_t *p)
+{
+	uint32_t mask;
+
+	memcpy(&mask, p, 4);
+	return 4 + 4 * __builtin_popcount(mask);
+}
+
+void rewindReset(struct Rewind *rw, const struct SimState *s)
+{
+	rw->next = 0;
+	rw->count = 0;
+	rw->head = 0;
+	rewindPush(rw, s);
+}
+
+void rewindPush(struct Rewind *rw, const struct SimState *s)
+{
+	uint32_t seq = rw->next;
+	struct SimState *key = &rw->keys[(seq / REWIND_KEY_EVERY) % REWIND_KEYS];
+	uint32_t words[REWIND_WORDS], kwords[REWIND_WORDS];
+	uint32_t mask = 0, n = 4, pos, i;
+
+	if(seq % REWIND_KEY_EVERY == 0)
+		*key = *s;
+
+	memcpy(words, s, sizeof(words));
+	memcpy(kwords, key, sizeof(kwords));
+	for(i=0; i < REWIND_WORDS; i++)
+		if(words[i] != kwords[i])
+		{
+			mask |= 1u << i;
+			n += 4;
+		}
+
+	/* Make room: the slot for seq, and any old deltas the write would overlap */
+	if(rw->count == REWIND_TICKS)
+		rw->count--;
+
+	/* Entries never straddle the end of the ring. When the write wraps, the
+	   skipped tail holds the oldest deltas, so they go first. */
+	pos = rw->head;
+	if(pos + n > REWIND_RING)
+	{
+		while(rw->count > 0 && rw->off[(seq - rw->count) % REWIND_TICKS] >= rw->head)
+			rw->count--;
+		pos = 0;
+	}
+	while(rw->count > 0)
+	{
+		uint32_t old = rw->off[(seq - rw->count) % REWIND_TICKS];
+		uint32_t end = old + deltaSize(&rw->ring[old]);
+		if(old >= pos + n || end <= pos)
+			break;
+		rw->count--;
+	}
+
+	memcpy(&rw->ring[pos], &mask, 4);
+	for(i=0, n=4; i < REWIND_WORDS; i++)
+		if(mask & (1u << i))
+		{
+			memcpy(&rw->ring[pos + n], &words[i], 4);
+			n += 4;
+		}
+
+	rw->off[seq % REWIND_TICKS] = pos;
+	rw->head = pos + n;
+	rw->next = seq + 1;
+	rw->count++;
+}
+
+uint32_t rewindRestore(struct Rewind *rw, uint32_t back, struct SimState *s)
+{
+	uint32_t steps = s->steps, deaths = s->deaths;
+	uint32_t seq, mask, i, n = 4;
+	uint32_t words[REWIND_WORDS];
+	const uint8_t *p;
+
+	if(rw->count == 0)
+		return 0;
+	if(back > rw->count - 1)
+		back = rw->count - 1;
+	seq = rw->next - 1 - back;
+
+	memcpy(words, &rw->keys[(seq / REWIND_KEY_EVERY) % REWIND_KEYS], sizeof(words));
+	p = &rw->ring[rw->off[seq % REWIND_TICKS]];
+	memcpy(&mask, p, 4);
+	for(i=0; i < REWIND_WORDS; i++)
+		if(mask & (1u << i))
+		{
+			memcpy(&words[i], p + n, 4);
+			n += 4;
+		}
+	memcpy(s, words, sizeof(words));
+	s->steps = steps;
+	s->deaths = deaths;
+
+	/* Forget the future: the next push continues right after seq */
+	rw->head = rw->off[seq % REWIND_TICKS] + n;
+	rw->count -= back;
+	rw->next = seq + 1;
+	return back;
+}
+
+size_t rewindBytesUsed(const struct Rewind *rw)
+{
+	size_t bytes = 0;
+	uint32_t i;
+
+	for(i=1; i <= rw->count; i++)
+		bytes += deltaSize(&rw->ring[rw->off[(rw->next - i) % REWIND_TICKS]]);
+	return bytes;
+}
+
+int rewindStep(struct Rewind *rw, struct SimState *s, const struct Course *course, unsigned input)
+{
+	int ev = simStep(s, course, input);
+
+	if(!rw)
+		return ev;
+	if(ev & SIM_EV_DIED)
+		rewindRestore(rw, REWIND_ON_DEATH, s);
+	else
+		rewindPush(rw, s);
+	return ev;
+}
@@ -0,0 +1,52 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+/* Rewind history. Every tick's SimState is kept for REWIND_TICKS ticks:
+ * a full keyframe every REWIND_KEY_EVERY ticks, and for every tick a delta
+ * against the keyframe of its group (a mask of changed 32 bit words followed
+ * by those words). Deltas are packed into a fixed byte ring, so restoring
+ * any tick is one keyframe copy plus one delta, and memory never grows.
+ *
+ * If the ring ever fills before REWIND_TICKS ticks are held, the oldest
+ * ticks are dropped and the history just gets shorter.
+ */
+#define REWIND_SECONDS 10
+#define REWIND_TICKS (REWIND_SECONDS * SIM_HZ)
+#define REWIND_KEY_EVERY 60
+#define REWIND_KEYS (REWIND_TICKS / REWIND_KEY_EVERY + 1)
+#define REWIND_WORDS (sizeof(struct SimState) / 4)
+#define REWIND_RING (64 * 1024)
+
+/* How far back dying takes the player */
+#define REWIND_ON_DEATH (3 * SIM_HZ)
+
+struct Rewind {
+	uint32_t next;                // sequence number of the next pushed tick
+	uint32_t count;               // ticks currently held, ending at next-1
+	uint32_t head;                // next write offset in ring
+	uint32_t off[REWIND_TICKS];   // ring offset of each held tick's delta
+	struct SimState keys[REWIND_KEYS];
+	uint8_t ring[REWIND_RING];
+};
+
+void rewindReset(struct Rewind *rw, const struct SimState *s);
+void rewindPush(struct Rewind *rw, const struct SimState *s);
+
+/* Restore the state from 'back' ticks ago (clamped to the oldest held tick)
+   and forget everything after it. The run clock and the death count are
+   left alone. Returns the number of ticks actually rewound. */
+uint32_t rewindRestore(struct Rewind *rw, uint32_t back, struct SimState *s);
+
+/* Bytes of delta data currently held. The whole buffer is sizeof(struct Rewind). */
+size_t rewindBytesUsed(const struct Rewind *rw);
+
+/* simStep with the rewind rule: dying rewinds REWIND_ON_DEATH ticks instead
+   of respawning. rw may be NULL, which gives plain simStep behaviour. */
+int rewindStep(struct Rewind *rw, struct SimState *s, const struct Course *course, unsigned input);
+
+#endif
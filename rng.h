@@ -0,0 +1,52 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/* PCG32 (O'Neill, pcg-random.org): 64 bit state, 32 bit output, a few
+   cycles per number and the same sequence on every platform, unlike rand().
+   Different stream numbers give independent sequences from one seed. */
+struct Pcg32 {
+	uint64_t state;
+	uint64_t inc;
+};
+
+static inline uint32_t pcgNext(struct Pcg32 *r)
+{
+	uint64_t old = r->state;
+	uint32_t xorshifted, rot;
+
+	r->state = old * 6364136223846793005ULL + r->inc;
+	xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+	rot = (uint32_t)(old >> 59);
+	return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+static inline void pcgSeed(struct Pcg32 *r, uint64_t seed, uint64_t stream)
+{
+	r->state = 0;
+	r->inc = (stream << 1) | 1;
+	pcgNext(r);
+	r->state += seed;
+	pcgNext(r);
+}
+
+/* Uniform in [0, n) without modulo bias (Lemire's multiply-shift) */
+static inline uint32_t pcgRange(struct Pcg32 *r, uint32_t n)
+{
+	uint64_t m = (uint64_t)pcgNext(r) * n;
+	uint32_t lo = (uint32_t)m;
+
+	if(lo < n)
+	{
+		uint32_t t = -n % n;
+		while(lo < t)
+		{
+			m = (uint64_t)pcgNext(r) * n;
+			lo = (uint32_t)m;
+		}
+	}
+	return (uint32_t)(m >> 32);
+}
+
+#endif
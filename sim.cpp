@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sim.h"
+
+void simReset(struct SimState *s, const struct Course *course)
+{
+	memset(s, 0, sizeof(*s));
+	s->x_cuboid = course->spawn_x;
+	s->y_cuboid = FLOOR_TOP;
+	s->z_cuboid = course->spawn_z;
+	s->grounded = 1;
+}
+
+static void die(struct SimState *s, const struct Course *course)
+{
+	s->x_cuboid = course->spawn_x;
+	s->z_cuboid = course->spawn_z;
+	s->y_cuboid = FLOOR_TOP;
+	s->vy_cuboid = 0;
+	s->grounded = 1;
+	s->deaths++;
+}
+
+float simGround(const struct Course *course, int i, int k, uint32_t tick)
+{
+	unsigned f = colCell(&course->index, i, k);
+
+	if(f & COL_FLOOR)
+		return FLOOR_TOP;
+	if(f & COL_MOVING)
+		return movingFloorHeight(tick) + 1;
+	return -INFINITY;
+}
+
+/* Advance the world by one tick */
+int simStep(struct SimState *s, const struct Course *course, unsigned input)
+{
+	const float step = MOVE_SPEED / SIM_HZ, dt = 1.0f / SIM_HZ;
+	const struct CollisionIndex *ci = &course->index;
+	struct ColHit hit;
+	float dx = 0, dz = 0, ground;
+
+	if(s->finished)
+		return 0;
+	s->steps++;
+	s->tick++;
+
+	if(input & IN_UP)
+		dz -= step;
+	if(input & IN_DOWN)
+		dz += step;
+	if(input & IN_RIGHT)
+		dx += step;
+	if(input & IN_LEFT)
+		dx -= step;
+
+	/* The move is swept, so however far it goes nothing is skipped. A
+	   moving tile standing more than a step above the feet is a wall to
+	   the middle of the player, and the inset box must not run into an
+	   obstacle unless it is above it. */
+	if((movingFloorHeight(s->tick) + 1 > s->y_cuboid + MOVING_STEP &&
+				colSweepPoint(ci, s->x_cuboid + 0.5f, s->z_cuboid + 0.5f, dx, dz, COL_MOVING, COL_MOVING, &hit)) ||
+			(s->y_cuboid < OBSTACLE_TOP &&
+				colSweepBox(ci, s->x_cuboid + HIT_INSET, s->z_cuboid + HIT_INSET, s->x_cuboid + 1 - HIT_INSET,
+					s->z_cuboid + 1 - HIT_INSET, dx, dz, COL_OBSTACLE, COL_OBSTACLE, &hit)))
+	{
+		die(s, course);
+		return SIM_EV_DIED;
+	}
+	s->x_cuboid += dx;
+	s->z_cuboid += dz;
+
+	/* The ground under the middle of the player holds them up. Walking,
+	   they follow it up a step or down a little; off the edge of it, or
+	   jumping, they fly with semi-implicit Euler until they come down on
+	   something or into the water. */
+	ground = simGround(course, (int)floorf(s->x_cuboid + 0.5f), (int)floorf(s->z_cuboid + 0.5f), s->tick);
+	if(s->grounded && (input & IN_JUMP))
+	{
+		s->vy_cuboid = JUMP_SPEED;
+		s->grounded = 0;
+	}
+	else if(s->grounded && ground < s->y_cuboid - SNAP_DOWN)
+		s->grounded = 0;
+	if(!s->grounded)
+	{
+		s->vy_cuboid -= GRAVITY * dt;
+		s->y_cuboid += s->vy_cuboid * dt;
+	}
+	if(ground - s->y_cuboid > MOVING_STEP)
+	{
+		die(s, course);
+		return SIM_EV_DIED;
+	}
+	if(s->grounded || (s->y_cuboid <= ground && s->vy_cuboid <= 0))
+	{
+		s->y_cuboid = ground;
+		s->vy_cuboid = 0;
+		s->grounded = 1;
+	}
+	if(s->y_cuboid < WATER_TOP)
+	{
+		die(s, course);
+		return SIM_EV_DIED;
+	}
+
+	if(s->z_cuboid < GOAL_Z)
+	{
+		s->finished = 1;
+		s->finish_tick = s->steps;
+		return SIM_EV_FINISHED;
+	}
+	return 0;
+}
+
+static uint64_t fnv(uint64_t h, const void *data, size_t len)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	size_t i;
+
+	for(i=0; i<len; i++)
+	{
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+uint64_t simHash(const struct SimState *s)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	/* field by field so struct padding never leaks into the hash */
+	h = fnv(h, &s->steps, sizeof(s->steps));
+	h = fnv(h, &s->tick, sizeof(s->tick));
+	h = fnv(h, &s->x_cuboid, sizeof(s->x_cuboid));
+	h = fnv(h, &s->y_cuboid, sizeof(s->y_cuboid));
+	h = fnv(h, &s->z_cuboid, sizeof(s->z_cuboid));
+	h = fnv(h, &s->vy_cuboid, sizeof(s->vy_cuboid));
+	h = fnv(h, &s->grounded, sizeof(s->grounded));
+	h = fnv(h, &s->deaths, sizeof(s->deaths));
+	h = fnv(h, &s->finished, sizeof(s->finished));
+	h = fnv(h, &s->finish_tick, sizeof(s->finish_tick));
+	return h;
+}
+
+uint64_t hashChain(uint64_t chain, uint64_t h)
+{
+	return fnv(chain, &h, sizeof(h));
+}
@@ -0,0 +1,77 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+#include "course.h"
+
+/* Fixed simulation rate. The world only ever advances in whole ticks, so a
+   run is fully described by the course seed and one input mask per tick. */
+#define SIM_HZ 120
+
+/* Player speed in units per second while an arrow key is held */
+#define MOVE_SPEED 3.0f
+
+/* The player is a unit cube at (x_cuboid, z_cuboid) to (x_cuboid+1,
+   z_cuboid+1). Obstacles kill when they overlap it by more than this, so
+   brushing past one, or float drift along a wall, is forgiven. */
+#define HIT_INSET 0.1f
+
+/* Vertical motion, in units and seconds. y_cuboid is the height of the
+   player's feet, 0 on the floor. A jump clears a one cell pit but not an
+   obstacle. */
+#define GRAVITY 25.0f
+#define JUMP_SPEED 7.5f
+#define FLOOR_TOP (FARSH_Y + 1)
+#define OBSTACLE_TOP (FLOOR_TOP + 1)
+
+/* Feet below the water's surface have drowned */
+#define WATER_TOP -2.0f
+
+/* A walking player stays on ground that drops away by no more than this
+   in a tick, so a sinking tile can be ridden. More, and they fall. */
+#define SNAP_DOWN 0.05f
+
+/* The run is complete once the player reaches the far row of the course */
+#define GOAL_Z 0.5f
+
+/* Per-tick input bitmask */
+enum {
+	IN_UP    = 1 << 0,
+	IN_DOWN  = 1 << 1,
+	IN_RIGHT = 1 << 2,
+	IN_LEFT  = 1 << 3,
+	IN_JUMP  = 1 << 4
+};
+
+/* Events reported by simStep */
+enum {
+	SIM_EV_DIED = 1 << 0,
+	SIM_EV_FINISHED = 1 << 1
+};
+
+struct SimState {
+	uint32_t steps;       // ticks played, never rewound - this is the run's clock
+	uint32_t tick;        // world time, drives the moving floor
+	float x_cuboid;
+	float y_cuboid;
+	float z_cuboid;
+	float vy_cuboid;      // vertical speed, units per second
+	int grounded;         // standing on something rather than in the air
+	uint32_t deaths;
+	int finished;         // once set the world stops advancing
+	uint32_t finish_tick; // steps taken to finish
+};
+
+void simReset(struct SimState *s, const struct Course *course);
+int simStep(struct SimState *s, const struct Course *course, unsigned input);
+
+/* Top of the ground on cell (i, k) at 'tick', or -INFINITY over a pit. It
+   is a single collision index lookup, whatever the size of the course. */
+float simGround(const struct Course *course, int i, int k, uint32_t tick);
+
+/* 64 bit FNV-1a over the state, chained tick by tick for replay checks */
+uint64_t simHash(const struct SimState *s);
+uint64_t hashChain(uint64_t chain, uint64_t h);
+
+#endif
@@ -0,0 +1,244 @@
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "solve.h"
+
+static_assert((2 * FARSH_M_LEG) % CELL_TICKS == 0, "moving tile cycle must be whole cell steps");
+
+#define DIFFICULTY_CROSSING 4
+
+enum { CELL_BLOCKED, CELL_STATIC, CELL_MOVING };
+
+/* The walkable window is one interval per leg, so checking both ends of
+   the step is enough */
+bool phaseWalkable(int p)
+{
+	return movingWalkable(p * CELL_TICKS) && movingWalkable(p * CELL_TICKS + CELL_TICKS - 1);
+}
+
+static void classify(const struct Course *c, std::vector<uint8_t> &cell)
+{
+	size_t n;
+
+	cell.resize((size_t)c->w * c->d);
+	for(n=0; n < cell.size(); n++)
+		cell[n] = c->tiles[n] == TILE_FLOOR ? CELL_STATIC : c->tiles[n] == TILE_MOVING ? CELL_MOVING : CELL_BLOCKED;
+	for(n=0; n < c->obs.size(); n++)
+		cell[(size_t)c->obs[n].z * c->w + c->obs[n].x] = CELL_BLOCKED;
+}
+
+/* 0-1 BFS from spawn to row 0 where entering a cell costs cost[kind], and
+   kinds with a negative cost can't be entered. Returns the cost, or -1 if
+   row 0 can't be reached at all. The cheapest row 0 cell goes in *goal
+   and the predecessor of every reached cell in 'from'. */
+static int cheapestRoute(const struct Course *c, const std::vector<uint8_t> &cell, const int cost[3], std::vector<int> &from, int *goal)
+{
+	static const int di[4] = { 1, -1, 0, 0 }, dk[4] = { 0, 0, 1, -1 };
+	std::vector<int> dist(cell.size(), -1);
+	std::deque<int> q;
+	int start = c->spawn_z * c->w + c->spawn_x;
+	int best = -1, j;
+
+	from.assign(cell.size(), -1);
+	dist[start] = 0;
+	q.push_back(start);
+	while(!q.empty())
+	{
+		int at = q.front(), i = at % c->w, k = at / c->w;
+		q.pop_front();
+		if(k == 0 && (best < 0 || dist[at] < best))
+		{
+			best = dist[at];
+			*goal = at;
+		}
+		for(j=0; j < 4; j++)
+		{
+			int ni = i + di[j], nk = k + dk[j], n, nd;
+			if(ni < 0 || ni >= c->w || nk < 0 || nk >= c->d)
+				continue;
+			n = nk * c->w + ni;
+			if(cost[cell[n]] < 0)
+				continue;
+			nd = dist[at] + cost[cell[n]];
+			if(dist[n] >= 0 && dist[n] <= nd)
+				continue;
+			dist[n] = nd;
+			from[n] = at;
+			if(cost[cell[n]] == 0)
+				q.push_front(n);
+			else
+				q.push_back(n);
+		}
+	}
+	return best;
+}
+
+bool analyseCourse(const struct Course *c, struct CourseStats *stats)
+{
+	static const int di[5] = { 0, 1, -1, 0, 0 }, dk[5] = { 0, 0, 0, 1, -1 };
+	static const int crossing_cost[3] = { -1, 0, 1 };
+	std::vector<uint8_t> cell;
+	std::vector<uint8_t> seen;
+	std::vector<int> from;
+	bool walk[PHASES];
+	size_t head = 0;
+	int p, j, goal;
+
+	classify(c, cell);
+	for(p=0; p < PHASES; p++)
+		walk[p] = phaseWalkable(p);
+
+	/* Breadth first over (cell, phase): the first time a cell of row 0 is
+	   popped is the earliest arrival. Waiting in place is a move too. */
+	std::vector<int> q;
+	int start = c->spawn_z * c->w + c->spawn_x;
+	seen.assign(cell.size() * PHASES, 0);
+	seen[(size_t)start * PHASES] = 1;
+	q.push_back(start * PHASES);
+	q.push_back(0);   // time
+	stats->solvable = 0;
+	stats->time = -1;
+	while(head < q.size())
+	{
+		int st = q[head++], t = q[head++];
+		int at = st / PHASES, i = at % c->w, k = at / c->w;
+		int np = (st % PHASES + 1) % PHASES;
+		if(k == 0)
+		{
+			stats->solvable = 1;
+			stats->time = t;
+			break;
+		}
+		for(j=0; j < 5; j++)
+		{
+			int ni = i + di[j], nk = k + dk[j], n;
+			size_t ns;
+			if(ni < 0 || ni >= c->w || nk < 0 || nk >= c->d)
+				continue;
+			n = nk * c->w + ni;
+			if(cell[n] == CELL_BLOCKED || (cell[n] == CELL_MOVING && !walk[np]))
+				continue;
+			ns = (size_t)n * PHASES + np;
+			if(seen[ns])
+				continue;
+			seen[ns] = 1;
+			q.push_back((int)ns);
+			q.push_back(t + 1);
+		}
+	}
+
+	stats->crossings = stats->solvable ? cheapestRoute(c, cell, crossing_cost, from, &goal) : -1;
+	return stats->solvable;
+}
+
+int repairCourse(struct Course *c)
+{
+	static const int clear_blocked[3] = { 1, 0, 0 };
+	static const int clear_moving[3] = { 1, 0, 1 };
+	std::vector<uint8_t> cell;
+	std::vector<int> from;
+	struct CourseStats stats;
+	int changed = 0, pass, at, goal, i;
+
+	/* First clear only pits and obstacles. If the moving tiles on that route
+	   still can't be timed, clear the cheapest route of those as well. */
+	for(pass=0; pass < 2 && !analyseCourse(c, &stats); pass++)
+	{
+		classify(c, cell);
+		cheapestRoute(c, cell, pass == 0 ? clear_blocked : clear_moving, from, &goal);
+		for(at = goal; at >= 0; at = from[at])
+		{
+			if(cell[at] == CELL_STATIC)
+				continue;
+			if(pass == 0 && cell[at] == CELL_MOVING)
+				continue;
+			c->tiles[at] = TILE_FLOOR;
+			for(i=0; i < (int)c->obs.size(); i++)
+				if(c->obs[i].z * c->w + c->obs[i].x == at)
+					c->obs.erase(c->obs.begin() + i--);
+			changed++;
+		}
+	}
+	return changed;
+}
+
+int courseDifficulty(const struct CourseStats *stats)
+{
+	return stats->time + DIFFICULTY_CROSSING * stats->crossings;
+}
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* Seed of candidate n, spread so neighbouring candidates share nothing */
+static uint32_t candidateSeed(uint32_t seed, int n)
+{
+	uint64_t x = ((uint64_t)seed << 32 | (uint32_t)n) * 0x9e3779b97f4a7c15ULL;
+	return (uint32_t)(x >> 32) ^ (uint32_t)x;
+}
+
+void pickCourse(struct Course *out, uint32_t seed, int w, int d, int candidates, int target, int threads, struct GenStats *gs)
+{
+	struct Best {
+		int score;
+		int n;
+	};
+	std::vector<struct Best> best;
+	std::vector<std::thread> workers;
+	std::atomic<int> next(0), repaired(0);
+	double t0 = now();
+	int t;
+
+	if(threads < 1)
+		threads = 1;
+	best.resize(threads);
+	for(t=0; t < threads; t++)
+	{
+		best[t].score = -1;
+		best[t].n = -1;
+		workers.push_back(std::thread([&, t]() {
+			struct Course c;
+			struct CourseStats stats;
+			int n;
+			while((n = next++) < candidates)
+			{
+				if(generateCourse(&c, candidateSeed(seed, n), w, d) > 0)
+					repaired++;
+				analyseCourse(&c, &stats);
+				int score = abs(courseDifficulty(&stats) - target);
+				if(best[t].n < 0 || score < best[t].score || (score == best[t].score && n < best[t].n))
+				{
+					best[t].score = score;
+					best[t].n = n;
+				}
+			}
+		}));
+	}
+	for(t=0; t < threads; t++)
+		workers[t].join();
+
+	/* Lowest score wins, ties go to the lowest candidate, whatever thread found it */
+	struct Best win = best[0];
+	for(t=1; t < threads; t++)
+		if(best[t].n >= 0 && (win.n < 0 || best[t].score < win.score || (best[t].score == win.score && best[t].n < win.n)))
+			win = best[t];
+	generateCourse(out, candidateSeed(seed, win.n < 0 ? 0 : win.n), w, d);
+
+	if(gs)
+	{
+		gs->candidates = candidates;
+		gs->repaired = repaired;
+		gs->threads = threads;
+		gs->seconds = now() - t0;
+	}
+}
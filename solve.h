@@ -0,0 +1,52 @@
+#ifndef SOLVE_H
+#define SOLVE_H
+
+#include <stdint.h>
+
+#include "course.h"
+#include "sim.h"
+
+/* Course validation works on whole cells: a cell is blocked (pit or
+ * obstacle), static floor, or a moving tile that can only be stood on while
+ * it is near floor height. Crossing one cell takes CELL_TICKS, so time is
+ * counted in steps of CELL_TICKS and the moving tile cycle is PHASES steps
+ * long. The search runs over (cell, phase) with waiting allowed, so a route
+ * that has to wait for a moving tile to come up is still found.
+ */
+#define CELL_TICKS ((int)(SIM_HZ / MOVE_SPEED))
+#define PHASES (2 * FARSH_M_LEG / CELL_TICKS)
+
+/* Moving tiles can be stood on for the whole cell step starting at phase p */
+bool phaseWalkable(int p);
+
+struct CourseStats {
+	int solvable;
+	int time;       // fewest cell steps from spawn to the far row, waits included
+	int crossings;  // fewest moving tiles any route to the far row has to cross
+};
+
+/* Analyse a course. Returns stats->solvable. */
+bool analyseCourse(const struct Course *course, struct CourseStats *stats);
+
+/* Clear the pits and obstacles (and, if the timing still fails, the moving
+   tiles) along the cheapest route to the far row so the course is always
+   solvable. Returns the number of cells changed. */
+int repairCourse(struct Course *course);
+
+/* How hard a course is: route time plus a penalty per forced crossing */
+int courseDifficulty(const struct CourseStats *stats);
+
+struct GenStats {
+	int candidates;
+	int repaired;   // candidates that were unsolvable as generated
+	int threads;
+	double seconds;
+};
+
+/* Generate 'candidates' courses from seeds derived from 'seed' on 'threads'
+   workers and keep the one whose difficulty is closest to 'target'. The
+   result only depends on seed, size, candidates and target, not on the
+   number of threads. */
+void pickCourse(struct Course *out, uint32_t seed, int w, int d, int candidates, int target, int threads, struct GenStats *gs);
+
+#endif
@@ -0,0 +1,132 @@
+#include <algorithm>
+
+#include "sparse.h"
+
+static void tableInit(struct SparseWorld *sw, int bits)
+{
+	struct SparseEntry free_entry = { 0, SPARSE_FREE, 0 };
+
+	sw->table.assign((size_t)1 << bits, free_entry);
+	sw->shift = 64 - bits;
+}
+
+void sparseInit(struct SparseWorld *sw)
+{
+	tableInit(sw, 4);
+	sw->chunks = 0;
+	sw->data.clear();
+}
+
+static void tableInsert(struct SparseWorld *sw, uint64_t key, uint32_t chunk)
+{
+	size_t mask = sw->table.size() - 1, i = sparseHash(sw, key);
+
+	while(sw->table[i].chunk != SPARSE_FREE)
+		i = (i + 1) & mask;
+	sw->table[i].key = key;
+	sw->table[i].chunk = chunk;
+}
+
+/* Double the table, which keeps it at most half full */
+static void grow(struct SparseWorld *sw)
+{
+	std::vector<struct SparseEntry> old;
+	size_t n;
+
+	old.swap(sw->table);
+	tableInit(sw, 64 - sw->shift + 1);
+	for(n=0; n < old.size(); n++)
+		if(old[n].chunk != SPARSE_FREE)
+			tableInsert(sw, old[n].key, old[n].chunk);
+}
+
+void sparseSet(struct SparseWorld *sw, int x, int z, unsigned flags)
+{
+	uint64_t key = sparseKey(x, z);
+	uint8_t *c = (uint8_t *)sparseChunk(sw, key);
+
+	if(!c)
+	{
+		if(!flags)
+			return;
+		if(2 * (sw->chunks + 1) > sw->table.size())
+			grow(sw);
+		tableInsert(sw, key, (uint32_t)sw->chunks);
+		sw->data.resize((sw->chunks + 1) * SPARSE_CELLS, 0);
+		c = &sw->data[sw->chunks * SPARSE_CELLS];
+		sw->chunks++;
+	}
+	c[sparseIndex(x, z)] = flags;
+}
+
+unsigned sparseBox(const struct SparseWorld *sw, int x0, int z0, int x1, int z1)
+{
+	unsigned flags = 0;
+	int cx, cz;
+
+	for(cz=z0 >> SPARSE_BITS; cz <= z1 >> SPARSE_BITS; cz++)
+		for(cx=x0 >> SPARSE_BITS; cx <= x1 >> SPARSE_BITS; cx++)
+		{
+			const uint8_t *c = sparseChunk(sw, sparseKey(cx * SPARSE_CHUNK, cz * SPARSE_CHUNK));
+			int i0 = std::max(x0, cx * SPARSE_CHUNK), i1 = std::min(x1, cx * SPARSE_CHUNK + SPARSE_CHUNK - 1);
+			int k0 = std::max(z0, cz * SPARSE_CHUNK), k1 = std::min(z1, cz * SPARSE_CHUNK + SPARSE_CHUNK - 1);
+			uint32_t row, m;
+			int i, k;
+			if(!c)
+				continue;
+			row = sparseIndex(i0, k0);
+			for(k=k0; k <= k1; k++, row = mortonNextZ(row))
+				for(i=i0, m=row; i <= i1; i++, m = mortonNextX(m))
+					flags |= c[m];
+		}
+	return flags;
+}
+
+size_t sparseBytes(const struct SparseWorld *sw)
+{
+	return sw->data.capacity() + sw->table.capacity() * sizeof(struct SparseEntry);
+}
+
+void sparseFromCourse(struct SparseWorld *sw, const struct Course *course, int x0, int z0)
+{
+	int i, k;
+
+	for(k=0; k < course->d; k++)
+		for(i=0; i < course->w; i++)
+		{
+			unsigned flags = colCell(&course->index, i, k);
+			if(flags)
+				sparseSet(sw, x0 + i, z0 + k, flags);
+		}
+}
+
+void sparseRegion(const struct SparseWorld *sw, int x0, int z0, int w, int d, struct Course *out)
+{
+	struct SparseCursor cur;
+	int i, k;
+
+	sparseCursor(&cur, sw);
+	out->seed = 0;
+	out->maze = 0;
+	out->w = w;
+	out->d = d;
+	out->spawn_x = 0;
+	out->spawn_z = d - 1;
+	out->tiles.assign((size_t)w * d, TILE_PIT);
+	out->obs.clear();
+	for(k=0; k < d; k++)
+		for(i=0; i < w; i++)
+		{
+			unsigned flags = sparseCellAt(sw, &cur, x0 + i, z0 + k);
+			if(flags & COL_MOVING)
+				out->tiles[(size_t)k * w + i] = TILE_MOVING;
+			else if(flags & COL_FLOOR)
+				out->tiles[(size_t)k * w + i] = TILE_FLOOR;
+			if(flags & COL_OBSTACLE)
+			{
+				struct Obstacle o = { i, k };
+				out->obs.push_back(o);
+			}
+		}
+	colBuild(&out->index, out);
+}
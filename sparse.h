@@ -0,0 +1,198 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#include "course.h"
+
+/* Sparse world store for levels far too big to keep a byte per cell, most
+ * of which is water.
+ *
+ * Cells hold the collision flags of collide.h (no flags is a pit) and are
+ * kept in chunks of SPARSE_CHUNK x SPARSE_CHUNK bytes. A chunk only exists
+ * once something is set in it; every other cell is a pit without taking
+ * any memory. Chunks are found through an open addressing hash on their
+ * coordinate, probed linearly and kept at most half full, so a lookup is
+ * one multiply and usually one cache line before the chunk itself. A
+ * cursor remembers the last chunk, so walking cell to cell mostly skips
+ * the hash.
+ *
+ * Inside a chunk cells are in Morton (Z) order, the bits of x and z
+ * interleaved, so the cells around one are a few cache lines away
+ * whichever way you go: a box of cells (sparseBox) or a walk down a
+ * column touches about as many lines as a walk along a row. Only
+ * bench_sparse and bench_morton exercise that today.
+ *
+ * It is a store on its own: nothing in the game, the simulation or the
+ * collision, path and mesh code reads it yet. Its cells are collide.h's
+ * flags so a caller can test them as it would the collision index, and
+ * sparseRegion cuts a region out as a Course, which the collision index,
+ * grid and mesh builders take as they would any other.
+ */
+#define SPARSE_BITS 5
+#define SPARSE_CHUNK (1 << SPARSE_BITS)
+#define SPARSE_CELLS (SPARSE_CHUNK * SPARSE_CHUNK)
+
+/* Morton codes: x in the even bits, z in the odd */
+#define MORTON_X 0x55555555u
+#define MORTON_Z 0xaaaaaaaau
+
+/* The same within a chunk, where a step off its edge wraps to 0 */
+#define SPARSE_MX (MORTON_X & (SPARSE_CELLS - 1))
+#define SPARSE_MZ (MORTON_Z & (SPARSE_CELLS - 1))
+
+/* Spread the low 16 bits of v to the even bits, and back. With BMI2 this
+   is one pdep or pext; without it, the usual shifts and masks. */
+static inline uint32_t mortonSpread(uint32_t v)
+{
+#ifdef __BMI2__
+	return _pdep_u32(v, MORTON_X);
+#else
+	v &= 0xffff;
+	v = (v | v << 8) & 0x00ff00ff;
+	v = (v | v << 4) & 0x0f0f0f0f;
+	v = (v | v << 2) & 0x33333333;
+	return (v | v << 1) & 0x55555555;
+#endif
+}
+
+static inline uint32_t mortonCompact(uint32_t m)
+{
+#ifdef __BMI2__
+	return _pext_u32(m, MORTON_X);
+#else
+	m &= 0x55555555;
+	m = (m | m >> 1) & 0x33333333;
+	m = (m | m >> 2) & 0x0f0f0f0f;
+	m = (m | m >> 4) & 0x00ff00ff;
+	return (m | m >> 8) & 0x0000ffff;
+#endif
+}
+
+static inline uint32_t mortonEncode(uint32_t x, uint32_t z)
+{
+	return mortonSpread(x) | mortonSpread(z) << 1;
+}
+
+static inline void mortonDecode(uint32_t m, uint32_t *x, uint32_t *z)
+{
+	*x = mortonCompact(m);
+	*z = mortonCompact(m >> 1);
+}
+
+/* The neighbours of cell m in a chunk, without decoding it: carries are
+   pushed through the other axis's bits by filling them with ones. Each
+   wraps to the other edge of the chunk when it steps off. */
+static inline uint32_t mortonNextX(uint32_t m) { return (((m | SPARSE_MZ) + 1) & SPARSE_MX) | (m & SPARSE_MZ); }
+static inline uint32_t mortonPrevX(uint32_t m) { return (((m & SPARSE_MX) - 1) & SPARSE_MX) | (m & SPARSE_MZ); }
+static inline uint32_t mortonNextZ(uint32_t m) { return (((m | SPARSE_MX) + 1) & SPARSE_MZ) | (m & SPARSE_MX); }
+static inline uint32_t mortonPrevZ(uint32_t m) { return (((m & SPARSE_MZ) - 1) & SPARSE_MZ) | (m & SPARSE_MX); }
+
+/* Where cell (x, z) is in its chunk */
+static inline uint32_t sparseIndex(int x, int z)
+{
+	return mortonEncode(x & (SPARSE_CHUNK - 1), z & (SPARSE_CHUNK - 1));
+}
+
+struct SparseEntry {
+	uint64_t key;    // chunk x in the high half, chunk z in the low
+	uint32_t chunk;  // index into data, in chunks; SPARSE_FREE if unused
+	uint32_t pad;
+};
+
+#define SPARSE_FREE UINT32_MAX
+
+struct SparseWorld {
+	std::vector<struct SparseEntry> table;  // power of two long
+	int shift;                              // 64 - log2 of the table length
+	size_t chunks;
+	std::vector<uint8_t> data;              // chunks one after another
+};
+
+/* Where a cursor was last, so nearby lookups skip the hash */
+struct SparseCursor {
+	uint64_t key;
+	const uint8_t *chunk;  // NULL for a chunk that doesn't exist
+};
+
+void sparseInit(struct SparseWorld *sw);
+
+static inline uint64_t sparseKey(int x, int z)
+{
+	return (uint64_t)(uint32_t)(x >> SPARSE_BITS) << 32 | (uint32_t)(z >> SPARSE_BITS);
+}
+
+static inline size_t sparseHash(const struct SparseWorld *sw, uint64_t key)
+{
+	return (key * 0x9e3779b97f4a7c15ULL) >> sw->shift;
+}
+
+/* The chunk with this key, or NULL */
+static inline const uint8_t *sparseChunk(const struct SparseWorld *sw, uint64_t key)
+{
+	size_t mask = sw->table.size() - 1, i = sparseHash(sw, key);
+
+	for(;; i = (i + 1) & mask)
+	{
+		const struct SparseEntry *e = &sw->table[i];
+		if(e->chunk == SPARSE_FREE)
+			return NULL;
+		if(e->key == key)
+			return &sw->data[(size_t)e->chunk * SPARSE_CELLS];
+	}
+}
+
+static inline unsigned sparseCell(const struct SparseWorld *sw, int x, int z)
+{
+	const uint8_t *c = sparseChunk(sw, sparseKey(x, z));
+
+	return c ? c[sparseIndex(x, z)] : 0;
+}
+
+/* A cursor starts on chunk (0, 0), looked up like any other: every key is
+   some cell's, so there is none free to mean "nowhere yet" */
+static inline void sparseCursor(struct SparseCursor *cur, const struct SparseWorld *sw)
+{
+	cur->key = sparseKey(0, 0);
+	cur->chunk = sparseChunk(sw, cur->key);
+}
+
+static inline unsigned sparseCellAt(const struct SparseWorld *sw, struct SparseCursor *cur, int x, int z)
+{
+	uint64_t key = sparseKey(x, z);
+
+	if(key != cur->key)
+	{
+		cur->key = key;
+		cur->chunk = sparseChunk(sw, key);
+	}
+	return cur->chunk ? cur->chunk[sparseIndex(x, z)] : 0;
+}
+
+/* Set a cell's flags, making its chunk if need be. Setting a pit where
+   there is no chunk makes none. Pointers from sparseChunk and cursors are
+   stale after a set that makes a chunk. */
+void sparseSet(struct SparseWorld *sw, int x, int z, unsigned flags);
+
+/* Flags of every cell in x0..x1 by z0..z1, or'ed: what a box around the
+   player touches. Walks each chunk the box covers with the Morton steps. */
+unsigned sparseBox(const struct SparseWorld *sw, int x0, int z0, int x1, int z1);
+
+/* Bytes held: the chunks and the hash table */
+size_t sparseBytes(const struct SparseWorld *sw);
+
+/* Put a course's cells in the world with its cell (0, 0) at (x0, z0).
+   Pits leave what is there. */
+void sparseFromCourse(struct SparseWorld *sw, const struct Course *course, int x0, int z0);
+
+/* The w x d region at (x0, z0) as a course, ready for gridFromCourse,
+   meshCourse or the simulation. It spawns at its lower left corner. */
+void sparseRegion(const struct SparseWorld *sw, int x0, int z0, int w, int d, struct Course *out);
+
+#endif
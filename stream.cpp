@@ -0,0 +1,268 @@
+#include <sys/time.h>
+
+#include <algorithm>
+
+#include "stream.h"
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void latencyAdd(struct Latency *l, double t)
+{
+	l->n++;
+	l->sum += t;
+	l->max = std::max(l->max, t);
+}
+
+void generateChunk(struct Course *course, uint32_t seed, int w, int c)
+{
+	uint64_t x = ((uint64_t)seed << 32 | (uint32_t)c) * 0x9e3779b97f4a7c15ULL;
+	size_t n;
+	int i;
+
+	generateCourse(course, (uint32_t)(x >> 32) ^ (uint32_t)x, w, CHUNK_D);
+	/* Row 0 joins the next chunk: plain floor all the way along */
+	for(i=0; i < w; i++)
+		course->tiles[i] = TILE_FLOOR;
+	for(n=0; n < course->obs.size(); n++)
+		if(course->obs[n].z == 0)
+			course->obs.erase(course->obs.begin() + n--);
+	colBuild(&course->index, course);
+}
+
+/* Bytes held for a chunk. Not for one a worker has, its vectors are
+   changing under us. */
+static size_t chunkBytes(const struct Chunk *ch)
+{
+	size_t n = sizeof(*ch) + ch->gpu_bytes;
+
+	if(ch->state == CHUNK_BUSY)
+		return n;
+	n += ch->course.tiles.capacity() + ch->course.obs.capacity() * sizeof(struct Obstacle);
+	n += ch->course.index.own.capacity();
+	n += (ch->mesh.pos.capacity() + ch->mesh.color.capacity()) * sizeof(float);
+	return n;
+}
+
+/* Recount what is resident. There are only ever a handful of chunks. */
+static void account(struct ChunkStream *st)
+{
+	std::map<int, struct Chunk *>::iterator it;
+	size_t n = 0;
+
+	for(it=st->chunks.begin(); it != st->chunks.end(); ++it)
+	{
+		size_t b = chunkBytes(it->second);
+		n += b;
+		st->largest = std::max(st->largest, b);
+	}
+	st->stats.resident = n;
+	st->stats.peak = std::max(st->stats.peak, n);
+}
+
+static void worker(struct ChunkStream *st)
+{
+	std::unique_lock<std::mutex> hold(st->lock);
+
+	for(;;)
+	{
+		struct Chunk *ch;
+		double t0, t1;
+
+		st->wake.wait(hold, [st]() { return st->quit || !st->todo.empty(); });
+		if(st->quit)
+			return;
+		ch = st->todo.front();
+		st->todo.pop_front();
+		ch->state = CHUNK_BUSY;
+		hold.unlock();
+
+		t0 = now();
+		generateChunk(&ch->course, st->seed, st->w, ch->c);
+		meshCourse(&ch->mesh, &ch->course, 0, CHUNK_D);
+		t1 = now();
+
+		hold.lock();
+		ch->state = CHUNK_MESHED;
+		ch->t_meshed = t1;
+		latencyAdd(&st->stats.gen, t1 - t0);
+		latencyAdd(&st->stats.ready, t1 - ch->t_queued);
+		st->stats.generated++;
+		account(st);
+		st->done.notify_all();
+	}
+}
+
+void streamStart(struct ChunkStream *st, uint32_t seed, int w, size_t budget, int threads,
+		StreamUpload upload, StreamRelease release, void *ctx)
+{
+	int t;
+
+	st->seed = seed;
+	st->w = w;
+	st->budget = budget;
+	st->upload = upload;
+	st->release = release;
+	st->ctx = ctx;
+	st->quit = false;
+	st->largest = 0;
+	st->stats = StreamStats();
+	if(threads < 1)
+		threads = 1;
+	for(t=0; t < threads; t++)
+		st->workers.push_back(std::thread(worker, st));
+}
+
+static void freeChunk(struct ChunkStream *st, struct Chunk *ch)
+{
+	if(ch->gpu && st->release)
+		st->release(ch->gpu, st->ctx);
+	delete ch;
+}
+
+void streamStop(struct ChunkStream *st)
+{
+	std::map<int, struct Chunk *>::iterator it;
+	size_t t;
+
+	{
+		std::lock_guard<std::mutex> hold(st->lock);
+		st->quit = true;
+	}
+	st->wake.notify_all();
+	for(t=0; t < st->workers.size(); t++)
+		st->workers[t].join();
+	st->workers.clear();
+	for(it=st->chunks.begin(); it != st->chunks.end(); ++it)
+		freeChunk(st, it->second);
+	st->chunks.clear();
+	st->todo.clear();
+	account(st);
+}
+
+/* Under the lock: chunk c, queued at the front or back if it is new */
+static struct Chunk *request(struct ChunkStream *st, int c, bool urgent)
+{
+	std::map<int, struct Chunk *>::iterator it = st->chunks.find(c);
+	struct Chunk *ch;
+
+	if(it != st->chunks.end())
+		return it->second;
+	ch = new struct Chunk;
+	ch->c = c;
+	ch->state = CHUNK_QUEUED;
+	ch->gpu = NULL;
+	ch->gpu_bytes = 0;
+	ch->t_queued = now();
+	ch->t_meshed = 0;
+	st->chunks[c] = ch;
+	if(urgent)
+		st->todo.push_front(ch);
+	else
+		st->todo.push_back(ch);
+	st->wake.notify_one();
+	return ch;
+}
+
+/* Under the lock: drop a chunk no worker has */
+static void evict(struct ChunkStream *st, struct Chunk *ch)
+{
+	if(ch->state == CHUNK_QUEUED)
+		st->todo.erase(std::find(st->todo.begin(), st->todo.end(), ch));
+	st->chunks.erase(ch->c);
+	freeChunk(st, ch);
+	st->stats.evicted++;
+}
+
+void streamUpdate(struct ChunkStream *st, int at, int max_uploads)
+{
+	std::lock_guard<std::mutex> hold(st->lock);
+	std::map<int, struct Chunk *>::iterator it;
+	int c, uploads = 0;
+
+	/* Everything behind the player goes. Ahead nothing is dropped, the
+	   budget only limits how far ahead is queued. */
+	while(!st->chunks.empty() && st->chunks.begin()->first < at - STREAM_BEHIND &&
+			st->chunks.begin()->second->state != CHUNK_BUSY)
+		evict(st, st->chunks.begin()->second);
+	account(st);
+
+	/* Queue ahead, nearest first, as far as the budget goes when each new
+	   chunk is counted as big as the biggest yet. The player's chunk and
+	   the two after it are queued whatever the budget says: the window
+	   the player moves on to next needs the second. */
+	for(c=std::max(at, 0); c <= at + STREAM_AHEAD; c++)
+	{
+		if(st->chunks.count(c))
+			continue;
+		if(c > at + 2 && st->stats.resident + st->largest > st->budget)
+			break;
+		request(st, c, false);
+		account(st);
+	}
+
+	/* Upload the nearest meshed chunks. The lock stays held: workers
+	   count a meshed chunk's bytes, and only ever wait for it to finish
+	   a chunk. */
+	for(it=st->chunks.lower_bound(at - STREAM_BEHIND); st->upload && it != st->chunks.end() && uploads < max_uploads; ++it)
+	{
+		struct Chunk *ch = it->second;
+		struct Mesh empty;
+		if(ch->state != CHUNK_MESHED)
+			continue;
+		ch->gpu = st->upload(&ch->mesh, st->ctx);
+		ch->gpu_bytes = meshBytes(&ch->mesh);
+		std::swap(ch->mesh, empty);
+		ch->state = CHUNK_UPLOADED;
+		latencyAdd(&st->stats.upload, now() - ch->t_meshed);
+		st->stats.uploaded++;
+		uploads++;
+	}
+	account(st);
+}
+
+const struct Chunk *streamChunk(struct ChunkStream *st, int c)
+{
+	std::unique_lock<std::mutex> hold(st->lock);
+	struct Chunk *ch = request(st, c, true);
+
+	if(ch->state < CHUNK_MESHED)
+	{
+		st->stats.stalls++;
+		st->done.wait(hold, [ch]() { return ch->state >= CHUNK_MESHED; });
+	}
+	return ch;
+}
+
+void streamWindow(struct ChunkStream *st, int c, struct Course *out)
+{
+	const struct Course *far = &streamChunk(st, c + 1)->course, *near = &streamChunk(st, c)->course;
+	size_t n;
+
+	out->seed = st->seed;
+	out->maze = 0;
+	out->w = st->w;
+	out->d = 2 * CHUNK_D;
+	out->spawn_x = near->spawn_x;
+	out->spawn_z = near->spawn_z + CHUNK_D;
+	out->tiles = far->tiles;
+	out->tiles.insert(out->tiles.end(), near->tiles.begin(), near->tiles.end());
+	out->obs = far->obs;
+	for(n=0; n < near->obs.size(); n++)
+	{
+		struct Obstacle o = near->obs[n];
+		o.z += CHUNK_D;
+		out->obs.push_back(o);
+	}
+	colBuild(&out->index, out);
+}
+
+void streamStats(struct ChunkStream *st, struct StreamStats *out)
+{
+	std::lock_guard<std::mutex> hold(st->lock);
+	*out = st->stats;
+}
@@ -0,0 +1,119 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "course.h"
+#include "mesh.h"
+
+/* Endless course, streamed in chunks.
+ *
+ * Chunk c is a CHUNK_D row course of its own, generated from the stream's
+ * seed and c, and chunks are laid end to end towards -z: chunk 0 is where
+ * the player starts, chunk 1 lies beyond its row 0, and so on. Row 0 of
+ * every chunk is plain floor, so from anywhere on it the next chunk's
+ * spawn corner can be walked to, and each chunk can be finished from its
+ * spawn, so the whole course can.
+ *
+ * Worker threads generate and mesh the chunks ahead of the player. The
+ * thread that owns the GPU uploads the meshes a few a frame in
+ * streamUpdate, through a callback. The same call evicts chunks behind the
+ * player and only queues chunks ahead while what is resident stays under
+ * a byte budget, so memory stays the same however far the player runs.
+ */
+#define CHUNK_D 32
+#define STREAM_AHEAD 4   // chunks generated ahead of the player's
+#define STREAM_BEHIND 1  // chunks kept behind it
+
+enum {
+	CHUNK_QUEUED,    // waiting for a worker
+	CHUNK_BUSY,      // being generated and meshed
+	CHUNK_MESHED,    // ready, mesh waiting to be uploaded
+	CHUNK_UPLOADED   // on the GPU, CPU copy of the mesh dropped
+};
+
+struct Chunk {
+	int c;
+	int state;               // CHUNK_*, under the stream's lock
+	struct Course course;    // the chunk's cells, rows 0 .. CHUNK_D-1
+	struct Mesh mesh;        // static geometry in chunk coordinates
+	void *gpu;               // what the upload callback returned
+	size_t gpu_bytes;
+	double t_queued, t_meshed;
+};
+
+/* Count, mean and worst of a latency, in seconds */
+struct Latency {
+	size_t n;
+	double sum, max;
+};
+
+struct StreamStats {
+	struct Latency gen;      // generating and meshing one chunk, on a worker
+	struct Latency ready;    // queued to meshed, including the wait for a worker
+	struct Latency upload;   // meshed to uploaded
+	size_t generated, uploaded, evicted;
+	size_t stalls;           // times streamChunk had to wait for a chunk
+	size_t resident;         // bytes of chunks held, CPU and GPU
+	size_t peak;
+};
+
+/* Called on the thread that calls streamUpdate. upload returns a handle
+   for the chunk's mesh on the GPU, release frees it. */
+typedef void *(*StreamUpload)(const struct Mesh *mesh, void *ctx);
+typedef void (*StreamRelease)(void *gpu, void *ctx);
+
+struct ChunkStream {
+	uint32_t seed;
+	int w;
+	size_t budget;
+	StreamUpload upload;
+	StreamRelease release;
+	void *ctx;
+
+	std::mutex lock;
+	std::condition_variable wake;    // workers: something queued or quit
+	std::condition_variable done;    // streamChunk: a chunk was meshed
+	std::deque<struct Chunk *> todo;
+	std::map<int, struct Chunk *> chunks;
+	std::vector<std::thread> workers;
+	bool quit;
+	size_t largest;                  // biggest chunk seen, for budgeting the next
+	struct StreamStats stats;
+};
+
+/* Build chunk c of an endless course */
+void generateChunk(struct Course *course, uint32_t seed, int w, int c);
+
+/* Start 'threads' workers. upload and release may be NULL for no GPU. */
+void streamStart(struct ChunkStream *st, uint32_t seed, int w, size_t budget, int threads,
+		StreamUpload upload, StreamRelease release, void *ctx);
+
+/* Stop the workers and free every chunk */
+void streamStop(struct ChunkStream *st);
+
+/* Once a frame, with the player in chunk 'at': evict what is behind,
+   queue the chunks ahead the budget allows, and upload at most
+   max_uploads meshes */
+void streamUpdate(struct ChunkStream *st, int at, int max_uploads);
+
+/* Chunk c, queued and waited for if it isn't ready yet. It stays valid
+   until a streamUpdate evicts it. */
+const struct Chunk *streamChunk(struct ChunkStream *st, int c);
+
+/* Chunks c+1 and c stitched into one 2*CHUNK_D row course for the
+   simulation, chunk c in the lower half and spawning at its start */
+void streamWindow(struct ChunkStream *st, int c, struct Course *out);
+
+/* A copy of the stats, taken under the lock */
+void streamStats(struct ChunkStream *st, struct StreamStats *out);
+
+#endif
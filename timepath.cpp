@@ -0,0 +1,234 @@
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "timepath.h"
+
+enum { KIND_BLOCKED, KIND_STATIC, KIND_MOVING };
+
+/* Move j is a wait for j == 0, else a step of (dx4[j], dz4[j]) */
+static const int dx4[5] = { 0, 1, -1, 0, 0 };
+static const int dz4[5] = { 0, 0, 0, 1, -1 };
+
+/* From the collision index, which edits keep up to date where the
+   obstacle list isn't */
+static uint8_t cellKind(const struct Course *course, int x, int z)
+{
+	unsigned flags = colCell(&course->index, x, z);
+
+	if(flags & COL_OBSTACLE)
+		return KIND_BLOCKED;
+	return flags & COL_FLOOR ? KIND_STATIC : flags & COL_MOVING ? KIND_MOVING : KIND_BLOCKED;
+}
+
+void timedInit(struct TimedFinder *tf, const struct Course *course)
+{
+	int p, q, x, z;
+	size_t n;
+
+	tf->w = course->w;
+	tf->d = course->d;
+	tf->kind.resize((size_t)tf->w * tf->d);
+	for(z=0; z < tf->d; z++)
+		for(x=0; x < tf->w; x++)
+			tf->kind[(size_t)z * tf->w + x] = cellKind(course, x, z);
+
+	/* All moving tiles follow the one cycle, so a phase's walkability is a
+	   single bit; phases that agree share a bucket */
+	tf->buckets = 0;
+	for(p=0; p < PHASES; p++)
+	{
+		for(q=0; q < p && phaseWalkable(q) != phaseWalkable(p); q++)
+			;
+		tf->bucket[p] = q < p ? tf->bucket[q] : tf->buckets++;
+	}
+	tf->moves.assign(tf->buckets, std::vector<uint8_t>());
+	tf->built = 0;
+
+	n = tf->kind.size() * PHASES;
+	tf->g.resize(n);
+	tf->parent.resize(n);
+	tf->seen.assign(n, 0);
+	tf->gen = 0;
+	tf->expanded = 0;
+}
+
+/* Moves out of cell (x, z) for a step that ends with the moving tiles
+   walkable or not */
+static uint8_t cellMoves(const struct TimedFinder *tf, int x, int z, bool walk)
+{
+	uint8_t mask = 0;
+	int j;
+
+	for(j=0; j < 5; j++)
+	{
+		int nx = x + dx4[j], nz = z + dz4[j], k;
+		if(nx < 0 || nz < 0 || nx >= tf->w || nz >= tf->d)
+			continue;
+		k = tf->kind[(size_t)nz * tf->w + nx];
+		if(k == KIND_STATIC || (k == KIND_MOVING && walk))
+			mask |= 1 << j;
+	}
+	return mask;
+}
+
+/* Moves of every cell for steps that end in a phase of bucket b */
+static const std::vector<uint8_t> &bucketMoves(struct TimedFinder *tf, int b, int p)
+{
+	std::vector<uint8_t> &m = tf->moves[b];
+	bool walk = phaseWalkable(p);
+	int x, z;
+
+	if(!m.empty())
+		return m;
+	m.resize(tf->kind.size());
+	for(z=0; z < tf->d; z++)
+		for(x=0; x < tf->w; x++)
+			m[(size_t)z * tf->w + x] = cellMoves(tf, x, z, walk);
+	tf->built++;
+	return m;
+}
+
+void timedSetCell(struct TimedFinder *tf, const struct Course *course, int x, int z)
+{
+	int b, p, j;
+
+	if(x < 0 || z < 0 || x >= tf->w || z >= tf->d)
+		return;
+	tf->kind[(size_t)z * tf->w + x] = cellKind(course, x, z);
+	/* The cell's own moves and its neighbours' moves into it, in the
+	   buckets worked out already; the others are built when needed */
+	for(b=0; b < tf->buckets; b++)
+	{
+		std::vector<uint8_t> &m = tf->moves[b];
+		if(m.empty())
+			continue;
+		for(p=0; tf->bucket[p] != b; p++)
+			;
+		for(j=0; j < 5; j++)
+		{
+			int nx = x + dx4[j], nz = z + dz4[j];
+			if(nx >= 0 && nz >= 0 && nx < tf->w && nz < tf->d)
+				m[(size_t)nz * tf->w + nx] = cellMoves(tf, nx, nz, phaseWalkable(p));
+		}
+	}
+}
+
+static bool openLess(const struct PathOpen &a, const struct PathOpen &b)
+{
+	return a.key > b.key;
+}
+
+static inline uint32_t estimate(struct PathPoint to, int x, int z)
+{
+	return (to.x < 0 ? 0 : abs(to.x - x)) + abs(to.z - z);
+}
+
+/* Shared by both queries: to.x < 0 takes any cell of row to.z as the goal */
+static long search(struct TimedFinder *tf, struct PathPoint from, uint32_t tick, struct PathPoint to,
+		std::vector<struct TimedStep> *path)
+{
+	uint32_t t0 = (tick + CELL_TICKS - 1) / CELL_TICKS, s, start;
+	int j;
+
+	if(path)
+		path->clear();
+	tf->expanded = 0;
+	if(from.x < 0 || from.z < 0 || from.x >= tf->w || from.z >= tf->d ||
+			to.z < 0 || to.x >= tf->w || to.z >= tf->d ||
+			(to.x >= 0 && tf->kind[(size_t)to.z * tf->w + to.x] == KIND_BLOCKED))
+		return -1;
+	if(++tf->gen == 0)
+	{
+		std::fill(tf->seen.begin(), tf->seen.end(), 0);
+		tf->gen = 1;
+	}
+
+	/* A*, a state is reached this query if seen is gen and closed once the
+	   top bit of its parent is set. Every move takes one step, so the first
+	   time a goal cell comes off the open list is the earliest arrival. To
+	   a row, the estimate is the rows left to go. */
+	start = ((uint32_t)from.z * tf->w + from.x) * PHASES + t0 % PHASES;
+	tf->open.clear();
+	tf->seen[start] = tf->gen;
+	tf->g[start] = 0;
+	tf->parent[start] = start;
+	{
+		struct PathOpen o = { (uint64_t)estimate(to, from.x, from.z) << 32 | UINT32_MAX, start };
+		tf->open.push_back(o);
+	}
+	while(!tf->open.empty())
+	{
+		uint32_t cell, gs, np;
+		int x, z;
+
+		s = tf->open.front().cell;
+		std::pop_heap(tf->open.begin(), tf->open.end(), openLess);
+		tf->open.pop_back();
+		if(tf->parent[s] & 0x80000000u)
+			continue;
+		tf->parent[s] |= 0x80000000u;
+		tf->expanded++;
+		cell = s / PHASES;
+		x = cell % tf->w;
+		z = cell / tf->w;
+		gs = tf->g[s];
+		if(z == to.z && (x == to.x || to.x < 0))
+		{
+			if(path)
+			{
+				for(;;)
+				{
+					struct TimedStep st = { (int)(s / PHASES % tf->w), (int)(s / PHASES / tf->w),
+						(t0 + tf->g[s]) * CELL_TICKS };
+					path->push_back(st);
+					if(s == start)
+						break;
+					s = tf->parent[s] & 0x7fffffffu;
+				}
+				std::reverse(path->begin(), path->end());
+			}
+			return (long)(t0 + gs) * CELL_TICKS;
+		}
+
+		np = (s % PHASES + 1) % PHASES;
+		uint8_t mask = bucketMoves(tf, tf->bucket[np], np)[cell];
+		for(j=0; j < 5; j++)
+		{
+			uint32_t ns;
+			if(!(mask >> j & 1))
+				continue;
+			ns = ((uint32_t)(z + dz4[j]) * tf->w + x + dx4[j]) * PHASES + np;
+			if(tf->seen[ns] == tf->gen && ((tf->parent[ns] & 0x80000000u) || gs + 1 >= tf->g[ns]))
+				continue;
+			tf->seen[ns] = tf->gen;
+			tf->g[ns] = gs + 1;
+			tf->parent[ns] = s;
+			struct PathOpen o = { (uint64_t)(gs + 1 + estimate(to, x + dx4[j], z + dz4[j])) << 32 | (UINT32_MAX - gs - 1), ns };
+			tf->open.push_back(o);
+			std::push_heap(tf->open.begin(), tf->open.end(), openLess);
+		}
+	}
+	return -1;
+}
+
+long timedPath(struct TimedFinder *tf, struct PathPoint from, uint32_t tick, struct PathPoint to,
+		std::vector<struct TimedStep> *path)
+{
+	if(to.x < 0)
+	{
+		if(path)
+			path->clear();
+		tf->expanded = 0;
+		return -1;
+	}
+	return search(tf, from, tick, to, path);
+}
+
+long timedPathToRow(struct TimedFinder *tf, struct PathPoint from, uint32_t tick, int row,
+		std::vector<struct TimedStep> *path)
+{
+	struct PathPoint to = { -1, row };
+
+	return search(tf, from, tick, to, path);
+}
@@ -0,0 +1,67 @@
+#ifndef TIMEPATH_H
+#define TIMEPATH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "course.h"
+#include "path.h"
+#include "solve.h"
+
+/* Time-dependent path finding on a course, in the model the solver uses
+ * (see solve.h): 4-way steps of CELL_TICKS each, or waiting a step in
+ * place, over states (cell, phase of the moving tile cycle). A step onto a
+ * moving tile, or a wait on one, is only taken when the tile is at floor
+ * height for all of it, so the path has the player arrive on each moving
+ * tile while it can be stood on.
+ *
+ * Which moves a cell allows depends on the phase only through which tiles
+ * are walkable, so phases with the same walkability share a bucket and the
+ * moves of every cell are worked out once per bucket, on the first query
+ * that needs them, and kept until the next timedInit. Cells are read
+ * from the course's collision index, and an edited cell is taken in with
+ * timedSetCell without starting over.
+ */
+struct TimedStep {
+	int x, z;
+	uint32_t tick;    // when the player is to be on the cell
+};
+
+struct TimedFinder {
+	int w, d;
+	std::vector<uint8_t> kind;              // blocked, static or moving
+	int bucket[PHASES];                      // bucket of each phase
+	int buckets;
+	std::vector<std::vector<uint8_t> > moves; // per bucket, per cell: moves that land in that bucket
+
+	/* Search scratch over cells * PHASES states, reused */
+	std::vector<uint32_t> g, parent, seen;
+	uint32_t gen;
+	std::vector<struct PathOpen> open;
+	size_t expanded;  // states expanded by the last query
+	size_t built;     // buckets worked out since timedInit
+};
+
+/* Set up a finder for a course. Call again when the course changes. */
+void timedInit(struct TimedFinder *tf, const struct Course *course);
+
+/* Cell (x, z) of the course's collision index has changed. Updates its
+   moves and its neighbours' in the buckets built so far, keeping them and
+   the search scratch, so it costs the same on any size of course. */
+void timedSetCell(struct TimedFinder *tf, const struct Course *course, int x, int z);
+
+/* Earliest way from 'from' to 'to' setting off at 'tick'. The walk starts
+   on the first whole cell step at or after tick. Returns the arrival tick
+   and fills 'path' with one entry per step, waits included, both ends
+   included, or returns -1 if 'to' can never be reached. path may be NULL. */
+long timedPath(struct TimedFinder *tf, struct PathPoint from, uint32_t tick, struct PathPoint to,
+		std::vector<struct TimedStep> *path);
+
+/* As timedPath, to whichever cell of row 'row' can be reached first. One
+   search, where asking for each cell of the row in turn is one each, and
+   each one the row can't be reached at goes over every reachable state. */
+long timedPathToRow(struct TimedFinder *tf, struct PathPoint from, uint32_t tick, int row,
+		std::vector<struct TimedStep> *path);
+
+#endif
@@ -0,0 +1,215 @@
+/* Batch replay verifier for leaderboard submissions.
+ *
+ * Re-simulates every replay in a directory with the game's own simulation
+ * code and no rendering, one replay per worker at a time across all cores.
+ * Nothing in the submission is trusted except the per-tick inputs: the course
+ * is regenerated from the seed and the state hashes only have to agree with
+ * what the inputs produce here.
+ *
+ *   ./verify submissions/ [-j threads]
+ *
+ * Prints one line per replay, "name PASS seconds" or "name FAIL reason",
+ * then the course as "seed N WxD", and "maze" for a maze, once the header
+ * has been read, followed by the throughput on stderr. Exits non-zero if
+ * any replay failed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sim.h"
+#include "replay.h"
+
+/* An hour of play. Anything longer is rejected before it is simulated. */
+#define MAX_TICKS (3600 * SIM_HZ)
+
+struct Result {
+	bool pass;
+	const char *reason;
+	uint32_t ticks;
+	uint32_t finish_tick;
+	bool header;         // the course below was read
+	uint32_t seed;
+	int w, d;
+	bool maze;
+};
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void verifyOne(const std::string &path, struct Result *res)
+{
+	struct Replay r;
+	struct Course course;
+	struct SimState s;
+	size_t i;
+
+	res->pass = false;
+	res->ticks = 0;
+	res->finish_tick = 0;
+	res->header = false;
+
+	r.ticks = 0;
+	if(!replayLoad(&r, path.c_str(), MAX_TICKS))
+	{
+		res->reason = r.ticks > MAX_TICKS ? "too-long" : "unreadable";
+		return;
+	}
+	res->ticks = r.inputs.size();
+	res->header = true;
+	res->seed = r.seed;
+	res->w = r.w;
+	res->d = r.d;
+	res->maze = (r.flags & REPLAY_MAZE) != 0;
+	for(i=0; i < r.inputs.size(); i++)
+		if(r.inputs[i] & ~(IN_UP | IN_DOWN | IN_RIGHT | IN_LEFT | IN_JUMP))
+		{
+			res->reason = "bad-input";
+			return;
+		}
+
+	/* Only the courses the game records, so a leaderboard time is for
+	   the course everyone plays and a header can't ask for a huge one */
+	if(r.w != COURSE_W || r.d != ((r.flags & REPLAY_MAZE) ? COURSE_D + 1 : COURSE_D))
+	{
+		res->reason = "bad-course";
+		return;
+	}
+	replayCourse(&r, &course);
+	if(r.n_obs != (uint16_t)course.obs.size())
+	{
+		res->reason = "course-mismatch";
+		return;
+	}
+
+	if(replayRun(&r, &course, &s) >= 0)
+	{
+		res->reason = "diverged";
+		return;
+	}
+	if(!s.finished)
+	{
+		res->reason = "unfinished";
+		return;
+	}
+	res->pass = true;
+	res->reason = "";
+	res->finish_tick = s.finish_tick;
+}
+
+static void listReplays(const char *dir, std::vector<std::string> &files)
+{
+	DIR *d = opendir(dir);
+	struct dirent *e;
+	struct stat st;
+
+	if(!d)
+	{
+		fprintf(stderr, "Cannot open directory %s\n", dir);
+		exit(EXIT_FAILURE);
+	}
+	while((e = readdir(d)) != NULL)
+	{
+		std::string path = std::string(dir) + "/" + e->d_name;
+		if(e->d_name[0] == '.' || stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+			continue;
+		files.push_back(path);
+	}
+	closedir(d);
+	std::sort(files.begin(), files.end());
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<std::string> files;
+	std::vector<struct Result> results;
+	std::vector<std::thread> workers;
+	std::atomic<size_t> next(0);
+	const char *dir = NULL;
+	unsigned nthreads = std::thread::hardware_concurrency();
+	unsigned long long ticks = 0;
+	int failed = 0;
+	double t0, t1;
+	size_t i;
+
+	for(int a=1; a<argc; a++)
+	{
+		if(!strcmp(argv[a], "-j") && a+1 < argc)
+			nthreads = atoi(argv[++a]);
+		else if(!dir)
+			dir = argv[a];
+		else
+		{
+			dir = NULL;
+			break;
+		}
+	}
+	if(!dir)
+	{
+		fprintf(stderr, "usage: %s <replay-dir> [-j threads]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if(nthreads == 0)
+		nthreads = 1;
+
+	listReplays(dir, files);
+	results.resize(files.size());
+
+	t0 = now();
+	for(i=0; i < nthreads; i++)
+		workers.push_back(std::thread([&]() {
+			size_t n;
+			while((n = next++) < files.size())
+			{
+				/* One file too big to load fails alone, not the batch */
+				try
+				{
+					verifyOne(files[n], &results[n]);
+				}
+				catch(const std::bad_alloc &)
+				{
+					results[n].pass = false;
+					results[n].reason = "unreadable";
+				}
+			}
+		}));
+	for(i=0; i < workers.size(); i++)
+		workers[i].join();
+	t1 = now();
+
+	for(i=0; i < files.size(); i++)
+	{
+		const char *name = strrchr(files[i].c_str(), '/') + 1;
+		ticks += results[i].ticks;
+		if(results[i].pass)
+			printf("%s PASS %.3f", name, (double)results[i].finish_tick / SIM_HZ);
+		else
+		{
+			printf("%s FAIL %s", name, results[i].reason);
+			failed++;
+		}
+		if(results[i].header)
+			printf(" seed %u %dx%d%s", results[i].seed, results[i].w, results[i].d,
+					results[i].maze ? " maze" : "");
+		printf("\n");
+	}
+
+	fprintf(stderr, "%zu replays (%d failed) on %u threads in %.3f s: %.1f replays/s, %.2f Mticks/s\n",
+			files.size(), failed, nthreads, t1 - t0,
+			files.size() / (t1 - t0), ticks / (t1 - t0) / 1e6);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}